@@ -7,6 +7,12 @@
 
 #pragma once
 
+#include"Kernels.h"
+#include<cmath>
+#include<cstddef>
+
+enum class Activation { RELU, SIGMOID, TANH, SOFTMAX, IDENTITY };
+
 namespace ActivationFuncs {
     constexpr float ReLU(float x) {
         if (x < 0){
@@ -24,5 +30,85 @@ namespace ActivationFuncs {
         }
     };
 
-    //todo - Sigmoid, tanh, softmax
-}
\ No newline at end of file
+    inline float Sigmoid(float x){
+        return 1.0f / (1.0f + std::exp(-x));
+    };
+
+    // The derivatives below take the output y of the activation, which is
+    // what the layers keep after the forward pass
+    constexpr float derivate_Sigmoid(float y){
+        return y * (1.0f - y);
+    };
+
+    inline float Tanh(float x){
+        return std::tanh(x);
+    };
+
+    constexpr float derivate_Tanh(float y){
+        return 1.0f - y * y;
+    };
+
+    /**
+     * @brief z = exp(z - max) / sum(exp(z - max)), in place
+     */
+    inline void Softmax(float* z, size_t size){
+        float max = z[0];
+        for (size_t i = 1; i < size; i++){
+            if (z[i] > max) max = z[i];
+        }
+        float sum = 0.0f;
+        for (size_t i = 0; i < size; i++){
+            z[i] = std::exp(z[i] - max);
+            sum += z[i];
+        }
+        float inv = 1.0f / sum;
+        for (size_t i = 0; i < size; i++){
+            z[i] *= inv;
+        }
+    };
+
+    /*
+     * Policies, used as template parameters by the layers so every
+     * activation gets its own loops with the function inlined, instead of
+     * a call per element. apply() is element-wise; ROW_WISE activations
+     * (softmax) do their work in apply_row() once the whole row is known,
+     * and their derivative is the Jacobian product done by the layer.
+     */
+    struct ReLUPolicy {
+        static constexpr bool ROW_WISE = false;
+        static float apply(float x) { return ReLU(x); }
+        static float derivative(float y) { return derivate_ReLU(y); }
+        static void apply_row(float*, size_t) {}
+    };
+
+    struct SigmoidPolicy {
+        static constexpr bool ROW_WISE = false;
+        static float apply(float x) { return Sigmoid(x); }
+        static float derivative(float y) { return derivate_Sigmoid(y); }
+        static void apply_row(float*, size_t) {}
+    };
+
+    struct TanhPolicy {
+        static constexpr bool ROW_WISE = false;
+        static float apply(float x) { return Tanh(x); }
+        static float derivative(float y) { return derivate_Tanh(y); }
+        static void apply_row(float*, size_t) {}
+    };
+
+    struct IdentityPolicy {
+        static constexpr bool ROW_WISE = false;
+        static float apply(float x) { return x; }
+        static float derivative(float) { return 1.0f; }
+        static void apply_row(float*, size_t) {}
+    };
+
+    struct SoftmaxPolicy {
+        static constexpr bool ROW_WISE = true;
+        static float apply(float x) { return x; }
+        static float derivative(float) { return 1.0f; }
+        // Softmax() with the vector exp of the kernels
+        static void apply_row(float* z, size_t size) {
+            Kernels::softmax(size, z);
+        }
+    };
+}
@@ -0,0 +1,66 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the Arena class defined in Arena.h
+ */
+
+#include"Arena.h"
+#include<new>
+#include<utility>
+#include<sys/mman.h>
+#include<unistd.h>
+
+size_t Arena::round_up(size_t n){
+    return (n + ALIGN_FLOATS - 1) / ALIGN_FLOATS * ALIGN_FLOATS;
+}
+
+size_t Arena::page_floats(){
+    static size_t floats = sysconf(_SC_PAGESIZE) / sizeof(float);
+    return floats;
+}
+
+void Arena::reserve(size_t n_floats){
+    if (base != nullptr) munmap(base, capacity * sizeof(float));
+    base = nullptr;
+    capacity = round_up(n_floats);
+    used = 0;
+    if (capacity == 0) return;
+    // page aligned, which is more than ALIGNMENT, and already zero
+    void* map = mmap(nullptr, capacity * sizeof(float), \
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        capacity = 0;
+        throw std::bad_alloc();
+    }
+    base = static_cast<float*>(map);
+}
+
+float* Arena::take(size_t n){
+    size_t size = round_up(n);
+    if (used + size > capacity) return nullptr;
+    float* piece = base + used;
+    used += size;
+    return piece;
+}
+
+void Arena::align_to_page(){
+    used = (used + page_floats() - 1) / page_floats() * page_floats();
+}
+
+float* Arena::data() const {
+    return base;
+}
+
+size_t Arena::size() const {
+    return capacity;
+}
+
+void Arena::swap(Arena& other){
+    std::swap(base, other.base);
+    std::swap(capacity, other.capacity);
+    std::swap(used, other.used);
+}
+
+Arena::~Arena(){
+    if (base != nullptr) munmap(base, capacity * sizeof(float));
+}
@@ -0,0 +1,70 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  One 64 byte aligned block of floats handed out in pieces. The network
+ *  keeps all its parameters and buffers in a single arena, so they are
+ *  allocated with one call and the parameters of all layers sit next to
+ *  each other in memory.
+ *  The block is mapped straight from the kernel, its pages are zero and
+ *  only get physical memory (on the NUMA node of the thread) when first
+ *  written, so the network chooses where each piece lands (see Numa.h).
+ */
+
+#pragma once
+
+#include<cstddef>
+
+class Arena {
+    private:
+        float* base = nullptr;
+        size_t capacity = 0;
+        size_t used = 0;
+    public:
+        static constexpr size_t ALIGNMENT = 64;
+        static constexpr size_t ALIGN_FLOATS = ALIGNMENT / sizeof(float);
+
+        /**
+         * @brief Size of a piece of n floats once padded to the alignment
+         */
+        static size_t round_up(size_t n);
+
+        Arena() = default;
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+
+        /**
+         * @brief Floats in a memory page
+         */
+        static size_t page_floats();
+
+        /**
+         * @brief Frees the old block and allocates n_floats zeroed floats
+         *
+         * @param n_floats The sum of round_up() of every piece to take,
+         *        plus page_floats() for every align_to_page()
+         */
+        void reserve(size_t n_floats);
+
+        /**
+         * @brief Takes the next n floats, aligned. nullptr if the arena is
+         *        too small
+         */
+        float* take(size_t n);
+
+        /**
+         * @brief Makes the next piece start on a new page, so it can be
+         *        placed on its own NUMA node and is not shared with the
+         *        previous one
+         */
+        void align_to_page();
+
+        float* data() const;
+        size_t size() const;
+
+        /**
+         * @brief Exchanges the blocks of two arenas
+         */
+        void swap(Arena& other);
+
+        ~Arena();
+};
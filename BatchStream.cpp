@@ -0,0 +1,194 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the BatchStream class defined in BatchStream.h
+ */
+
+#include"BatchStream.h"
+#include"Dataset.h"
+#include<algorithm>
+#include<chrono>
+#include<cstring>
+#include<iostream>
+#include<fcntl.h>
+#include<sys/stat.h>
+#include<unistd.h>
+
+namespace {
+    // pread can return less than asked, loop until everything is in
+    bool read_fully(int fd, void* dst, size_t size, uint64_t offset){
+        char* p = static_cast<char*>(dst);
+        while (size > 0){
+            ssize_t n = pread(fd, p, size, offset);
+            if (n <= 0) return false;
+            p += n;
+            size -= n;
+            offset += n;
+        }
+        return true;
+    }
+}
+
+int BatchStream::open(const std::string& file_name, size_t batch_size, \
+                                                        size_t n_buffers){
+    stop();
+    if (fd >= 0) ::close(fd);
+    fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open the file." << std::endl;
+        return 0;
+    }
+    DatasetHeader header;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || \
+            !read_fully(fd, &header, sizeof(header), 0) || \
+            std::memcmp(header.magic, "NNDS", 4) != 0 || \
+            header.version != Dataset::VERSION || \
+            header.labels_offset + header.rows > (uint64_t)st.st_size || \
+            header.features_offset + header.rows * header.cols > \
+                                                    (uint64_t)st.st_size) {
+        std::cerr << "Error: " << file_name << " is not a valid dataset." << \
+                                                                    std::endl;
+        ::close(fd);
+        fd = -1;
+        return 0;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    rows = header.rows;
+    cols = header.cols;
+    labels_offset = header.labels_offset;
+    features_offset = header.features_offset;
+    this->batch_size = std::max<size_t>(batch_size, 1);
+
+    slots.assign(std::max<size_t>(n_buffers, 2), Slot());
+    for (Slot& slot : slots){
+        slot.raw.resize(this->batch_size * cols);
+        slot.features.resize(this->batch_size * cols);
+        slot.labels.resize(this->batch_size);
+    }
+    return 1;
+}
+
+void BatchStream::start(size_t epochs){
+    stop();
+    head = filled = 0;
+    stopping = false;
+    failed = false;
+    wait_seconds = load_seconds = 0;
+    loader = std::thread(&BatchStream::load, this, epochs);
+}
+
+void BatchStream::load(size_t epochs){
+    size_t tail = 0;
+    for (size_t epoch = 0; epoch < epochs; epoch++){
+        // one extra step with no rows to mark the end of the epoch
+        for (size_t start = 0; ; start += batch_size){
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                slot_free.wait(lock, [&](){
+                    return stopping || filled < slots.size();
+                });
+                if (stopping) return;
+            }
+            auto begin = std::chrono::steady_clock::now();
+            Slot& slot = slots[tail];
+            slot.rows = (start < rows) ? std::min(batch_size, rows - start):0;
+            size_t n = slot.rows * cols;
+            if (slot.rows > 0 && \
+                    (!read_fully(fd, slot.raw.data(), n, \
+                                        features_offset + start * cols) || \
+                    !read_fully(fd, slot.labels.data(), slot.rows, \
+                                                labels_offset + start))) {
+                std::cerr << "Error: Could not read the dataset." << std::endl;
+                // not an empty slot, which would end the epoch early and
+                // leave the next ones out of step
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    failed = true;
+                }
+                slot_ready.notify_one();
+                return;
+            }
+            for (size_t i = 0; i < n; i++){
+                slot.features[i] = slot.raw[i] / 255.0f;
+            }
+            std::chrono::duration<double> busy = \
+                                std::chrono::steady_clock::now() - begin;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                load_seconds += busy.count();
+                filled += 1;
+            }
+            slot_ready.notify_one();
+            tail = (tail + 1) % slots.size();
+            if (start >= rows) break;
+        }
+    }
+}
+
+bool BatchStream::next(Batch& batch){
+    auto begin = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    slot_ready.wait(lock, [&](){ return filled > 0 || failed; });
+    std::chrono::duration<double> waited = \
+                                std::chrono::steady_clock::now() - begin;
+    wait_seconds += waited.count();
+    if (failed) return false;
+    Slot& slot = slots[head];
+    if (slot.rows == 0) {
+        // end of epoch marker, hand it straight back
+        lock.unlock();
+        release();
+        return false;
+    }
+    batch.features = slot.features.data();
+    batch.labels = slot.labels.data();
+    batch.rows = slot.rows;
+    return true;
+}
+
+void BatchStream::release(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        head = (head + 1) % slots.size();
+        filled -= 1;
+    }
+    slot_free.notify_one();
+}
+
+bool BatchStream::has_failed(){
+    std::lock_guard<std::mutex> lock(mutex);
+    return failed;
+}
+
+size_t BatchStream::getRows() const {
+    return rows;
+}
+
+size_t BatchStream::getCols() const {
+    return cols;
+}
+
+void BatchStream::take_times(double& waited, double& loading){
+    std::lock_guard<std::mutex> lock(mutex);
+    waited = wait_seconds;
+    loading = load_seconds;
+    wait_seconds = load_seconds = 0;
+}
+
+void BatchStream::stop(){
+    if (!loader.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    slot_free.notify_all();
+    loader.join();
+}
+
+BatchStream::~BatchStream(){
+    stop();
+    if (fd >= 0) ::close(fd);
+}
@@ -0,0 +1,104 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Streams batches from a binary dataset file (see Dataset.h) that does not
+ *  need to fit in memory. A background thread reads the next batches into a
+ *  ring of buffers allocated once, and normalizes them to floats, while the
+ *  trainer works on the current one. Memory use is
+ *  n_buffers * batch_size * (4*cols + 1) bytes, whatever the file size.
+ */
+
+#pragma once
+
+#include<condition_variable>
+#include<cstddef>
+#include<cstdint>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
+
+class BatchStream {
+    private:
+        struct Slot {
+            std::vector<uint8_t> raw;      // bytes as read from the file
+            std::vector<float> features;   // raw / 255
+            std::vector<uint8_t> labels;
+            size_t rows = 0;               // 0 marks the end of an epoch
+        };
+        std::vector<Slot> slots;
+        size_t head = 0, filled = 0;       // head is the consumer's slot
+        bool stopping = false;
+        bool failed = false;               // a read failed, loader stopped
+        std::mutex mutex;
+        std::condition_variable slot_free, slot_ready;
+        std::thread loader;
+
+        int fd = -1;
+        size_t rows = 0, cols = 0, batch_size = 0;
+        uint64_t labels_offset = 0, features_offset = 0;
+
+        // seconds next() blocked because no batch was ready, and seconds the
+        // loader spent reading and converting
+        double wait_seconds = 0, load_seconds = 0;
+
+        void load(size_t epochs);
+        void stop();
+    public:
+        struct Batch {
+            const float* features;
+            const uint8_t* labels;
+            size_t rows;
+        };
+
+        BatchStream() = default;
+        BatchStream(const BatchStream&) = delete;
+        BatchStream& operator=(const BatchStream&) = delete;
+
+        /**
+         * @brief Opens a file written by Dataset::save_binary
+         *
+         * @param batch_size Rows per batch, the last one can be smaller
+         * @param n_buffers Number of batches that can be loaded ahead
+         * @return 1 on success, 0 if the file is missing or not valid
+         */
+        int open(const std::string& file_name, size_t batch_size, \
+                                                    size_t n_buffers=4);
+
+        /**
+         * @brief Starts the background loader for the given number of passes
+         *        over the file
+         */
+        void start(size_t epochs);
+
+        /**
+         * @brief Waits for the next batch. The batch stays valid until
+         *        release() is called.
+         *
+         * @return false at the end of an epoch or once a read failed
+         *         (nothing to release then), see has_failed()
+         */
+        bool next(Batch& batch);
+
+        /**
+         * @brief Whether the loader stopped on a read error, the batches
+         *        left in the run will never come
+         */
+        bool has_failed();
+
+        /**
+         * @brief Gives the buffer of the last batch back to the loader
+         */
+        void release();
+
+        size_t getRows() const;
+        size_t getCols() const;
+
+        /**
+         * @brief Returns and resets the time spent waiting on data since the
+         *        last call, and the time the loader was busy
+         */
+        void take_times(double& waited, double& loading);
+
+        ~BatchStream();
+};
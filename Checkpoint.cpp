@@ -0,0 +1,218 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the classes defined in Checkpoint.h
+ */
+
+#include"Checkpoint.h"
+#include<cstdio>
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+
+namespace {
+    // the parameters start on a page, so the mapped weights are aligned
+    // for any vector width and a page holds the parameters of one file only
+    constexpr uint64_t PAGE = 4096;
+
+    uint64_t align_up(uint64_t offset, uint64_t alignment){
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+}
+
+int Checkpoint::save(const std::string& file_name, \
+                            const std::vector<size_t>& sizes, \
+                            const std::vector<Activation>& activations, \
+                            const float* parameters, size_t n_parameters, \
+                            size_t epochs){
+    if (sizes.size() != activations.size() || parameters == nullptr) {
+        std::cerr << "Error: Nothing to save." << std::endl;
+        return 0;
+    }
+    CheckpointHeader header;
+    std::memcpy(header.magic, "NNCK", 4);
+    header.version = VERSION;
+    header.dtype = DTYPE_FLOAT32;
+    header.n_layers = sizes.size();
+    header.epochs = epochs;
+    header.n_parameters = n_parameters;
+    header.layers_offset = sizeof(CheckpointHeader);
+    header.parameters_offset = align_up(header.layers_offset + \
+                                sizes.size() * sizeof(CheckpointLayer), PAGE);
+
+    std::string tmp = file_name + ".tmp";
+    std::ofstream out(tmp, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open the file." << std::endl;
+        return 0;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (size_t l = 0; l < sizes.size(); l++){
+        CheckpointLayer layer = {sizes[l], (uint32_t)activations[l], 0};
+        out.write(reinterpret_cast<const char*>(&layer), sizeof(layer));
+    }
+    std::vector<char> padding(header.parameters_offset - header.layers_offset\
+                                    - sizes.size() * sizeof(CheckpointLayer));
+    out.write(padding.data(), padding.size());
+    out.write(reinterpret_cast<const char*>(parameters), \
+                                            n_parameters * sizeof(float));
+    out.close();
+    if (!out.good() || std::rename(tmp.c_str(), file_name.c_str()) != 0) {
+        std::cerr << "Error: Could not write " << file_name << std::endl;
+        std::remove(tmp.c_str());
+        return 0;
+    }
+    return 1;
+}
+
+int Checkpoint::open(const std::string& file_name){
+    int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open the file." << std::endl;
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || \
+                        (size_t)st.st_size < sizeof(CheckpointHeader)) {
+        std::cerr << "Error: " << file_name << " is not a checkpoint." << \
+                                                                    std::endl;
+        ::close(fd);
+        return 0;
+    }
+    size_t size = st.st_size;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file open
+    if (map == MAP_FAILED) {
+        std::cerr << "Error: Could not map the file." << std::endl;
+        return 0;
+    }
+
+    CheckpointHeader header;
+    std::memcpy(&header, map, sizeof(header));
+    if (std::memcmp(header.magic, "NNCK", 4) != 0 || \
+            header.version != VERSION || header.dtype != DTYPE_FLOAT32 || \
+            header.layers_offset + header.n_layers * \
+                                        sizeof(CheckpointLayer) > size || \
+            header.parameters_offset % PAGE != 0 || \
+            header.parameters_offset + \
+                            header.n_parameters * sizeof(float) > size) {
+        std::cerr << "Error: " << file_name << " is not a valid checkpoint."\
+                                                                << std::endl;
+        munmap(map, size);
+        return 0;
+    }
+
+    close();
+    mapping = map;
+    mapping_size = size;
+    const char* base = static_cast<const char*>(map);
+    const CheckpointLayer* layers = reinterpret_cast<const CheckpointLayer*>(\
+                                            base + header.layers_offset);
+    for (size_t l = 0; l < header.n_layers; l++){
+        if (layers[l].activation > (uint32_t)Activation::IDENTITY) {
+            std::cerr << "Error: Unknown activation in " << file_name << \
+                                                                    std::endl;
+            close();
+            return 0;
+        }
+        sizes.push_back(layers[l].size);
+        activations.push_back((Activation)layers[l].activation);
+    }
+    parameters = reinterpret_cast<const float*>(base + \
+                                                header.parameters_offset);
+    n_parameters = header.n_parameters;
+    epochs = header.epochs;
+    return 1;
+}
+
+void Checkpoint::close(){
+    if (mapping != nullptr) munmap(mapping, mapping_size);
+    mapping = nullptr;
+    mapping_size = 0;
+    sizes.clear();
+    activations.clear();
+    parameters = nullptr;
+    n_parameters = epochs = 0;
+}
+
+const std::vector<size_t>& Checkpoint::getSizes() const {
+    return sizes;
+}
+
+const std::vector<Activation>& Checkpoint::getActivations() const {
+    return activations;
+}
+
+const float* Checkpoint::getParameters() const {
+    return parameters;
+}
+
+size_t Checkpoint::getParameterSize() const {
+    return n_parameters;
+}
+
+size_t Checkpoint::getEpochs() const {
+    return epochs;
+}
+
+Checkpoint::~Checkpoint(){
+    close();
+}
+
+void CheckpointWriter::start(const std::string& file_name){
+    std::lock_guard<std::mutex> lock(mutex);
+    this->file_name = file_name;
+    if (writer.joinable()) return;
+    stopping = false;
+    writer = std::thread(&CheckpointWriter::run, this);
+}
+
+void CheckpointWriter::submit(const std::vector<size_t>& sizes, \
+                            const std::vector<Activation>& activations, \
+                            const float* parameters, size_t n_parameters, \
+                            size_t epochs){
+    {
+        // the copy is the only cost for the trainer, the buffer keeps its
+        // capacity so after the first submit nothing is allocated
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.sizes = sizes;
+        pending.activations = activations;
+        pending.parameters.assign(parameters, parameters + n_parameters);
+        pending.epochs = epochs;
+        has_pending = true;
+    }
+    wake.notify_one();
+}
+
+void CheckpointWriter::run(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true){
+        wake.wait(lock, [this]{ return has_pending || stopping; });
+        if (!has_pending) break;
+        std::swap(pending, writing);
+        has_pending = false;
+        std::string target = file_name;
+        lock.unlock();
+        Checkpoint::save(target, writing.sizes, writing.activations, \
+                writing.parameters.data(), writing.parameters.size(), \
+                writing.epochs);
+        lock.lock();
+    }
+}
+
+void CheckpointWriter::stop(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (writer.joinable()) writer.join();
+}
+
+CheckpointWriter::~CheckpointWriter(){
+    stop();
+}
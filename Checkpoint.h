@@ -0,0 +1,144 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Saved networks. A checkpoint holds the topology, the activation of every
+ *  layer and the parameters block exactly as the network keeps it in
+ *  memory, so loading is a mmap and no parsing or copy: the weights of an
+ *  InferenceModel point straight at the mapped pages, which every process
+ *  serving the same file shares.
+ *
+ *  Layout (little endian):
+ *      CheckpointHeader
+ *      CheckpointLayer  - n_layers of them, at layers_offset
+ *      parameters       - n_parameters values of dtype, at
+ *                         parameters_offset (page aligned)
+ */
+
+#pragma once
+
+#include"ActivationFuncs.h"
+#include<condition_variable>
+#include<cstddef>
+#include<cstdint>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
+
+struct CheckpointHeader {
+    char magic[4];              // "NNCK"
+    uint32_t version;
+    uint32_t dtype;             // Checkpoint::DTYPE_*
+    uint32_t n_layers;
+    uint64_t epochs;            // epochs trained when it was saved
+    uint64_t n_parameters;      // padding of the layers included
+    uint64_t layers_offset;
+    uint64_t parameters_offset;
+};
+
+struct CheckpointLayer {
+    uint64_t size;
+    uint32_t activation;        // the value of the Activation enum
+    uint32_t reserved;
+};
+
+class Checkpoint {
+    private:
+        void* mapping = nullptr;
+        size_t mapping_size = 0;
+        std::vector<size_t> sizes;
+        std::vector<Activation> activations;
+        const float* parameters = nullptr;
+        size_t n_parameters = 0;
+        size_t epochs = 0;
+    public:
+        static constexpr uint32_t VERSION = 1;
+        static constexpr uint32_t DTYPE_FLOAT32 = 0;
+
+        Checkpoint() = default;
+        Checkpoint(const Checkpoint&) = delete;
+        Checkpoint& operator=(const Checkpoint&) = delete;
+
+        /**
+         * @brief Writes a checkpoint. It goes to file_name.tmp first and is
+         *        renamed, so a crash never leaves a half written file.
+         *
+         * @param parameters The parameters block (see
+         *                   NeuralNetwork::getParameters)
+         */
+        static int save(const std::string& file_name, \
+                            const std::vector<size_t>& sizes, \
+                            const std::vector<Activation>& activations, \
+                            const float* parameters, size_t n_parameters, \
+                            size_t epochs);
+
+        /**
+         * @brief Maps a checkpoint read-only, the parameters are not copied
+         *
+         * @return 1 on success, 0 if the file is missing or not valid
+         */
+        int open(const std::string& file_name);
+
+        /**
+         * @brief Unmaps the file, the parameters become invalid
+         */
+        void close();
+
+        const std::vector<size_t>& getSizes() const;
+        const std::vector<Activation>& getActivations() const;
+        const float* getParameters() const;
+        size_t getParameterSize() const;
+        size_t getEpochs() const;
+
+        ~Checkpoint();
+};
+
+/**
+ * @brief Saves checkpoints on a background thread. submit() only copies
+ *        the parameters to a staging buffer, the slow write to the disk
+ *        happens while training goes on. If a write is still running, a
+ *        newer submit replaces the one waiting, so training never blocks on
+ *        the disk.
+ */
+class CheckpointWriter {
+    private:
+        struct Snapshot {
+            std::vector<size_t> sizes;
+            std::vector<Activation> activations;
+            std::vector<float> parameters;
+            size_t epochs = 0;
+        };
+        Snapshot pending, writing;
+        bool has_pending = false, stopping = false;
+        std::string file_name;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::thread writer;
+
+        void run();
+    public:
+        CheckpointWriter() = default;
+        CheckpointWriter(const CheckpointWriter&) = delete;
+        CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+        /**
+         * @brief Starts the writer thread if needed, checkpoints go to
+         *        file_name
+         */
+        void start(const std::string& file_name);
+
+        /**
+         * @brief Queues a copy of the parameters to be written
+         */
+        void submit(const std::vector<size_t>& sizes, \
+                            const std::vector<Activation>& activations, \
+                            const float* parameters, size_t n_parameters, \
+                            size_t epochs);
+
+        /**
+         * @brief Writes what is still queued and stops the thread
+         */
+        void stop();
+
+        ~CheckpointWriter();
+};
@@ -4,11 +4,17 @@
  * Definitions of various cost functions
  */
 
-#include<cstring>
 #pragma once
+#include<cmath>
+#include<cstring>
+
+enum class Cost { MSE, CROSS_ENTROPY };
 
 namespace CostFuncs {
-    float MSE (float* y, float* target, size_t size){
+    // Smallest probability the cross entropy takes the log of
+    constexpr float MIN_PROBABILITY = 1e-7f;
+
+    inline float MSE (const float* y, const float* target, size_t size){
         float total = 0.0f;
         for (size_t i = 0; i < size; i++){
             // Direct multiplication is faster than std::powf or std::expf
@@ -16,4 +22,47 @@ namespace CostFuncs {
         }
         return total;
     };
-}
\ No newline at end of file
+
+    inline float CrossEntropy(const float* y, const float* target, \
+                                                            size_t size){
+        float total = 0.0f;
+        for (size_t i = 0; i < size; i++){
+            if (target[i] != 0.0f) {
+                total -= target[i] * std::log(std::fmax(y[i], \
+                                                        MIN_PROBABILITY));
+            }
+        }
+        return total;
+    };
+
+    /*
+     * Policies for the training loop, with a one-hot target given as the
+     * index of its class. loss_gradient writes dLoss/dy to grad and returns
+     * the loss of the sample.
+     */
+    struct MSEPolicy {
+        static float loss_gradient(const float* y, size_t target, \
+                                                float* grad, size_t size){
+            float total = 0.0f;
+            for (size_t i = 0; i < size; i++){
+                float diff = y[i] - (i == target ? 1.0f : 0.0f);
+                grad[i] = 2.0f * diff;
+                total += diff * diff;
+            }
+            return total;
+        }
+    };
+
+    struct CrossEntropyPolicy {
+        static float loss_gradient(const float* y, size_t target, \
+                                                float* grad, size_t size){
+            for (size_t i = 0; i < size; i++){
+                grad[i] = 0.0f;
+            }
+            if (target >= size) return 0.0f;
+            float p = std::fmax(y[target], MIN_PROBABILITY);
+            grad[target] = -1.0f / p;
+            return -std::log(p);
+        }
+    };
+}
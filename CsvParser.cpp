@@ -0,0 +1,188 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the csv parser declared in CsvParser.h
+ */
+
+#include"CsvParser.h"
+#include<algorithm>
+#include<cstring>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+
+#if defined(__SSE2__)
+#include<emmintrin.h>
+#elif defined(__aarch64__)
+#include<arm_neon.h>
+#endif
+
+size_t CsvParser::count_lines(const char* begin, const char* end){
+    size_t count = 0;
+    const char* p = begin;
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; p + 16 <= end; p += 16){
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline));
+        count += __builtin_popcount(mask);
+    }
+#elif defined(__aarch64__)
+    const uint8x16_t newline = vdupq_n_u8('\n');
+    for (; p + 16 <= end; p += 16){
+        uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(p));
+        // equal lanes are 0xFF, shifted down to 1 and summed
+        count += vaddvq_u8(vshrq_n_u8(vceqq_u8(bytes, newline), 7));
+    }
+#endif
+    for (; p < end; p++){
+        count += (*p == '\n');
+    }
+    return count;
+}
+
+namespace {
+    /**
+     * @brief Parses one line of numbers
+     *
+     * @return The number of fields, or -1 if a field is not a number in
+     *         0-255
+     */
+    long parse_line(const char* p, const char* end, uint8_t* label, \
+                                        uint8_t* row, size_t n_features){
+        long field = 0;
+        while (p < end){
+            unsigned value = 0;
+            const char* start = p;
+            while (p < end && (unsigned)(*p - '0') < 10){
+                value = value*10 + (*p - '0');
+                if (value > 255) value = 256; // clamped, can't overflow
+                p++;
+            }
+            // out of range, even a label: class 300 is not class 255
+            if (p == start || value > 255) return -1;
+            while (p < end && (*p == ' ' || *p == '\r')) p++;
+            if (p < end && *p != ',') return -1;
+            p++; // the comma
+            uint8_t v = (uint8_t)value;
+            if (field == 0) {
+                *label = v;
+            } else if ((size_t)field <= n_features) {
+                row[field - 1] = v;
+            }
+            field++;
+        }
+        return field;
+    }
+
+    bool starts_with_number(const char* p, const char* end){
+        return p < end && (unsigned)(*p - '0') < 10;
+    }
+}
+
+long CsvParser::parse(const std::string& file_name, ThreadPool& pool, \
+                std::vector<uint8_t>& features, std::vector<uint8_t>& labels,\
+                                                        size_t& n_features){
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    size_t size = st.st_size;
+    features.clear();
+    labels.clear();
+    n_features = 0;
+    if (size == 0) {
+        close(fd);
+        return 0;
+    }
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+    madvise(map, size, MADV_SEQUENTIAL);
+    const char* begin = static_cast<const char*>(map);
+    const char* end = begin + size;
+
+    // header line
+    if (!starts_with_number(begin, end)) {
+        const char* nl = static_cast<const char*>(std::memchr(begin, '\n', \
+                                                                size));
+        begin = (nl == nullptr) ? end : nl + 1;
+    }
+    // the first data line sets the number of columns
+    const char* first_end = static_cast<const char*>(std::memchr(begin, \
+                                                        '\n', end - begin));
+    if (first_end == nullptr) first_end = end;
+    n_features = std::count(begin, first_end, ',');
+
+    // one chunk per thread, each ends right after a newline
+    size_t n_chunks = std::max<size_t>(1, std::min(pool.size(), \
+                                        (size_t)(end - begin) / (1 << 16)));
+    std::vector<const char*> bounds(n_chunks + 1, end);
+    bounds[0] = begin;
+    for (size_t c = 1; c < n_chunks; c++){
+        const char* p = begin + (end - begin) * c / n_chunks;
+        p = std::max(p, bounds[c-1]);
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', \
+                                                                end - p));
+        bounds[c] = (nl == nullptr) ? end : nl + 1;
+    }
+
+    // pass 1: rows per chunk, to know where each chunk writes its rows
+    std::vector<size_t> first_row(n_chunks + 1, 0);
+    pool.run(n_chunks, [&](size_t c){
+        size_t lines = count_lines(bounds[c], bounds[c+1]);
+        if (bounds[c+1] == end && end > bounds[c] && end[-1] != '\n') {
+            lines += 1; // last line without a newline
+        }
+        first_row[c+1] = lines;
+    });
+    for (size_t c = 0; c < n_chunks; c++){
+        first_row[c+1] += first_row[c];
+    }
+    size_t max_rows = first_row[n_chunks];
+    features.resize(max_rows * n_features);
+    labels.resize(max_rows);
+
+    // pass 2: parse, good rows are packed at the start of the chunk's range
+    std::vector<size_t> good_rows(n_chunks, 0), blank_rows(n_chunks, 0);
+    pool.run(n_chunks, [&](size_t c){
+        const char* p = bounds[c];
+        size_t row = first_row[c];
+        while (p < bounds[c+1]){
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', \
+                                                            bounds[c+1] - p));
+            const char* line_end = (nl == nullptr) ? bounds[c+1] : nl;
+            if (line_end == p || (line_end == p + 1 && *p == '\r')) {
+                blank_rows[c] += 1;
+                p = line_end + 1;
+                continue;
+            }
+            long fields = parse_line(p, line_end, &labels[row], \
+                                &features[row * n_features], n_features);
+            if (fields == (long)n_features + 1) row++;
+            p = line_end + 1;
+        }
+        good_rows[c] = row - first_row[c];
+    });
+    munmap(map, size);
+
+    // move the rows of every chunk down over the skipped ones
+    size_t rows = good_rows[0], blanks = blank_rows[0];
+    for (size_t c = 1; c < n_chunks; c++){
+        if (rows != first_row[c]) {
+            std::memmove(&features[rows * n_features], \
+                &features[first_row[c] * n_features], \
+                                        good_rows[c] * n_features);
+            std::memmove(&labels[rows], &labels[first_row[c]], good_rows[c]);
+        }
+        rows += good_rows[c];
+        blanks += blank_rows[c];
+    }
+    features.resize(rows * n_features);
+    labels.resize(rows);
+    return max_rows - rows - blanks;
+}
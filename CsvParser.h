@@ -0,0 +1,41 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Parser for the csv files of integers used as training data (target in
+ *  the first column, features in the others). The file is mapped in one go,
+ *  cut at line boundaries into one chunk per thread and every chunk is
+ *  parsed straight into its rows of one contiguous buffer. No iostreams,
+ *  no locale and no exceptions.
+ */
+
+#pragma once
+
+#include"ThreadPool.h"
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+namespace CsvParser {
+    /**
+     * @brief Parses a csv file. A first line that does not start with a
+     *        number is taken as the header and skipped. Rows with a
+     *        different number of columns than the first one or with
+     *        fields that are not numbers in 0-255 are skipped.
+     *
+     * @param file_name The file to parse
+     * @param pool The threads to parse with
+     * @param features Set to rows*n_features values, row-major
+     * @param labels Set to the first column of every row
+     * @param n_features Set to the number of columns minus the label
+     * @return The number of skipped rows, or -1 if the file can't be read
+     */
+    long parse(const std::string& file_name, ThreadPool& pool, \
+                std::vector<uint8_t>& features, std::vector<uint8_t>& labels,\
+                                                        size_t& n_features);
+
+    /**
+     * @brief Counts the newlines in [begin, end), 16 bytes at a time
+     */
+    size_t count_lines(const char* begin, const char* end);
+}
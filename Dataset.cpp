@@ -0,0 +1,146 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the Dataset class defined in Dataset.h
+ */
+
+#include"Dataset.h"
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+
+namespace {
+    // features start on a cache line so rows can be read with aligned loads
+    constexpr uint64_t ALIGNMENT = 64;
+
+    uint64_t align_up(uint64_t offset){
+        return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+}
+
+int Dataset::assign(std::vector<uint8_t> features, \
+                        std::vector<uint8_t> labels, size_t cols){
+    if (cols == 0 || features.size() != labels.size() * cols) {
+        std::cerr << "Error: Features do not match the labels." << std::endl;
+        return 0;
+    }
+    clear();
+    owned_features = std::move(features);
+    owned_labels = std::move(labels);
+    this->features = owned_features.data();
+    this->labels = owned_labels.data();
+    this->rows = owned_labels.size();
+    this->cols = cols;
+    return 1;
+}
+
+int Dataset::open_binary(const std::string& file_name){
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error: Could not open the file." << std::endl;
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(DatasetHeader)) {
+        std::cerr << "Error: " << file_name << " is not a dataset." << \
+                                                                    std::endl;
+        close(fd);
+        return 0;
+    }
+    size_t size = st.st_size;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (map == MAP_FAILED) {
+        std::cerr << "Error: Could not map the file." << std::endl;
+        return 0;
+    }
+
+    DatasetHeader header;
+    std::memcpy(&header, map, sizeof(header));
+    if (std::memcmp(header.magic, "NNDS", 4) != 0 || \
+            header.version != VERSION || \
+            header.labels_offset + header.rows > size || \
+            header.features_offset + header.rows * header.cols > size) {
+        std::cerr << "Error: " << file_name << " is not a valid dataset." << \
+                                                                    std::endl;
+        munmap(map, size);
+        return 0;
+    }
+    // training walks the rows in order
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    clear();
+    mapping = map;
+    mapping_size = size;
+    const uint8_t* base = static_cast<const uint8_t*>(map);
+    labels = base + header.labels_offset;
+    features = base + header.features_offset;
+    rows = header.rows;
+    cols = header.cols;
+    return 1;
+}
+
+int Dataset::save_binary(const std::string& file_name) const{
+    std::ofstream out(file_name, std::ios::binary);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not open the file." << std::endl;
+        return 0;
+    }
+    DatasetHeader header;
+    std::memcpy(header.magic, "NNDS", 4);
+    header.version = VERSION;
+    header.rows = rows;
+    header.cols = cols;
+    header.labels_offset = align_up(sizeof(DatasetHeader));
+    header.features_offset = align_up(header.labels_offset + rows);
+
+    const char padding[ALIGNMENT] = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(padding, header.labels_offset - sizeof(header));
+    out.write(reinterpret_cast<const char*>(labels), rows);
+    out.write(padding, header.features_offset - header.labels_offset - rows);
+    out.write(reinterpret_cast<const char*>(features), rows * cols);
+    return out.good() ? 1 : 0;
+}
+
+void Dataset::clear(){
+    if (mapping != nullptr) munmap(mapping, mapping_size);
+    mapping = nullptr;
+    mapping_size = 0;
+    owned_features = std::vector<uint8_t>();
+    owned_labels = std::vector<uint8_t>();
+    features = labels = nullptr;
+    rows = cols = 0;
+}
+
+size_t Dataset::getRows() const {
+    return rows;
+}
+
+size_t Dataset::getCols() const {
+    return cols;
+}
+
+const uint8_t* Dataset::getFeatures() const {
+    return features;
+}
+
+const uint8_t* Dataset::getLabels() const {
+    return labels;
+}
+
+const uint8_t* Dataset::getRow(size_t i) const {
+    return features + i*cols;
+}
+
+uint8_t Dataset::getLabel(size_t i) const {
+    return labels[i];
+}
+
+Dataset::~Dataset(){
+    clear();
+}
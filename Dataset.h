@@ -0,0 +1,88 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  The samples used for training, stored as one contiguous block of bytes.
+ *  They either come from a csv file (see NeuralNetwork::read_input) or are
+ *  mapped straight from a binary file written by save_binary, which needs
+ *  no parsing and no copy, so opening it takes the same time for any size.
+ *
+ *  Binary layout (little endian):
+ *      DatasetHeader
+ *      labels   - rows bytes, at labels_offset
+ *      features - rows*cols bytes, row-major, at features_offset
+ */
+
+#pragma once
+
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+struct DatasetHeader {
+    char magic[4];              // "NNDS"
+    uint32_t version;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t labels_offset;
+    uint64_t features_offset;
+};
+
+class Dataset {
+    private:
+        // used when the data was parsed from a csv
+        std::vector<uint8_t> owned_features, owned_labels;
+        // used when the data is mapped from a binary file
+        void* mapping = nullptr;
+        size_t mapping_size = 0;
+
+        const uint8_t* features = nullptr;
+        const uint8_t* labels = nullptr;
+        size_t rows = 0, cols = 0;
+    public:
+        static constexpr uint32_t VERSION = 1;
+
+        Dataset() = default;
+        Dataset(const Dataset&) = delete;
+        Dataset& operator=(const Dataset&) = delete;
+
+        /**
+         * @brief Takes ownership of samples that are already in memory
+         *
+         * @param features rows*cols pixel values, row-major
+         * @param labels The class of every row
+         * @param cols The number of features in one row
+         */
+        int assign(std::vector<uint8_t> features, std::vector<uint8_t> labels,\
+                                                                size_t cols);
+
+        /**
+         * @brief Maps a file written by save_binary, nothing is copied
+         *
+         * @return 1 on success, 0 if the file is missing or not valid
+         */
+        int open_binary(const std::string& file_name);
+
+        /**
+         * @brief Writes the samples in the binary format
+         */
+        int save_binary(const std::string& file_name) const;
+
+        /**
+         * @brief Releases the samples (and the mapping if any)
+         */
+        void clear();
+
+        size_t getRows() const;
+        size_t getCols() const;
+        const uint8_t* getFeatures() const;
+        const uint8_t* getLabels() const;
+
+        /**
+         * @brief Gets the cols features of sample i
+         */
+        const uint8_t* getRow(size_t i) const;
+        uint8_t getLabel(size_t i) const;
+
+        ~Dataset();
+};
@@ -0,0 +1,167 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the InferenceModel class defined in InferenceModel.h
+ */
+
+#include"InferenceModel.h"
+#include"Layer.h"
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+
+int InferenceModel::load(const std::vector<size_t>& sizes, \
+                        const std::vector<Activation>& activations, \
+                        const float* parameters){
+    if (sizes.size() < 2 || activations.size() != sizes.size() || \
+                                                    parameters == nullptr) {
+        std::cerr << "Error: Need at least 2 layers to make a model." \
+                                                                << std::endl;
+        return 0;
+    }
+    size_t n_parameters = 0;
+    for (size_t l = 1; l < sizes.size(); l++){
+        n_parameters += Arena::round_up(sizes[l] * sizes[l-1]) + \
+                                                Arena::round_up(sizes[l]);
+    }
+    checkpoint.close();
+    this->parameters.reserve(n_parameters);
+    std::memcpy(this->parameters.data(), parameters, \
+                                        n_parameters * sizeof(float));
+    this->sizes = sizes;
+    this->activations = activations;
+    bind(this->parameters.data());
+    return 1;
+}
+
+int InferenceModel::view(const std::vector<size_t>& sizes, \
+                        const std::vector<Activation>& activations, \
+                        const float* parameters){
+    if (sizes.size() < 2 || activations.size() != sizes.size() || \
+                                                    parameters == nullptr) {
+        std::cerr << "Error: Need at least 2 layers to make a model." \
+                                                                << std::endl;
+        return 0;
+    }
+    checkpoint.close();
+    this->parameters.reserve(0);
+    this->sizes = sizes;
+    this->activations = activations;
+    bind(parameters);
+    return 1;
+}
+
+int InferenceModel::load(const std::string& file_name){
+    if (!checkpoint.open(file_name)) return 0;
+    const std::vector<size_t>& sizes = checkpoint.getSizes();
+    size_t n_parameters = 0;
+    for (size_t l = 1; l < sizes.size(); l++){
+        n_parameters += Arena::round_up(sizes[l] * sizes[l-1]) + \
+                                                Arena::round_up(sizes[l]);
+    }
+    if (sizes.size() < 2 || n_parameters != checkpoint.getParameterSize()) {
+        std::cerr << "Error: " << file_name << " does not match its layers."\
+                                                                << std::endl;
+        checkpoint.close();
+        return 0;
+    }
+    this->parameters.reserve(0);
+    this->sizes = sizes;
+    this->activations = checkpoint.getActivations();
+    bind(checkpoint.getParameters());
+    return 1;
+}
+
+void InferenceModel::bind(const float* parameters){
+    // same walk as Arena::take over the block
+    weights.assign(sizes.size(), nullptr);
+    bias.assign(sizes.size(), nullptr);
+    sparse.assign(sizes.size(), Sparse::Csr());
+    for (size_t l = 1; l < sizes.size(); l++){
+        weights[l] = parameters;
+        parameters += Arena::round_up(sizes[l] * sizes[l-1]);
+        bias[l] = parameters;
+        parameters += Arena::round_up(sizes[l]);
+        size_t n = sizes[l] * sizes[l-1];
+        if (Sparse::density(weights[l], n) < Sparse::crossover_density()) {
+            sparse[l] = Sparse::from_dense(weights[l], sizes[l], \
+                                                    sizes[l-1], sizes[l-1]);
+        }
+    }
+    reserve_buffers(max_batch > 0 ? max_batch : 64);
+}
+
+void InferenceModel::reserve_buffers(size_t batch){
+    max_batch = batch;
+    if (sizes.empty()) return;
+    // the input and output are the caller's, only the hidden layers need
+    // room in the buffers
+    size_t widest = 0;
+    for (size_t l = 1; l + 1 < sizes.size(); l++){
+        widest = std::max(widest, sizes[l]);
+    }
+    buffers.reserve(2 * Arena::round_up(widest * batch));
+    ping_pong[0] = buffers.take(widest * batch);
+    ping_pong[1] = buffers.take(widest * batch);
+}
+
+void InferenceModel::set_max_batch(size_t batch){
+    reserve_buffers(std::max<size_t>(batch, 1));
+}
+
+int InferenceModel::predict(const float* X, size_t n, float* out){
+    if (sizes.empty()) {
+        std::cerr << "Error: No model loaded." << std::endl;
+        return 0;
+    }
+    size_t n_layers = sizes.size();
+    for (size_t start = 0; start < n; start += max_batch){
+        size_t rows = std::min(max_batch, n - start);
+        const float* input = X + start * sizes[0];
+        for (size_t l = 1; l < n_layers; l++){
+            // the last layer writes straight to the caller's buffer
+            float* output = l + 1 == n_layers ? \
+                out + start * sizes[l] : ping_pong[l % 2];
+            if (sparse[l].rows > 0) {
+                Layer::sparse_forward(sparse[l], bias[l], activations[l], \
+                                                    input, output, rows);
+            } else {
+                Layer::dense_forward(weights[l], bias[l], sizes[l], \
+                            sizes[l-1], activations[l], input, output, rows);
+            }
+            input = output;
+        }
+    }
+    return 1;
+}
+
+int InferenceModel::predict_class(const float* X, size_t n, \
+                                                        size_t* classes){
+    size_t n_out = getOutputSize();
+    std::vector<float> out(std::min(n, max_batch) * n_out);
+    for (size_t start = 0; start < n; start += max_batch){
+        size_t rows = std::min(max_batch, n - start);
+        if (!predict(X + start * sizes[0], rows, out.data())) return 0;
+        for (size_t r = 0; r < rows; r++){
+            const float* y = out.data() + r * n_out;
+            classes[start + r] = std::max_element(y, y + n_out) - y;
+        }
+    }
+    return 1;
+}
+
+size_t InferenceModel::getSparseLayerCount() const {
+    size_t count = 0;
+    for (const Sparse::Csr& csr : sparse){
+        count += csr.rows > 0;
+    }
+    return count;
+}
+
+size_t InferenceModel::getInputSize() const {
+    return sizes.empty() ? 0 : sizes.front();
+}
+
+size_t InferenceModel::getOutputSize() const {
+    return sizes.empty() ? 0 : sizes.back();
+}
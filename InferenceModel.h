@@ -0,0 +1,103 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  A frozen copy of a trained network for serving. It keeps only the
+ *  weights and biases (in the same layout as NeuralNetwork's parameters
+ *  block) and two activation buffers sized for the widest layer, which the
+ *  layers write to in turn. No deltas, gradients or optimizer state.
+ *  The parameters are either copied from a network or mapped from a
+ *  checkpoint file. Layers pruned enough for it (see Sparse.h) are run on
+ *  a CSR copy of their weights.
+ */
+
+#pragma once
+
+#include"ActivationFuncs.h"
+#include"Arena.h"
+#include"Checkpoint.h"
+#include"Sparse.h"
+#include<cstddef>
+#include<vector>
+
+class InferenceModel {
+    private:
+        std::vector<size_t> sizes;
+        std::vector<Activation> activations;
+        std::vector<const float*> weights, bias; // per layer, none for 0
+        // the weights in CSR of the layers below the crossover density,
+        // empty (0 rows) for the dense ones
+        std::vector<Sparse::Csr> sparse;
+        Arena parameters; // a copy, unless they come from the checkpoint
+        Checkpoint checkpoint;
+        Arena buffers; // the two ping-pong buffers
+        float* ping_pong[2] = {nullptr, nullptr};
+        size_t max_batch = 0;
+
+        void reserve_buffers(size_t batch);
+
+        /**
+         * @brief Points the weights and bias of every layer into the
+         *        parameters block and converts the sparse ones to CSR,
+         *        sizes must be set
+         */
+        void bind(const float* parameters);
+    public:
+        InferenceModel() = default;
+        InferenceModel(const InferenceModel&) = delete;
+        InferenceModel& operator=(const InferenceModel&) = delete;
+
+        /**
+         * @brief Copies the parameters of a network
+         *
+         * @param sizes The neurons of every layer, input layer first
+         * @param activations The activation of every layer
+         * @param parameters The weights and bias of every layer, laid out
+         *                   like NeuralNetwork::getParameters()
+         */
+        int load(const std::vector<size_t>& sizes, \
+                        const std::vector<Activation>& activations, \
+                        const float* parameters);
+
+        /**
+         * @brief Same as the load above, but runs on the parameters in
+         *        place instead of a copy. They must stay valid and must not
+         *        change while the model uses them.
+         */
+        int view(const std::vector<size_t>& sizes, \
+                        const std::vector<Activation>& activations, \
+                        const float* parameters);
+
+        /**
+         * @brief Maps a checkpoint (see Checkpoint.h), the weights are read
+         *        from the mapped pages without a copy
+         */
+        int load(const std::string& file_name);
+
+        /**
+         * @brief Sizes the activation buffers for batches of up to batch
+         *        samples, predict() splits larger calls. Defaults to 64.
+         */
+        void set_max_batch(size_t batch);
+
+        /**
+         * @brief Runs n samples through the network, max_batch at a time.
+         *        Uses the model's buffers, so one call at a time per model.
+         *
+         * @param X n rows of getInputSize() floats
+         * @param out n rows of getOutputSize() floats
+         */
+        int predict(const float* X, size_t n, float* out);
+
+        /**
+         * @brief The index of the largest output of every sample
+         */
+        int predict_class(const float* X, size_t n, size_t* classes);
+
+        /**
+         * @brief Number of layers run on CSR weights
+         */
+        size_t getSparseLayerCount() const;
+
+        size_t getInputSize() const;
+        size_t getOutputSize() const;
+};
@@ -0,0 +1,1402 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the kernels declared in Kernels.h
+ */
+
+#include"Kernels.h"
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+#include<vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NN_X86
+#include<immintrin.h>
+#elif defined(__aarch64__)
+#define NN_NEON
+#include<arm_neon.h>
+#endif
+
+namespace {
+    float scalar_dot(const float* a, const float* b, size_t n){
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; i++){
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+    void scalar_axpy(size_t n, float alpha, const float* x, float* y){
+        for (size_t i = 0; i < n; i++){
+            y[i] += alpha * x[i];
+        }
+    }
+
+    void scalar_rank1_update(size_t m, size_t n, float alpha, \
+                        const float* x, const float* y, float* A, size_t lda){
+        for (size_t i = 0; i < m; i++){
+            scalar_axpy(n, alpha * x[i], y, A + i*lda);
+        }
+    }
+
+    void scalar_sgd_step(size_t n, float alpha, float* grad, float* param){
+        for (size_t i = 0; i < n; i++){
+            param[i] += alpha * grad[i];
+            grad[i] = 0.0f;
+        }
+    }
+
+    void scalar_packed_gemv(size_t kc, size_t nb, const float* a, \
+                                            const float* packed, float* c){
+        for (size_t k = 0; k < kc; k++){
+            scalar_axpy(nb, a[k], packed + k*nb, c);
+        }
+    }
+
+    int32_t scalar_dot_u8s8(const uint8_t* a, const int8_t* b, size_t n){
+        int32_t sum = 0;
+        for (size_t i = 0; i < n; i++){
+            sum += (int32_t)a[i] * (int32_t)b[i];
+        }
+        return sum;
+    }
+
+    void scalar_momentum_step(size_t n, float lr, float mu, float scale, \
+                                float* grad, float* velocity, float* param){
+        for (size_t i = 0; i < n; i++){
+            velocity[i] = mu * velocity[i] + scale * grad[i];
+            param[i] -= lr * velocity[i];
+            grad[i] = 0.0f;
+        }
+    }
+
+    void scalar_adam_step(size_t n, const Kernels::AdamStep& s, \
+                                float* grad, float* m, float* v, float* param){
+        for (size_t i = 0; i < n; i++){
+            float g = s.grad_scale * grad[i];
+            m[i] = s.beta1 * m[i] + (1.0f - s.beta1) * g;
+            v[i] = s.beta2 * v[i] + (1.0f - s.beta2) * g * g;
+            param[i] = param[i] * s.decay - s.step_size * m[i] / \
+                                (std::sqrt(v[i] * s.v_correction) + s.epsilon);
+            grad[i] = 0.0f;
+        }
+    }
+
+    void scalar_to_bf16(size_t n, const float* x, Kernels::bf16* y){
+        for (size_t i = 0; i < n; i++){
+            uint32_t bits;
+            std::memcpy(&bits, x + i, sizeof(bits));
+            if ((bits & 0x7FFFFFFF) > 0x7F800000) {
+                // a NaN stays a NaN, rounding could make it infinite
+                y[i] = (Kernels::bf16)((bits >> 16) | 0x40);
+                continue;
+            }
+            // adding 0x7FFF (+1 if odd) carries into the kept bits exactly
+            // when the dropped ones are above half, or half and kept is odd
+            bits += 0x7FFF + ((bits >> 16) & 1);
+            y[i] = (Kernels::bf16)(bits >> 16);
+        }
+    }
+
+    float scalar_dot_bf16(const Kernels::bf16* a, const Kernels::bf16* b, \
+                                                                size_t n){
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; i++){
+            sum += Kernels::from_bf16(a[i]) * Kernels::from_bf16(b[i]);
+        }
+        return sum;
+    }
+
+    void scalar_to_fp32(size_t n, const Kernels::bf16* x, float* y){
+        for (size_t i = 0; i < n; i++){
+            y[i] = Kernels::from_bf16(x[i]);
+        }
+    }
+
+    // a[k], a[k+1] as one pair of the packed layout, 0 past the end
+    inline uint32_t bf16_pair(const Kernels::bf16* a, size_t k, size_t kc){
+        return a[k] | (k + 1 < kc ? (uint32_t)a[k + 1] << 16 : 0u);
+    }
+
+    void scalar_packed_gemv_bf16(size_t kc, size_t nb, const Kernels::bf16* a,\
+                                    const Kernels::bf16* packed, float* c){
+        for (size_t k = 0; k < kc; k += 2){
+            float a0 = Kernels::from_bf16(a[k]);
+            float a1 = k + 1 < kc ? Kernels::from_bf16(a[k + 1]) : 0.0f;
+            const Kernels::bf16* p = packed + k*nb;
+            for (size_t j = 0; j < nb; j++){
+                c[j] += a0 * Kernels::from_bf16(p[2*j]) + \
+                                        a1 * Kernels::from_bf16(p[2*j + 1]);
+            }
+        }
+    }
+
+    /**
+     * @brief y = y / sum, and delta = y - onehot(target) if there is a delta
+     */
+    void softmax_finish(size_t n, float inv, size_t target, float* y, \
+                                                            float* delta){
+        for (size_t i = 0; i < n; i++){
+            y[i] *= inv;
+        }
+        if (delta == nullptr) return;
+        std::memcpy(delta, y, n * sizeof(float));
+        if (target < n) delta[target] -= 1.0f;
+    }
+
+    float scalar_softmax_cross_entropy(size_t n, const float* z, \
+                                size_t target, float* y, float* delta){
+        float max = z[0];
+        for (size_t i = 1; i < n; i++){
+            max = std::max(max, z[i]);
+        }
+        // read before y overwrites it, z can be y
+        float zt = target < n ? z[target] : 0.0f;
+        float sum = 0.0f;
+        for (size_t i = 0; i < n; i++){
+            y[i] = std::exp(z[i] - max);
+            sum += y[i];
+        }
+        softmax_finish(n, 1.0f / sum, target, y, delta);
+        // -log(exp(zt - max) / sum), without the log of a tiny probability
+        return target < n ? std::log(sum) - (zt - max) : 0.0f;
+    }
+
+    // Constants of the vector exp: x = n*ln2 + r with |r| <= ln2/2, ln2
+    // split in two so n*ln2 is exact, and exp(r) is the polynomial of
+    // Cephes' expf (about 1 ulp). exp(x) = 2^n * exp(r).
+    constexpr float EXP_MIN = -87.33654f; // 2^-126, the smallest normal
+    constexpr float EXP_MAX = 88.0f;
+    constexpr float LOG2E = 1.44269504088896341f;
+    constexpr float LN2_HI = 0.693359375f, LN2_LO = -2.12194440e-4f;
+    constexpr float EXP_P[6] = {1.9875691500e-4f, 1.3981999507e-3f, \
+            8.3334519073e-3f, 4.1665795894e-2f, 1.6666665459e-1f, \
+                                                        5.0000001201e-1f};
+
+#ifdef NN_X86
+    __attribute__((target("avx")))
+    inline float hsum256(__m256 acc){
+        __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(acc), \
+                                        _mm256_extractf128_ps(acc, 1));
+        sum4 = _mm_add_ps(sum4, _mm_movehl_ps(sum4, sum4));
+        sum4 = _mm_add_ss(sum4, _mm_movehdup_ps(sum4));
+        return _mm_cvtss_f32(sum4);
+    }
+
+    __attribute__((target("avx2,fma")))
+    float avx2_dot(const float* a, const float* b, size_t n){
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16){
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), \
+                                        _mm256_loadu_ps(b + i), acc0);
+            acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), \
+                                        _mm256_loadu_ps(b + i + 8), acc1);
+        }
+        for (; i + 8 <= n; i += 8){
+            acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), \
+                                        _mm256_loadu_ps(b + i), acc0);
+        }
+        float sum = hsum256(_mm256_add_ps(acc0, acc1));
+        for (; i < n; i++){
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+    __attribute__((target("avx2,fma")))
+    void avx2_axpy(size_t n, float alpha, const float* x, float* y){
+        __m256 a = _mm256_set1_ps(alpha);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8){
+            _mm256_storeu_ps(y + i, _mm256_fmadd_ps(a, _mm256_loadu_ps(x + i),\
+                                                    _mm256_loadu_ps(y + i)));
+        }
+        for (; i < n; i++){
+            y[i] += alpha * x[i];
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    void avx2_rank1_update(size_t m, size_t n, float alpha, \
+                        const float* x, const float* y, float* A, size_t lda){
+        for (size_t i = 0; i < m; i++){
+            avx2_axpy(n, alpha * x[i], y, A + i*lda);
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    void avx2_sgd_step(size_t n, float alpha, float* grad, float* param){
+        __m256 a = _mm256_set1_ps(alpha);
+        __m256 zero = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8){
+            __m256 g = _mm256_loadu_ps(grad + i);
+            _mm256_storeu_ps(param + i, _mm256_fmadd_ps(a, g, \
+                                                _mm256_loadu_ps(param + i)));
+            _mm256_storeu_ps(grad + i, zero);
+        }
+        for (; i < n; i++){
+            param[i] += alpha * grad[i];
+            grad[i] = 0.0f;
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    void avx2_packed_gemv(size_t kc, size_t nb, const float* a, \
+                                            const float* packed, float* c){
+        // 32 columns of c stay in registers for the whole k loop
+        size_t j = 0;
+        for (; j + 32 <= nb; j += 32){
+            __m256 c0 = _mm256_loadu_ps(c + j);
+            __m256 c1 = _mm256_loadu_ps(c + j + 8);
+            __m256 c2 = _mm256_loadu_ps(c + j + 16);
+            __m256 c3 = _mm256_loadu_ps(c + j + 24);
+            const float* p = packed + j;
+            for (size_t k = 0; k < kc; k++, p += nb){
+                __m256 ak = _mm256_set1_ps(a[k]);
+                c0 = _mm256_fmadd_ps(ak, _mm256_loadu_ps(p), c0);
+                c1 = _mm256_fmadd_ps(ak, _mm256_loadu_ps(p + 8), c1);
+                c2 = _mm256_fmadd_ps(ak, _mm256_loadu_ps(p + 16), c2);
+                c3 = _mm256_fmadd_ps(ak, _mm256_loadu_ps(p + 24), c3);
+            }
+            _mm256_storeu_ps(c + j, c0);
+            _mm256_storeu_ps(c + j + 8, c1);
+            _mm256_storeu_ps(c + j + 16, c2);
+            _mm256_storeu_ps(c + j + 24, c3);
+        }
+        for (; j + 8 <= nb; j += 8){
+            __m256 c0 = _mm256_loadu_ps(c + j);
+            const float* p = packed + j;
+            for (size_t k = 0; k < kc; k++, p += nb){
+                c0 = _mm256_fmadd_ps(_mm256_set1_ps(a[k]), \
+                                                _mm256_loadu_ps(p), c0);
+            }
+            _mm256_storeu_ps(c + j, c0);
+        }
+        for (; j < nb; j++){
+            float sum = c[j];
+            for (size_t k = 0; k < kc; k++){
+                sum += a[k] * packed[k*nb + j];
+            }
+            c[j] = sum;
+        }
+    }
+
+    __attribute__((target("avx2")))
+    int32_t avx2_dot_u8s8(const uint8_t* a, const int8_t* b, size_t n){
+        // widened to 16 bits and multiplied with pmaddwd, which cannot
+        // overflow (pmaddubsw would saturate at 255 * 127 * 2)
+        __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32){
+            __m256i a0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(\
+                                        (const __m128i*)(a + i)));
+            __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128(\
+                                        (const __m128i*)(b + i)));
+            __m256i a1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(\
+                                        (const __m128i*)(a + i + 16)));
+            __m256i b1 = _mm256_cvtepi8_epi16(_mm_loadu_si128(\
+                                        (const __m128i*)(b + i + 16)));
+            acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(a0, b0));
+            acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(a1, b1));
+        }
+        __m256i acc = _mm256_add_epi32(acc0, acc1);
+        __m128i sum4 = _mm_add_epi32(_mm256_castsi256_si128(acc), \
+                                        _mm256_extracti128_si256(acc, 1));
+        sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, 0x4E));
+        sum4 = _mm_add_epi32(sum4, _mm_shuffle_epi32(sum4, 0xB1));
+        int32_t sum = _mm_cvtsi128_si32(sum4);
+        return sum + scalar_dot_u8s8(a + i, b + i, n - i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void avx2_momentum_step(size_t n, float lr, float mu, float scale, \
+                                float* grad, float* velocity, float* param){
+        __m256 l = _mm256_set1_ps(-lr), m = _mm256_set1_ps(mu);
+        __m256 sc = _mm256_set1_ps(scale), zero = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8){
+            __m256 vel = _mm256_fmadd_ps(m, _mm256_loadu_ps(velocity + i), \
+                                _mm256_mul_ps(sc, _mm256_loadu_ps(grad + i)));
+            _mm256_storeu_ps(velocity + i, vel);
+            _mm256_storeu_ps(param + i, _mm256_fmadd_ps(l, vel, \
+                                                _mm256_loadu_ps(param + i)));
+            _mm256_storeu_ps(grad + i, zero);
+        }
+        scalar_momentum_step(n - i, lr, mu, scale, grad + i, velocity + i, \
+                                                                param + i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void avx2_adam_step(size_t n, const Kernels::AdamStep& s, \
+                                float* grad, float* m, float* v, float* param){
+        __m256 sc = _mm256_set1_ps(s.grad_scale);
+        __m256 b1 = _mm256_set1_ps(s.beta1), c1 = _mm256_set1_ps(1 - s.beta1);
+        __m256 b2 = _mm256_set1_ps(s.beta2), c2 = _mm256_set1_ps(1 - s.beta2);
+        __m256 eps = _mm256_set1_ps(s.epsilon);
+        __m256 step = _mm256_set1_ps(s.step_size);
+        __m256 vc = _mm256_set1_ps(s.v_correction);
+        __m256 decay = _mm256_set1_ps(s.decay), zero = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8){
+            __m256 g = _mm256_mul_ps(sc, _mm256_loadu_ps(grad + i));
+            __m256 mi = _mm256_fmadd_ps(b1, _mm256_loadu_ps(m + i), \
+                                                    _mm256_mul_ps(c1, g));
+            __m256 vi = _mm256_fmadd_ps(b2, _mm256_loadu_ps(v + i), \
+                                    _mm256_mul_ps(c2, _mm256_mul_ps(g, g)));
+            __m256 denom = _mm256_add_ps(_mm256_sqrt_ps( \
+                                            _mm256_mul_ps(vi, vc)), eps);
+            __m256 p = _mm256_mul_ps(_mm256_loadu_ps(param + i), decay);
+            p = _mm256_fnmadd_ps(step, _mm256_div_ps(mi, denom), p);
+            _mm256_storeu_ps(m + i, mi);
+            _mm256_storeu_ps(v + i, vi);
+            _mm256_storeu_ps(param + i, p);
+            _mm256_storeu_ps(grad + i, zero);
+        }
+        scalar_adam_step(n - i, s, grad + i, m + i, v + i, param + i);
+    }
+
+    // Without native bf16 support the conversions are integer shifts: a
+    // bf16 is widened to a float by a shift of 16, and the pairs of the
+    // packed tiles are split with a shift (low half) and a mask (high half)
+    __attribute__((target("avx2,fma")))
+    void avx2_to_bf16(size_t n, const float* x, Kernels::bf16* y){
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i half = _mm256_set1_epi32(0x7FFF);
+        const __m256i quiet = _mm256_set1_epi32(0x40);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8){
+            __m256 v = _mm256_loadu_ps(x + i);
+            __m256i bits = _mm256_castps_si256(v);
+            __m256i top = _mm256_srli_epi32(bits, 16);
+            __m256i r = _mm256_srli_epi32(_mm256_add_epi32(bits, \
+                    _mm256_add_epi32(half, _mm256_and_si256(top, one))), 16);
+            __m256 nan = _mm256_cmp_ps(v, v, _CMP_UNORD_Q);
+            r = _mm256_blendv_epi8(r, _mm256_or_si256(top, quiet), \
+                                                _mm256_castps_si256(nan));
+            _mm_storeu_si128((__m128i*)(y + i), _mm_packus_epi32( \
+                _mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1)));
+        }
+        scalar_to_bf16(n - i, x + i, y + i);
+    }
+
+    __attribute__((target("avx2")))
+    inline __m256 avx2_load_bf16(const Kernels::bf16* x){
+        return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(\
+                                _mm_loadu_si128((const __m128i*)x)), 16));
+    }
+
+    __attribute__((target("avx2,fma")))
+    float avx2_dot_bf16(const Kernels::bf16* a, const Kernels::bf16* b, \
+                                                                size_t n){
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16){
+            acc0 = _mm256_fmadd_ps(avx2_load_bf16(a + i), \
+                                            avx2_load_bf16(b + i), acc0);
+            acc1 = _mm256_fmadd_ps(avx2_load_bf16(a + i + 8), \
+                                            avx2_load_bf16(b + i + 8), acc1);
+        }
+        for (; i + 8 <= n; i += 8){
+            acc0 = _mm256_fmadd_ps(avx2_load_bf16(a + i), \
+                                            avx2_load_bf16(b + i), acc0);
+        }
+        return hsum256(_mm256_add_ps(acc0, acc1)) + \
+                                    scalar_dot_bf16(a + i, b + i, n - i);
+    }
+
+    __attribute__((target("avx2")))
+    void avx2_to_fp32(size_t n, const Kernels::bf16* x, float* y){
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8){
+            _mm256_storeu_ps(y + i, avx2_load_bf16(x + i));
+        }
+        scalar_to_fp32(n - i, x + i, y + i);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void avx2_packed_gemv_bf16(size_t kc, size_t nb, const Kernels::bf16* a,\
+                                    const Kernels::bf16* packed, float* c){
+        const __m256i high = _mm256_set1_epi32((int)0xFFFF0000);
+        size_t j = 0;
+        for (; j + 16 <= nb; j += 16){
+            __m256 c0 = _mm256_loadu_ps(c + j);
+            __m256 c1 = _mm256_loadu_ps(c + j + 8);
+            const Kernels::bf16* p = packed + 2*j;
+            for (size_t k = 0; k < kc; k += 2, p += 2*nb){
+                __m256 a0 = _mm256_set1_ps(Kernels::from_bf16(a[k]));
+                __m256 a1 = _mm256_set1_ps(k + 1 < kc ? \
+                                        Kernels::from_bf16(a[k + 1]) : 0.0f);
+                __m256i v0 = _mm256_loadu_si256((const __m256i*)p);
+                __m256i v1 = _mm256_loadu_si256((const __m256i*)(p + 16));
+                c0 = _mm256_fmadd_ps(a0, _mm256_castsi256_ps( \
+                                        _mm256_slli_epi32(v0, 16)), c0);
+                c0 = _mm256_fmadd_ps(a1, _mm256_castsi256_ps( \
+                                        _mm256_and_si256(v0, high)), c0);
+                c1 = _mm256_fmadd_ps(a0, _mm256_castsi256_ps( \
+                                        _mm256_slli_epi32(v1, 16)), c1);
+                c1 = _mm256_fmadd_ps(a1, _mm256_castsi256_ps( \
+                                        _mm256_and_si256(v1, high)), c1);
+            }
+            _mm256_storeu_ps(c + j, c0);
+            _mm256_storeu_ps(c + j + 8, c1);
+        }
+        // the last columns, the pairs stay 2*nb apart
+        for (; j < nb; j++){
+            float sum = c[j];
+            for (size_t k = 0; k < kc; k += 2){
+                const Kernels::bf16* p = packed + k*nb + 2*j;
+                sum += Kernels::from_bf16(a[k]) * Kernels::from_bf16(p[0]);
+                if (k + 1 < kc) {
+                    sum += Kernels::from_bf16(a[k + 1]) * \
+                                                Kernels::from_bf16(p[1]);
+                }
+            }
+            c[j] = sum;
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    inline __m256 avx2_exp(__m256 x){
+        x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(EXP_MIN)), \
+                                                _mm256_set1_ps(EXP_MAX));
+        __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(LOG2E)),\
+                            _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_HI), x);
+        r = _mm256_fnmadd_ps(n, _mm256_set1_ps(LN2_LO), r);
+        __m256 p = _mm256_set1_ps(EXP_P[0]);
+        for (size_t k = 1; k < 6; k++){
+            p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(EXP_P[k]));
+        }
+        p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), r);
+        p = _mm256_add_ps(p, _mm256_set1_ps(1.0f));
+        __m256i e = _mm256_slli_epi32(_mm256_add_epi32( \
+                    _mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+        return _mm256_mul_ps(p, _mm256_castsi256_ps(e));
+    }
+
+    __attribute__((target("avx2,fma")))
+    float avx2_softmax_cross_entropy(size_t n, const float* z, \
+                                size_t target, float* y, float* delta){
+        __m256 vmax = _mm256_set1_ps(z[0]);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8){
+            vmax = _mm256_max_ps(vmax, _mm256_loadu_ps(z + i));
+        }
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, vmax);
+        float max = lanes[0];
+        for (size_t l = 1; l < 8; l++) max = std::max(max, lanes[l]);
+        for (; i < n; i++) max = std::max(max, z[i]);
+        float zt = target < n ? z[target] : 0.0f;
+
+        __m256 shift = _mm256_set1_ps(max), acc = _mm256_setzero_ps();
+        for (i = 0; i + 8 <= n; i += 8){
+            __m256 e = avx2_exp(_mm256_sub_ps(_mm256_loadu_ps(z + i), shift));
+            _mm256_storeu_ps(y + i, e);
+            acc = _mm256_add_ps(acc, e);
+        }
+        float sum = hsum256(acc);
+        for (; i < n; i++){
+            y[i] = std::exp(z[i] - max);
+            sum += y[i];
+        }
+
+        __m256 inv = _mm256_set1_ps(1.0f / sum);
+        for (i = 0; i + 8 <= n; i += 8){
+            __m256 p = _mm256_mul_ps(_mm256_loadu_ps(y + i), inv);
+            _mm256_storeu_ps(y + i, p);
+            if (delta != nullptr) _mm256_storeu_ps(delta + i, p);
+        }
+        for (; i < n; i++){
+            y[i] *= 1.0f / sum;
+            if (delta != nullptr) delta[i] = y[i];
+        }
+        if (delta != nullptr && target < n) delta[target] -= 1.0f;
+        return target < n ? std::log(sum) - (zt - max) : 0.0f;
+    }
+
+    __attribute__((target("avx512f")))
+    float avx512_dot(const float* a, const float* b, size_t n){
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32){
+            acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), \
+                                        _mm512_loadu_ps(b + i), acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(a + i + 16), \
+                                        _mm512_loadu_ps(b + i + 16), acc1);
+        }
+        acc0 = _mm512_add_ps(acc0, acc1);
+        // the tail is done with a masked load instead of a scalar loop
+        for (; i < n; i += 16){
+            __mmask16 mask = (n - i >= 16) ? 0xFFFF : \
+                                    (__mmask16)((1u << (n - i)) - 1);
+            acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i), \
+                                _mm512_maskz_loadu_ps(mask, b + i), acc0);
+        }
+        // spilled rather than _mm512_reduce_add_ps, which trips a
+        // -Wuninitialized false positive in the gcc 12 headers
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, acc0);
+        float sum = 0.0f;
+        for (size_t l = 0; l < 16; l++){
+            sum += lanes[l];
+        }
+        return sum;
+    }
+
+    __attribute__((target("avx512f")))
+    void avx512_axpy(size_t n, float alpha, const float* x, float* y){
+        __m512 a = _mm512_set1_ps(alpha);
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16){
+            _mm512_storeu_ps(y + i, _mm512_fmadd_ps(a, _mm512_loadu_ps(x + i),\
+                                                    _mm512_loadu_ps(y + i)));
+        }
+        if (i < n){
+            __mmask16 mask = (__mmask16)((1u << (n - i)) - 1);
+            __m512 r = _mm512_fmadd_ps(a, _mm512_maskz_loadu_ps(mask, x + i), \
+                                        _mm512_maskz_loadu_ps(mask, y + i));
+            _mm512_mask_storeu_ps(y + i, mask, r);
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    void avx512_rank1_update(size_t m, size_t n, float alpha, \
+                        const float* x, const float* y, float* A, size_t lda){
+        for (size_t i = 0; i < m; i++){
+            avx512_axpy(n, alpha * x[i], y, A + i*lda);
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    void avx512_sgd_step(size_t n, float alpha, float* grad, float* param){
+        __m512 a = _mm512_set1_ps(alpha);
+        __m512 zero = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16){
+            __m512 g = _mm512_loadu_ps(grad + i);
+            _mm512_storeu_ps(param + i, _mm512_fmadd_ps(a, g, \
+                                                _mm512_loadu_ps(param + i)));
+            _mm512_storeu_ps(grad + i, zero);
+        }
+        if (i < n){
+            __mmask16 mask = (__mmask16)((1u << (n - i)) - 1);
+            __m512 g = _mm512_maskz_loadu_ps(mask, grad + i);
+            __m512 p = _mm512_maskz_loadu_ps(mask, param + i);
+            _mm512_mask_storeu_ps(param + i, mask, _mm512_fmadd_ps(a, g, p));
+            _mm512_mask_storeu_ps(grad + i, mask, zero);
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    void avx512_packed_gemv(size_t kc, size_t nb, const float* a, \
+                                            const float* packed, float* c){
+        // 64 columns of c (a full NC tile) stay in registers for the whole
+        // k loop
+        size_t j = 0;
+        for (; j + 64 <= nb; j += 64){
+            __m512 c0 = _mm512_loadu_ps(c + j);
+            __m512 c1 = _mm512_loadu_ps(c + j + 16);
+            __m512 c2 = _mm512_loadu_ps(c + j + 32);
+            __m512 c3 = _mm512_loadu_ps(c + j + 48);
+            const float* p = packed + j;
+            for (size_t k = 0; k < kc; k++, p += nb){
+                __m512 ak = _mm512_set1_ps(a[k]);
+                c0 = _mm512_fmadd_ps(ak, _mm512_loadu_ps(p), c0);
+                c1 = _mm512_fmadd_ps(ak, _mm512_loadu_ps(p + 16), c1);
+                c2 = _mm512_fmadd_ps(ak, _mm512_loadu_ps(p + 32), c2);
+                c3 = _mm512_fmadd_ps(ak, _mm512_loadu_ps(p + 48), c3);
+            }
+            _mm512_storeu_ps(c + j, c0);
+            _mm512_storeu_ps(c + j + 16, c1);
+            _mm512_storeu_ps(c + j + 32, c2);
+            _mm512_storeu_ps(c + j + 48, c3);
+        }
+        for (; j < nb; j += 16){
+            __mmask16 mask = nb - j >= 16 ? (__mmask16)0xFFFF : \
+                                    (__mmask16)((1u << (nb - j)) - 1);
+            __m512 c0 = _mm512_maskz_loadu_ps(mask, c + j);
+            const float* p = packed + j;
+            for (size_t k = 0; k < kc; k++, p += nb){
+                c0 = _mm512_fmadd_ps(_mm512_set1_ps(a[k]), \
+                                    _mm512_maskz_loadu_ps(mask, p), c0);
+            }
+            _mm512_mask_storeu_ps(c + j, mask, c0);
+        }
+    }
+
+    __attribute__((target("avx512f,avx512vnni")))
+    int32_t avx512vnni_dot_u8s8(const uint8_t* a, const int8_t* b, size_t n){
+        // vpdpbusd: 4 u8*s8 products summed into each 32 bit lane, exact
+        __m512i acc0 = _mm512_setzero_si512(), acc1 = _mm512_setzero_si512();
+        size_t i = 0;
+        for (; i + 128 <= n; i += 128){
+            acc0 = _mm512_dpbusd_epi32(acc0, _mm512_loadu_si512(a + i), \
+                                            _mm512_loadu_si512(b + i));
+            acc1 = _mm512_dpbusd_epi32(acc1, _mm512_loadu_si512(a + i + 64), \
+                                            _mm512_loadu_si512(b + i + 64));
+        }
+        for (; i + 64 <= n; i += 64){
+            acc0 = _mm512_dpbusd_epi32(acc0, _mm512_loadu_si512(a + i), \
+                                            _mm512_loadu_si512(b + i));
+        }
+        // same spill as avx512_dot to keep GCC 12 quiet
+        alignas(64) int32_t lanes[16];
+        _mm512_store_si512(lanes, _mm512_add_epi32(acc0, acc1));
+        int32_t sum = 0;
+        for (size_t l = 0; l < 16; l++){
+            sum += lanes[l];
+        }
+        return sum + scalar_dot_u8s8(a + i, b + i, n - i);
+    }
+
+    __attribute__((target("avx512f")))
+    void avx512_momentum_step(size_t n, float lr, float mu, float scale, \
+                                float* grad, float* velocity, float* param){
+        __m512 l = _mm512_set1_ps(-lr), m = _mm512_set1_ps(mu);
+        __m512 sc = _mm512_set1_ps(scale), zero = _mm512_setzero_ps();
+        for (size_t i = 0; i < n; i += 16){
+            __mmask16 mask = n - i >= 16 ? (__mmask16)0xFFFF : \
+                                    (__mmask16)((1u << (n - i)) - 1);
+            __m512 g = _mm512_mul_ps(sc, _mm512_maskz_loadu_ps(mask, grad + i));
+            __m512 vel = _mm512_fmadd_ps(m, \
+                                _mm512_maskz_loadu_ps(mask, velocity + i), g);
+            __m512 p = _mm512_fmadd_ps(l, vel, \
+                                    _mm512_maskz_loadu_ps(mask, param + i));
+            _mm512_mask_storeu_ps(velocity + i, mask, vel);
+            _mm512_mask_storeu_ps(param + i, mask, p);
+            _mm512_mask_storeu_ps(grad + i, mask, zero);
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    void avx512_adam_step(size_t n, const Kernels::AdamStep& s, \
+                                float* grad, float* m, float* v, float* param){
+        __m512 sc = _mm512_set1_ps(s.grad_scale);
+        __m512 b1 = _mm512_set1_ps(s.beta1), c1 = _mm512_set1_ps(1 - s.beta1);
+        __m512 b2 = _mm512_set1_ps(s.beta2), c2 = _mm512_set1_ps(1 - s.beta2);
+        __m512 eps = _mm512_set1_ps(s.epsilon);
+        __m512 step = _mm512_set1_ps(s.step_size);
+        __m512 vc = _mm512_set1_ps(s.v_correction);
+        __m512 decay = _mm512_set1_ps(s.decay), zero = _mm512_setzero_ps();
+        for (size_t i = 0; i < n; i += 16){
+            __mmask16 mask = n - i >= 16 ? (__mmask16)0xFFFF : \
+                                    (__mmask16)((1u << (n - i)) - 1);
+            __m512 g = _mm512_mul_ps(sc, _mm512_maskz_loadu_ps(mask, grad + i));
+            __m512 mi = _mm512_fmadd_ps(b1, _mm512_maskz_loadu_ps(mask, m + i),\
+                                                    _mm512_mul_ps(c1, g));
+            __m512 vi = _mm512_fmadd_ps(b2, _mm512_maskz_loadu_ps(mask, v + i),\
+                                    _mm512_mul_ps(c2, _mm512_mul_ps(g, g)));
+            // masked sqrt, the plain one trips a GCC 12 false warning
+            __m512 denom = _mm512_add_ps(_mm512_maskz_sqrt_ps(mask, \
+                                            _mm512_mul_ps(vi, vc)), eps);
+            __m512 p = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, param + i), \
+                                                                    decay);
+            p = _mm512_fnmadd_ps(step, _mm512_div_ps(mi, denom), p);
+            _mm512_mask_storeu_ps(m + i, mask, mi);
+            _mm512_mask_storeu_ps(v + i, mask, vi);
+            _mm512_mask_storeu_ps(param + i, mask, p);
+            _mm512_mask_storeu_ps(grad + i, mask, zero);
+        }
+    }
+
+    // full mask maskz forms of the shifts, the plain ones (and the plain
+    // widening) trip the GCC 12 false warning seen in avx512_adam_step
+    __attribute__((target("avx512f")))
+    inline __m512i avx512_slli16(__m512i v){
+        return _mm512_maskz_slli_epi32((__mmask16)0xFFFF, v, 16);
+    }
+
+    __attribute__((target("avx512f")))
+    inline __m512i avx512_srli16(__m512i v){
+        return _mm512_maskz_srli_epi32((__mmask16)0xFFFF, v, 16);
+    }
+
+    __attribute__((target("avx512f")))
+    void avx512_to_bf16(size_t n, const float* x, Kernels::bf16* y){
+        const __m512i one = _mm512_set1_epi32(1);
+        const __m512i half = _mm512_set1_epi32(0x7FFF);
+        const __m512i quiet = _mm512_set1_epi32(0x40);
+        for (size_t i = 0; i < n; i += 16){
+            __mmask16 mask = n - i >= 16 ? (__mmask16)0xFFFF : \
+                                    (__mmask16)((1u << (n - i)) - 1);
+            __m512 v = _mm512_maskz_loadu_ps(mask, x + i);
+            __m512i bits = _mm512_castps_si512(v);
+            __m512i top = avx512_srli16(bits);
+            __m512i r = avx512_srli16(_mm512_add_epi32(bits, \
+                    _mm512_add_epi32(half, _mm512_and_si512(top, one))));
+            __mmask16 nan = _mm512_cmp_ps_mask(v, v, _CMP_UNORD_Q);
+            r = _mm512_mask_mov_epi32(r, nan, _mm512_or_si512(top, quiet));
+            _mm512_mask_cvtepi32_storeu_epi16(y + i, mask, r);
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    inline __m512 avx512_load_bf16(const Kernels::bf16* x){
+        return _mm512_castsi512_ps(avx512_slli16(_mm512_maskz_cvtepu16_epi32(\
+                    (__mmask16)0xFFFF, _mm256_loadu_si256((const __m256i*)x))));
+    }
+
+    __attribute__((target("avx512f")))
+    float avx512_dot_bf16(const Kernels::bf16* a, const Kernels::bf16* b, \
+                                                                size_t n){
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32){
+            acc0 = _mm512_fmadd_ps(avx512_load_bf16(a + i), \
+                                            avx512_load_bf16(b + i), acc0);
+            acc1 = _mm512_fmadd_ps(avx512_load_bf16(a + i + 16), \
+                                        avx512_load_bf16(b + i + 16), acc1);
+        }
+        for (; i + 16 <= n; i += 16){
+            acc0 = _mm512_fmadd_ps(avx512_load_bf16(a + i), \
+                                            avx512_load_bf16(b + i), acc0);
+        }
+        // same spill as avx512_dot to keep GCC 12 quiet
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, _mm512_add_ps(acc0, acc1));
+        float sum = 0.0f;
+        for (size_t l = 0; l < 16; l++){
+            sum += lanes[l];
+        }
+        return sum + scalar_dot_bf16(a + i, b + i, n - i);
+    }
+
+    __attribute__((target("avx512f")))
+    void avx512_to_fp32(size_t n, const Kernels::bf16* x, float* y){
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16){
+            _mm512_storeu_ps(y + i, avx512_load_bf16(x + i));
+        }
+        scalar_to_fp32(n - i, x + i, y + i);
+    }
+
+    __attribute__((target("avx512f")))
+    void avx512_packed_gemv_bf16(size_t kc, size_t nb, \
+            const Kernels::bf16* a, const Kernels::bf16* packed, float* c){
+        // 16 columns per register, as pairs: 32 bf16 per load
+        const __m512i high = _mm512_set1_epi32((int)0xFFFF0000);
+        size_t j = 0;
+        for (; j + 32 <= nb; j += 32){
+            __m512 c0 = _mm512_loadu_ps(c + j);
+            __m512 c1 = _mm512_loadu_ps(c + j + 16);
+            const Kernels::bf16* p = packed + 2*j;
+            for (size_t k = 0; k < kc; k += 2, p += 2*nb){
+                __m512 a0 = _mm512_set1_ps(Kernels::from_bf16(a[k]));
+                __m512 a1 = _mm512_set1_ps(k + 1 < kc ? \
+                                        Kernels::from_bf16(a[k + 1]) : 0.0f);
+                __m512i v0 = _mm512_loadu_si512(p);
+                __m512i v1 = _mm512_loadu_si512(p + 32);
+                c0 = _mm512_fmadd_ps(a0, _mm512_castsi512_ps( \
+                                        avx512_slli16(v0)), c0);
+                c0 = _mm512_fmadd_ps(a1, _mm512_castsi512_ps( \
+                                        _mm512_and_si512(v0, high)), c0);
+                c1 = _mm512_fmadd_ps(a0, _mm512_castsi512_ps( \
+                                        avx512_slli16(v1)), c1);
+                c1 = _mm512_fmadd_ps(a1, _mm512_castsi512_ps( \
+                                        _mm512_and_si512(v1, high)), c1);
+            }
+            _mm512_storeu_ps(c + j, c0);
+            _mm512_storeu_ps(c + j + 16, c1);
+        }
+        for (; j < nb; j += 16){
+            __mmask16 mask = nb - j >= 16 ? (__mmask16)0xFFFF : \
+                                    (__mmask16)((1u << (nb - j)) - 1);
+            __m512 c0 = _mm512_maskz_loadu_ps(mask, c + j);
+            const Kernels::bf16* p = packed + 2*j;
+            for (size_t k = 0; k < kc; k += 2, p += 2*nb){
+                __m512 a0 = _mm512_set1_ps(Kernels::from_bf16(a[k]));
+                __m512 a1 = _mm512_set1_ps(k + 1 < kc ? \
+                                        Kernels::from_bf16(a[k + 1]) : 0.0f);
+                __m512i v = _mm512_maskz_loadu_epi32(mask, p);
+                c0 = _mm512_fmadd_ps(a0, _mm512_castsi512_ps( \
+                                        avx512_slli16(v)), c0);
+                c0 = _mm512_fmadd_ps(a1, _mm512_castsi512_ps( \
+                                        _mm512_and_si512(v, high)), c0);
+            }
+            _mm512_mask_storeu_ps(c + j, mask, c0);
+        }
+    }
+
+    // Native bf16: vcvtneps2bf16 rounds like scalar_to_bf16 (but flushes
+    // denormals to 0) and vdpbf16ps multiplies a pair of bf16 and adds both
+    // products to a fp32 lane, the layout of the packed tiles
+    __attribute__((target("avx512f,avx512bf16")))
+    void avx512bf16_to_bf16(size_t n, const float* x, Kernels::bf16* y){
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16){
+            __m256bh r = _mm512_cvtneps_pbh(_mm512_loadu_ps(x + i));
+            _mm256_storeu_si256((__m256i*)(y + i), (__m256i)r);
+        }
+        scalar_to_bf16(n - i, x + i, y + i);
+    }
+
+    __attribute__((target("avx512f,avx512bf16")))
+    float avx512bf16_dot_bf16(const Kernels::bf16* a, \
+                                    const Kernels::bf16* b, size_t n){
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64){
+            acc0 = _mm512_dpbf16_ps(acc0, (__m512bh)_mm512_loadu_si512(a + i),\
+                                    (__m512bh)_mm512_loadu_si512(b + i));
+            acc1 = _mm512_dpbf16_ps(acc1, \
+                                (__m512bh)_mm512_loadu_si512(a + i + 32), \
+                                (__m512bh)_mm512_loadu_si512(b + i + 32));
+        }
+        for (; i + 32 <= n; i += 32){
+            acc0 = _mm512_dpbf16_ps(acc0, (__m512bh)_mm512_loadu_si512(a + i),\
+                                    (__m512bh)_mm512_loadu_si512(b + i));
+        }
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, _mm512_add_ps(acc0, acc1));
+        float sum = 0.0f;
+        for (size_t l = 0; l < 16; l++){
+            sum += lanes[l];
+        }
+        return sum + scalar_dot_bf16(a + i, b + i, n - i);
+    }
+
+    __attribute__((target("avx512f,avx512bf16")))
+    void avx512bf16_packed_gemv_bf16(size_t kc, size_t nb, \
+            const Kernels::bf16* a, const Kernels::bf16* packed, float* c){
+        // 64 columns of c in registers, one vdpbf16ps per 16 of them and
+        // pair of k. Two pairs per step into separate sums, vdpbf16ps has
+        // a longer latency than an fma
+        size_t j = 0;
+        for (; j + 64 <= nb; j += 64){
+            __m512 c0 = _mm512_loadu_ps(c + j);
+            __m512 c1 = _mm512_loadu_ps(c + j + 16);
+            __m512 c2 = _mm512_loadu_ps(c + j + 32);
+            __m512 c3 = _mm512_loadu_ps(c + j + 48);
+            __m512 d0 = _mm512_setzero_ps(), d1 = _mm512_setzero_ps();
+            __m512 d2 = _mm512_setzero_ps(), d3 = _mm512_setzero_ps();
+            const Kernels::bf16* p = packed + 2*j;
+            size_t k = 0;
+            for (; k + 4 <= kc; k += 4, p += 4*nb){
+                __m512bh ak = (__m512bh)_mm512_set1_epi32( \
+                                                (int)bf16_pair(a, k, kc));
+                __m512bh bk = (__m512bh)_mm512_set1_epi32( \
+                                            (int)bf16_pair(a, k + 2, kc));
+                const Kernels::bf16* q = p + 2*nb;
+                c0 = _mm512_dpbf16_ps(c0, ak, \
+                                    (__m512bh)_mm512_loadu_si512(p));
+                c1 = _mm512_dpbf16_ps(c1, ak, \
+                                    (__m512bh)_mm512_loadu_si512(p + 32));
+                c2 = _mm512_dpbf16_ps(c2, ak, \
+                                    (__m512bh)_mm512_loadu_si512(p + 64));
+                c3 = _mm512_dpbf16_ps(c3, ak, \
+                                    (__m512bh)_mm512_loadu_si512(p + 96));
+                d0 = _mm512_dpbf16_ps(d0, bk, \
+                                    (__m512bh)_mm512_loadu_si512(q));
+                d1 = _mm512_dpbf16_ps(d1, bk, \
+                                    (__m512bh)_mm512_loadu_si512(q + 32));
+                d2 = _mm512_dpbf16_ps(d2, bk, \
+                                    (__m512bh)_mm512_loadu_si512(q + 64));
+                d3 = _mm512_dpbf16_ps(d3, bk, \
+                                    (__m512bh)_mm512_loadu_si512(q + 96));
+            }
+            for (; k < kc; k += 2, p += 2*nb){
+                __m512bh ak = (__m512bh)_mm512_set1_epi32( \
+                                                (int)bf16_pair(a, k, kc));
+                c0 = _mm512_dpbf16_ps(c0, ak, \
+                                    (__m512bh)_mm512_loadu_si512(p));
+                c1 = _mm512_dpbf16_ps(c1, ak, \
+                                    (__m512bh)_mm512_loadu_si512(p + 32));
+                c2 = _mm512_dpbf16_ps(c2, ak, \
+                                    (__m512bh)_mm512_loadu_si512(p + 64));
+                c3 = _mm512_dpbf16_ps(c3, ak, \
+                                    (__m512bh)_mm512_loadu_si512(p + 96));
+            }
+            _mm512_storeu_ps(c + j, _mm512_add_ps(c0, d0));
+            _mm512_storeu_ps(c + j + 16, _mm512_add_ps(c1, d1));
+            _mm512_storeu_ps(c + j + 32, _mm512_add_ps(c2, d2));
+            _mm512_storeu_ps(c + j + 48, _mm512_add_ps(c3, d3));
+        }
+        for (; j < nb; j += 16){
+            __mmask16 mask = nb - j >= 16 ? (__mmask16)0xFFFF : \
+                                    (__mmask16)((1u << (nb - j)) - 1);
+            __m512 c0 = _mm512_maskz_loadu_ps(mask, c + j);
+            const Kernels::bf16* p = packed + 2*j;
+            for (size_t k = 0; k < kc; k += 2, p += 2*nb){
+                __m512bh ak = (__m512bh)_mm512_set1_epi32( \
+                                                (int)bf16_pair(a, k, kc));
+                c0 = _mm512_dpbf16_ps(c0, ak, \
+                            (__m512bh)_mm512_maskz_loadu_epi32(mask, p));
+            }
+            _mm512_mask_storeu_ps(c + j, mask, c0);
+        }
+    }
+
+    // the maskz forms with a full mask again, for the same GCC 12 warning
+    __attribute__((target("avx512f")))
+    inline __m512 avx512_exp(__m512 x){
+        const __mmask16 all = (__mmask16)0xFFFF;
+        x = _mm512_maskz_min_ps(all, _mm512_maskz_max_ps(all, x, \
+                    _mm512_set1_ps(EXP_MIN)), _mm512_set1_ps(EXP_MAX));
+        __m512 n = _mm512_maskz_roundscale_ps(all, _mm512_mul_ps(x, \
+                _mm512_set1_ps(LOG2E)), \
+                            _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(LN2_HI), x);
+        r = _mm512_fnmadd_ps(n, _mm512_set1_ps(LN2_LO), r);
+        __m512 p = _mm512_set1_ps(EXP_P[0]);
+        for (size_t k = 1; k < 6; k++){
+            p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(EXP_P[k]));
+        }
+        p = _mm512_fmadd_ps(p, _mm512_mul_ps(r, r), r);
+        p = _mm512_add_ps(p, _mm512_set1_ps(1.0f));
+        __m512i e = _mm512_maskz_slli_epi32(all, _mm512_add_epi32( \
+            _mm512_maskz_cvtps_epi32(all, n), _mm512_set1_epi32(127)), 23);
+        return _mm512_mul_ps(p, _mm512_castsi512_ps(e));
+    }
+
+    __attribute__((target("avx512f")))
+    float avx512_softmax_cross_entropy(size_t n, const float* z, \
+                                size_t target, float* y, float* delta){
+        // masked tails everywhere, the lanes past n read as -inf for the
+        // max and are left out of the sum
+        __m512 vmax = _mm512_set1_ps(-INFINITY);
+        for (size_t i = 0; i < n; i += 16){
+            __mmask16 mask = n - i >= 16 ? (__mmask16)0xFFFF : \
+                                    (__mmask16)((1u << (n - i)) - 1);
+            vmax = _mm512_maskz_max_ps((__mmask16)0xFFFF, vmax, \
+                                    _mm512_mask_loadu_ps(vmax, mask, z + i));
+        }
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, vmax);
+        float max = lanes[0];
+        for (size_t l = 1; l < 16; l++) max = std::max(max, lanes[l]);
+        float zt = target < n ? z[target] : 0.0f;
+
+        __m512 shift = _mm512_set1_ps(max), acc = _mm512_setzero_ps();
+        for (size_t i = 0; i < n; i += 16){
+            __mmask16 mask = n - i >= 16 ? (__mmask16)0xFFFF : \
+                                    (__mmask16)((1u << (n - i)) - 1);
+            __m512 e = avx512_exp(_mm512_sub_ps(_mm512_maskz_loadu_ps(mask,\
+                                                        z + i), shift));
+            _mm512_mask_storeu_ps(y + i, mask, e);
+            acc = _mm512_mask_add_ps(acc, mask, acc, e);
+        }
+        _mm512_store_ps(lanes, acc);
+        float sum = 0.0f;
+        for (size_t l = 0; l < 16; l++) sum += lanes[l];
+
+        __m512 inv = _mm512_set1_ps(1.0f / sum);
+        for (size_t i = 0; i < n; i += 16){
+            __mmask16 mask = n - i >= 16 ? (__mmask16)0xFFFF : \
+                                    (__mmask16)((1u << (n - i)) - 1);
+            __m512 p = _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, y + i), inv);
+            _mm512_mask_storeu_ps(y + i, mask, p);
+            if (delta != nullptr) _mm512_mask_storeu_ps(delta + i, mask, p);
+        }
+        if (delta != nullptr && target < n) delta[target] -= 1.0f;
+        return target < n ? std::log(sum) - (zt - max) : 0.0f;
+    }
+#endif
+
+#ifdef NN_NEON
+    float neon_dot(const float* a, const float* b, size_t n){
+        float32x4_t acc0 = vdupq_n_f32(0.0f);
+        float32x4_t acc1 = vdupq_n_f32(0.0f);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8){
+            acc0 = vfmaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+            acc1 = vfmaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+        }
+        float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+        for (; i < n; i++){
+            sum += a[i] * b[i];
+        }
+        return sum;
+    }
+
+    void neon_axpy(size_t n, float alpha, const float* x, float* y){
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4){
+            vst1q_f32(y + i, vfmaq_n_f32(vld1q_f32(y + i), vld1q_f32(x + i), \
+                                                                    alpha));
+        }
+        for (; i < n; i++){
+            y[i] += alpha * x[i];
+        }
+    }
+
+    void neon_rank1_update(size_t m, size_t n, float alpha, \
+                        const float* x, const float* y, float* A, size_t lda){
+        for (size_t i = 0; i < m; i++){
+            neon_axpy(n, alpha * x[i], y, A + i*lda);
+        }
+    }
+
+    void neon_sgd_step(size_t n, float alpha, float* grad, float* param){
+        float32x4_t zero = vdupq_n_f32(0.0f);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4){
+            vst1q_f32(param + i, vfmaq_n_f32(vld1q_f32(param + i), \
+                                                vld1q_f32(grad + i), alpha));
+            vst1q_f32(grad + i, zero);
+        }
+        for (; i < n; i++){
+            param[i] += alpha * grad[i];
+            grad[i] = 0.0f;
+        }
+    }
+
+    void neon_packed_gemv(size_t kc, size_t nb, const float* a, \
+                                            const float* packed, float* c){
+        // 16 columns of c stay in registers for the whole k loop
+        size_t j = 0;
+        for (; j + 16 <= nb; j += 16){
+            float32x4_t c0 = vld1q_f32(c + j), c1 = vld1q_f32(c + j + 4);
+            float32x4_t c2 = vld1q_f32(c + j + 8), c3 = vld1q_f32(c + j + 12);
+            const float* p = packed + j;
+            for (size_t k = 0; k < kc; k++, p += nb){
+                c0 = vfmaq_n_f32(c0, vld1q_f32(p), a[k]);
+                c1 = vfmaq_n_f32(c1, vld1q_f32(p + 4), a[k]);
+                c2 = vfmaq_n_f32(c2, vld1q_f32(p + 8), a[k]);
+                c3 = vfmaq_n_f32(c3, vld1q_f32(p + 12), a[k]);
+            }
+            vst1q_f32(c + j, c0);
+            vst1q_f32(c + j + 4, c1);
+            vst1q_f32(c + j + 8, c2);
+            vst1q_f32(c + j + 12, c3);
+        }
+        for (; j + 4 <= nb; j += 4){
+            float32x4_t c0 = vld1q_f32(c + j);
+            const float* p = packed + j;
+            for (size_t k = 0; k < kc; k++, p += nb){
+                c0 = vfmaq_n_f32(c0, vld1q_f32(p), a[k]);
+            }
+            vst1q_f32(c + j, c0);
+        }
+        for (; j < nb; j++){
+            float sum = c[j];
+            for (size_t k = 0; k < kc; k++){
+                sum += a[k] * packed[k*nb + j];
+            }
+            c[j] = sum;
+        }
+    }
+
+    int32_t neon_dot_u8s8(const uint8_t* a, const int8_t* b, size_t n){
+        int32x4_t acc = vdupq_n_s32(0);
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8){
+            int16x8_t a16 = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(a + i)));
+            int16x8_t b16 = vmovl_s8(vld1_s8(b + i));
+            acc = vmlal_s16(acc, vget_low_s16(a16), vget_low_s16(b16));
+            acc = vmlal_high_s16(acc, a16, b16);
+        }
+        return vaddvq_s32(acc) + scalar_dot_u8s8(a + i, b + i, n - i);
+    }
+
+    void neon_momentum_step(size_t n, float lr, float mu, float scale, \
+                                float* grad, float* velocity, float* param){
+        float32x4_t zero = vdupq_n_f32(0.0f);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4){
+            float32x4_t vel = vfmaq_n_f32(vmulq_n_f32(vld1q_f32(grad + i), \
+                                    scale), vld1q_f32(velocity + i), mu);
+            vst1q_f32(velocity + i, vel);
+            vst1q_f32(param + i, vfmsq_n_f32(vld1q_f32(param + i), vel, lr));
+            vst1q_f32(grad + i, zero);
+        }
+        scalar_momentum_step(n - i, lr, mu, scale, grad + i, velocity + i, \
+                                                                param + i);
+    }
+
+    void neon_adam_step(size_t n, const Kernels::AdamStep& s, \
+                                float* grad, float* m, float* v, float* param){
+        float32x4_t eps = vdupq_n_f32(s.epsilon), zero = vdupq_n_f32(0.0f);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4){
+            float32x4_t g = vmulq_n_f32(vld1q_f32(grad + i), s.grad_scale);
+            float32x4_t mi = vfmaq_n_f32(vmulq_n_f32(g, 1 - s.beta1), \
+                                                vld1q_f32(m + i), s.beta1);
+            float32x4_t vi = vfmaq_n_f32(vmulq_n_f32(vmulq_f32(g, g), \
+                                1 - s.beta2), vld1q_f32(v + i), s.beta2);
+            float32x4_t denom = vaddq_f32(vsqrtq_f32( \
+                                    vmulq_n_f32(vi, s.v_correction)), eps);
+            float32x4_t p = vmulq_n_f32(vld1q_f32(param + i), s.decay);
+            p = vfmsq_n_f32(p, vdivq_f32(mi, denom), s.step_size);
+            vst1q_f32(m + i, mi);
+            vst1q_f32(v + i, vi);
+            vst1q_f32(param + i, p);
+            vst1q_f32(grad + i, zero);
+        }
+        scalar_adam_step(n - i, s, grad + i, m + i, v + i, param + i);
+    }
+#endif
+
+    const Kernels::KernelTable scalar_table = {Kernels::Isa::SCALAR, \
+                "scalar", scalar_dot, scalar_axpy, scalar_rank1_update, \
+                scalar_packed_gemv, scalar_sgd_step, scalar_momentum_step, \
+                scalar_adam_step, scalar_dot_u8s8, scalar_to_bf16, \
+                scalar_dot_bf16, scalar_to_fp32, scalar_packed_gemv_bf16, \
+                scalar_softmax_cross_entropy};
+#ifdef NN_X86
+    const Kernels::KernelTable avx2_table = {Kernels::Isa::AVX2, \
+                "avx2", avx2_dot, avx2_axpy, avx2_rank1_update, \
+                avx2_packed_gemv, avx2_sgd_step, avx2_momentum_step, \
+                avx2_adam_step, avx2_dot_u8s8, avx2_to_bf16, avx2_dot_bf16, \
+                avx2_to_fp32, avx2_packed_gemv_bf16, \
+                avx2_softmax_cross_entropy};
+    const Kernels::KernelTable avx512_table = {Kernels::Isa::AVX512, \
+                "avx512", avx512_dot, avx512_axpy, avx512_rank1_update, \
+                avx512_packed_gemv, avx512_sgd_step, avx512_momentum_step, \
+                avx512_adam_step, avx2_dot_u8s8, avx512_to_bf16, \
+                avx512_dot_bf16, avx512_to_fp32, avx512_packed_gemv_bf16, \
+                avx512_softmax_cross_entropy};
+    // the float kernels of avx512, with the VNNI integer dot product
+    const Kernels::KernelTable avx512vnni_table = {Kernels::Isa::AVX512_VNNI,\
+                "avx512vnni", avx512_dot, avx512_axpy, avx512_rank1_update, \
+                avx512_packed_gemv, avx512_sgd_step, avx512_momentum_step, \
+                avx512_adam_step, avx512vnni_dot_u8s8, avx512_to_bf16, \
+                avx512_dot_bf16, avx512_to_fp32, avx512_packed_gemv_bf16, \
+                avx512_softmax_cross_entropy};
+    // the avx512vnni kernels, with the native bf16 ones
+    const Kernels::KernelTable avx512bf16_table = {Kernels::Isa::AVX512_BF16,\
+                "avx512bf16", avx512_dot, avx512_axpy, avx512_rank1_update, \
+                avx512_packed_gemv, avx512_sgd_step, avx512_momentum_step, \
+                avx512_adam_step, avx512vnni_dot_u8s8, avx512bf16_to_bf16, \
+                avx512bf16_dot_bf16, avx512_to_fp32, \
+                avx512bf16_packed_gemv_bf16, avx512_softmax_cross_entropy};
+#endif
+#ifdef NN_NEON
+    const Kernels::KernelTable neon_table = {Kernels::Isa::NEON, \
+                "neon", neon_dot, neon_axpy, neon_rank1_update, \
+                neon_packed_gemv, neon_sgd_step, neon_momentum_step, \
+                neon_adam_step, neon_dot_u8s8, scalar_to_bf16, \
+                scalar_dot_bf16, scalar_to_fp32, scalar_packed_gemv_bf16, \
+                scalar_softmax_cross_entropy};
+#endif
+}
+
+const Kernels::KernelTable* Kernels::table(Isa isa){
+    switch (isa){
+        case Isa::SCALAR:
+            return &scalar_table;
+#ifdef NN_X86
+        case Isa::AVX2:
+            if (__builtin_cpu_supports("avx2") && \
+                                    __builtin_cpu_supports("fma")){
+                return &avx2_table;
+            }
+            return nullptr;
+        case Isa::AVX512:
+            if (__builtin_cpu_supports("avx512f")) return &avx512_table;
+            return nullptr;
+        case Isa::AVX512_VNNI:
+            if (__builtin_cpu_supports("avx512f") && \
+                                __builtin_cpu_supports("avx512vnni")){
+                return &avx512vnni_table;
+            }
+            return nullptr;
+        case Isa::AVX512_BF16:
+            if (__builtin_cpu_supports("avx512f") && \
+                                __builtin_cpu_supports("avx512vnni") && \
+                                __builtin_cpu_supports("avx512bf16")){
+                return &avx512bf16_table;
+            }
+            return nullptr;
+#endif
+#ifdef NN_NEON
+        case Isa::NEON:
+            return &neon_table;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+const Kernels::KernelTable& Kernels::active(){
+    // Picked once, the order is from the widest vectors to the narrowest
+    static const KernelTable* best = [](){
+        for (Isa isa : {Isa::AVX512_BF16, Isa::AVX512_VNNI, Isa::AVX512, \
+                                                Isa::AVX2, Isa::NEON}){
+            const KernelTable* t = table(isa);
+            if (t != nullptr) return t;
+        }
+        return &scalar_table;
+    }();
+    return *best;
+}
+
+float Kernels::dot(const float* a, const float* b, size_t n){
+    return active().dot(a, b, n);
+}
+
+void Kernels::axpy(size_t n, float alpha, const float* x, float* y){
+    active().axpy(n, alpha, x, y);
+}
+
+void Kernels::rank1_update(size_t m, size_t n, float alpha, const float* x, \
+                                    const float* y, float* A, size_t lda){
+    active().rank1_update(m, n, alpha, x, y, A, lda);
+}
+
+void Kernels::sgd_step(size_t n, float alpha, float* grad, float* param){
+    active().sgd_step(n, alpha, grad, param);
+}
+
+int32_t Kernels::dot_u8s8(const uint8_t* a, const int8_t* b, size_t n){
+    return active().dot_u8s8(a, b, n);
+}
+
+void Kernels::momentum_step(size_t n, float lr, float mu, float scale, \
+                                float* grad, float* velocity, float* param){
+    active().momentum_step(n, lr, mu, scale, grad, velocity, param);
+}
+
+void Kernels::adam_step(size_t n, const AdamStep& s, float* grad, float* m, \
+                                                    float* v, float* param){
+    active().adam_step(n, s, grad, m, v, param);
+}
+
+void Kernels::to_bf16(size_t n, const float* x, bf16* y){
+    active().to_bf16(n, x, y);
+}
+
+float Kernels::softmax_cross_entropy(size_t n, const float* z, \
+                                size_t target, float* y, float* delta){
+    return active().softmax_cross_entropy(n, z, target, y, delta);
+}
+
+void Kernels::softmax(size_t n, float* z){
+    active().softmax_cross_entropy(n, z, n, z, nullptr);
+}
+
+void Kernels::to_fp32(size_t n, const bf16* x, float* y){
+    active().to_fp32(n, x, y);
+}
+
+float* Kernels::pack_buffer(){
+    thread_local float packed[KC * NC];
+    return packed;
+}
+
+Kernels::bf16* Kernels::pack_buffer_bf16(){
+    // KC is even, so the pairs of a tile fit exactly
+    thread_local bf16 packed[KC * NC];
+    return packed;
+}
+
+void Kernels::gemm_nt(size_t M, size_t N, size_t K, const float* A, \
+        size_t lda, const float* B, size_t ldb, float* C, size_t ldc){
+    gemm_nt(M, N, K, A, lda, B, ldb, C, ldc, [](float*, size_t, size_t){});
+}
+
+void Kernels::gemm_nn(size_t M, size_t N, size_t K, const float* A, \
+        size_t lda, const float* B, size_t ldb, float* C, size_t ldc){
+    for (size_t m = 0; m < M; m++){
+        std::memset(C + m*ldc, 0, N * sizeof(float));
+    }
+    // Tile of B (KC rows x NC*4 columns) stays in cache for all rows of A
+    const size_t nc = NC * 4;
+    const KernelTable& kt = active();
+    for (size_t k0 = 0; k0 < K; k0 += KC){
+        size_t k1 = std::min(k0 + KC, K);
+        for (size_t n0 = 0; n0 < N; n0 += nc){
+            size_t nb = std::min(nc, N - n0);
+            for (size_t m = 0; m < M; m++){
+                const float* a = A + m*lda;
+                float* c = C + m*ldc + n0;
+                for (size_t k = k0; k < k1; k++){
+                    kt.axpy(nb, a[k], B + k*ldb + n0, c);
+                }
+            }
+        }
+    }
+}
+
+void Kernels::gemm_tn(size_t M, size_t N, size_t K, float alpha, \
+        const float* A, size_t lda, const float* B, size_t ldb, float* C, \
+                                                                size_t ldc){
+    // A tile of C (NC rows x KC columns) is kept hot while every row of the
+    // batch (K) is accumulated into it
+    const KernelTable& kt = active();
+    for (size_t m0 = 0; m0 < M; m0 += NC){
+        size_t m1 = std::min(m0 + NC, M);
+        for (size_t n0 = 0; n0 < N; n0 += KC){
+            size_t nb = std::min(KC, N - n0);
+            for (size_t k = 0; k < K; k++){
+                const float* a = A + k*lda;
+                const float* b = B + k*ldb + n0;
+                for (size_t m = m0; m < m1; m++){
+                    float scale = alpha * a[m];
+                    if (scale == 0.0f) continue; // dead ReLU, common
+                    kt.axpy(nb, scale, b, C + m*ldc + n0);
+                }
+            }
+        }
+    }
+}
+
+namespace {
+    // bf16 tiles widened to fp32 once and then reused from cache by every
+    // row, instead of widening them again for each row in the inner loop
+    float* widen_buffer(size_t n){
+        thread_local std::vector<float> buffer;
+        if (buffer.size() < n) buffer.resize(n);
+        return buffer.data();
+    }
+}
+
+void Kernels::gemm_nn(size_t M, size_t N, size_t K, const float* A, \
+        size_t lda, const bf16* B, size_t ldb, float* C, size_t ldc){
+    for (size_t m = 0; m < M; m++){
+        std::memset(C + m*ldc, 0, N * sizeof(float));
+    }
+    const size_t nc = NC * 4;
+    const KernelTable& kt = active();
+    float* tile = widen_buffer(KC * nc);
+    for (size_t k0 = 0; k0 < K; k0 += KC){
+        size_t k1 = std::min(k0 + KC, K);
+        for (size_t n0 = 0; n0 < N; n0 += nc){
+            size_t nb = std::min(nc, N - n0);
+            for (size_t k = k0; k < k1; k++){
+                kt.to_fp32(nb, B + k*ldb + n0, tile + (k - k0)*nb);
+            }
+            for (size_t m = 0; m < M; m++){
+                const float* a = A + m*lda;
+                float* c = C + m*ldc + n0;
+                for (size_t k = k0; k < k1; k++){
+                    kt.axpy(nb, a[k], tile + (k - k0)*nb, c);
+                }
+            }
+        }
+    }
+}
+
+void Kernels::gemm_tn(size_t M, size_t N, size_t K, float alpha, \
+        const float* A, size_t lda, const bf16* B, size_t ldb, float* C, \
+                                                                size_t ldc){
+    // every KC columns of B are widened once for all the tiles of C
+    const KernelTable& kt = active();
+    float* rows = widen_buffer(K * KC);
+    for (size_t n0 = 0; n0 < N; n0 += KC){
+        size_t nb = std::min(KC, N - n0);
+        for (size_t k = 0; k < K; k++){
+            kt.to_fp32(nb, B + k*ldb + n0, rows + k*nb);
+        }
+        for (size_t m0 = 0; m0 < M; m0 += NC){
+            size_t m1 = std::min(m0 + NC, M);
+            for (size_t k = 0; k < K; k++){
+                const float* a = A + k*lda;
+                const float* b = rows + k*nb;
+                for (size_t m = m0; m < m1; m++){
+                    float scale = alpha * a[m];
+                    if (scale == 0.0f) continue; // dead ReLU, common
+                    kt.axpy(nb, scale, b, C + m*ldc + n0);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,291 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Dense linear algebra kernels used by the layers.
+ *  All matrices are row-major and flattened, ld* is the row stride
+ *  (leading dimension) of each matrix in number of floats.
+ *  The vector routines have one implementation per instruction set, the
+ *  best one supported by the CPU is picked once at startup.
+ */
+
+#pragma once
+
+#include<algorithm>
+#include<cstddef>
+#include<cstdint>
+#include<cstring>
+
+namespace Kernels {
+    // Tile sizes for the cache blocked gemms. A KC x NC float tile of the
+    // weights is 256*64*4 = 64KB, which fits comfortably in L2 and is reused
+    // for every row of the batch before moving on to the next tile.
+    constexpr size_t KC = 256;
+    constexpr size_t NC = 64;
+
+    // AVX512_VNNI is AVX512 with the VNNI integer dot product,
+    // AVX512_BF16 adds the native bf16 conversions and dot product to it
+    enum class Isa { SCALAR, AVX2, AVX512, AVX512_VNNI, AVX512_BF16, NEON };
+
+    // bfloat16: the top 16 bits of a float, same range but 8 bits of
+    // mantissa. Stored as raw bits since C++17 has no such type.
+    typedef uint16_t bf16;
+
+    /**
+     * @brief Precision of the weights and activations read by the training
+     *        passes, the dot products always add up in fp32
+     */
+    enum class Precision { FP32, BF16 };
+
+    /**
+     * @brief Exact, every bf16 is a float
+     */
+    inline float from_bf16(bf16 x){
+        uint32_t bits = (uint32_t)x << 16;
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+
+    /**
+     * @brief Constants of one Adam(W) step, the same for every parameter
+     */
+    struct AdamStep {
+        float grad_scale;   // the gradient is grad_scale * grad
+        float beta1, beta2, epsilon;
+        float step_size;    // learning_rate / (1 - beta1^t)
+        float v_correction; // 1 / (1 - beta2^t)
+        float decay;        // 1 - learning_rate * weight_decay, 1 for Adam
+    };
+
+    /**
+     * @brief One implementation of every vector routine for an instruction set
+     */
+    struct KernelTable {
+        Isa isa;
+        const char* name;
+        // returns sum(a[i]*b[i])
+        float (*dot)(const float* a, const float* b, size_t n);
+        // y += alpha*x
+        void (*axpy)(size_t n, float alpha, const float* x, float* y);
+        // A(mxn) += alpha * x(m) * y(n)^T
+        void (*rank1_update)(size_t m, size_t n, float alpha, const float* x,\
+                                    const float* y, float* A, size_t lda);
+        // c(nb) += a(kc) * P(kc x nb), P is a tile packed by gemm_nt
+        void (*packed_gemv)(size_t kc, size_t nb, const float* a, \
+                                            const float* packed, float* c);
+        // param += alpha*grad, then grad = 0
+        void (*sgd_step)(size_t n, float alpha, float* grad, float* param);
+        // velocity = mu*velocity + scale*grad, param -= lr*velocity,
+        // then grad = 0
+        void (*momentum_step)(size_t n, float lr, float mu, float scale, \
+                                float* grad, float* velocity, float* param);
+        // m, v = moments of scale*grad, param = param*decay -
+        // step_size * m / (sqrt(v*v_correction) + epsilon), then grad = 0
+        void (*adam_step)(size_t n, const AdamStep& s, float* grad, float* m,\
+                                                    float* v, float* param);
+        // returns sum(a[i]*b[i]) exactly, for the int8 inference
+        int32_t (*dot_u8s8)(const uint8_t* a, const int8_t* b, size_t n);
+        // y = x rounded to the nearest bf16 (ties to even)
+        void (*to_bf16)(size_t n, const float* x, bf16* y);
+        // returns sum(a[i]*b[i]) added up in fp32
+        float (*dot_bf16)(const bf16* a, const bf16* b, size_t n);
+        // y = x, exact
+        void (*to_fp32)(size_t n, const bf16* x, float* y);
+        // c(nb) += a(kc) * P(kc x nb), P is a tile packed by the bf16
+        // gemm_nt: rows k and k+1 interleaved, so every 32 bits hold the
+        // pair of weights multiplied by a[k], a[k+1]
+        void (*packed_gemv_bf16)(size_t kc, size_t nb, const bf16* a, \
+                                            const bf16* packed, float* c);
+        // y = softmax(z) with a vector exp, z can be y. If delta is not
+        // nullptr also delta = y - onehot(target), the gradient of the
+        // cross entropy w.r.t. z. Returns the cross entropy -log(y[target])
+        // from the logits, 0 if target >= n (then nothing is subtracted).
+        float (*softmax_cross_entropy)(size_t n, const float* z, \
+                                size_t target, float* y, float* delta);
+    };
+
+    /**
+     * @brief Gets the kernels for the given instruction set
+     *
+     * @return nullptr if the CPU (or the compiler) does not support it
+     */
+    const KernelTable* table(Isa isa);
+
+    /**
+     * @brief Gets the fastest kernels supported by this CPU
+     */
+    const KernelTable& active();
+
+    float dot(const float* a, const float* b, size_t n);
+    void axpy(size_t n, float alpha, const float* x, float* y);
+    void rank1_update(size_t m, size_t n, float alpha, const float* x, \
+                                    const float* y, float* A, size_t lda);
+    void sgd_step(size_t n, float alpha, float* grad, float* param);
+    void momentum_step(size_t n, float lr, float mu, float scale, \
+                                float* grad, float* velocity, float* param);
+    void adam_step(size_t n, const AdamStep& s, float* grad, float* m, \
+                                                    float* v, float* param);
+    int32_t dot_u8s8(const uint8_t* a, const int8_t* b, size_t n);
+    void to_bf16(size_t n, const float* x, bf16* y);
+    void to_fp32(size_t n, const bf16* x, float* y);
+    float softmax_cross_entropy(size_t n, const float* z, size_t target, \
+                                                    float* y, float* delta);
+    /**
+     * @brief Numerically stable softmax of a row, in place
+     */
+    void softmax(size_t n, float* z);
+
+    /**
+     * @brief C(MxN) = A(MxK) * B(NxK)^T
+     *        Used by the forward pass: Z = X * W^T
+     */
+    void gemm_nt(size_t M, size_t N, size_t K, const float* A, size_t lda,\
+                        const float* B, size_t ldb, float* C, size_t ldc);
+
+    /**
+     * @brief Same as gemm_nt, then epilogue(c, n0, nb) is called on every
+     *        finished piece c = C[m][n0 .. n0+nb) while it is still in L1.
+     *        The forward pass adds the bias and the activation there.
+     *        Defined below since the epilogue is inlined into the loop.
+     */
+    template<typename Epilogue>
+    void gemm_nt(size_t M, size_t N, size_t K, const float* A, size_t lda,\
+                        const float* B, size_t ldb, float* C, size_t ldc, \
+                        const Epilogue& epilogue);
+
+    /**
+     * @brief gemm_nt on bf16 matrices, the products are added up in fp32
+     */
+    template<typename Epilogue>
+    void gemm_nt(size_t M, size_t N, size_t K, const bf16* A, size_t lda,\
+                        const bf16* B, size_t ldb, float* C, size_t ldc, \
+                        const Epilogue& epilogue);
+
+    /**
+     * @brief KC*NC floats of scratch for packing tiles, one per thread
+     */
+    float* pack_buffer();
+    bf16* pack_buffer_bf16();
+
+    /**
+     * @brief C(MxN) = A(MxK) * B(KxN)
+     *        Used to propagate the deltas: dX = dZ * W
+     */
+    void gemm_nn(size_t M, size_t N, size_t K, const float* A, size_t lda,\
+                        const float* B, size_t ldb, float* C, size_t ldc);
+    void gemm_nn(size_t M, size_t N, size_t K, const float* A, size_t lda,\
+                        const bf16* B, size_t ldb, float* C, size_t ldc);
+
+    /**
+     * @brief C(MxN) += alpha * A(KxM)^T * B(KxN)
+     *        Used for the weight gradient: dW += alpha * dZ^T * X
+     */
+    void gemm_tn(size_t M, size_t N, size_t K, float alpha, const float* A,\
+            size_t lda, const float* B, size_t ldb, float* C, size_t ldc);
+    void gemm_tn(size_t M, size_t N, size_t K, float alpha, const float* A,\
+            size_t lda, const bf16* B, size_t ldb, float* C, size_t ldc);
+
+    template<typename Epilogue>
+    void gemm_nt(size_t M, size_t N, size_t K, const float* A, size_t lda,\
+                        const float* B, size_t ldb, float* C, size_t ldc, \
+                        const Epilogue& epilogue){
+        // B is packed one KC x NC tile at a time into a transposed buffer, so
+        // the inner loop becomes a contiguous multiply-add over n instead of
+        // a reduction over k, and the tile is reused by all M rows of A
+        const KernelTable& kt = active();
+        if (M < 8){
+            // too few rows to pay for the packing, use straight dot products
+            for (size_t m = 0; m < M; m++){
+                float* c = C + m*ldc;
+                for (size_t n = 0; n < N; n++){
+                    c[n] = kt.dot(A + m*lda, B + n*ldb, K);
+                }
+                epilogue(c, 0, N);
+            }
+            return;
+        }
+        float* packed = pack_buffer();
+        for (size_t m = 0; m < M; m++){
+            std::memset(C + m*ldc, 0, N * sizeof(float));
+        }
+        for (size_t n0 = 0; n0 < N; n0 += NC){
+            size_t nb = std::min(NC, N - n0);
+            for (size_t k0 = 0; k0 < K; k0 += KC){
+                size_t kc = std::min(KC, K - k0);
+                bool last = k0 + kc == K;
+                // 8 rows of B at a time, so every write of the transpose
+                // fills a run of the packed row instead of one float
+                size_t n = 0;
+                for (; n + 8 <= nb; n += 8){
+                    const float* b = B + (n0 + n)*ldb + k0;
+                    for (size_t k = 0; k < kc; k++){
+                        float* p = packed + k*nb + n;
+                        for (size_t i = 0; i < 8; i++){
+                            p[i] = b[i*ldb + k];
+                        }
+                    }
+                }
+                for (; n < nb; n++){
+                    const float* b = B + (n0 + n)*ldb + k0;
+                    for (size_t k = 0; k < kc; k++){
+                        packed[k*nb + n] = b[k];
+                    }
+                }
+                for (size_t m = 0; m < M; m++){
+                    float* c = C + m*ldc + n0;
+                    kt.packed_gemv(kc, nb, A + m*lda + k0, packed, c);
+                    if (last) epilogue(c, n0, nb);
+                }
+            }
+        }
+    }
+
+    template<typename Epilogue>
+    void gemm_nt(size_t M, size_t N, size_t K, const bf16* A, size_t lda,\
+                        const bf16* B, size_t ldb, float* C, size_t ldc, \
+                        const Epilogue& epilogue){
+        // Same blocking as the float version, the tile of B is packed with
+        // the rows k, k+1 interleaved for the pairwise bf16 dot product
+        const KernelTable& kt = active();
+        if (M < 8){
+            for (size_t m = 0; m < M; m++){
+                float* c = C + m*ldc;
+                for (size_t n = 0; n < N; n++){
+                    c[n] = kt.dot_bf16(A + m*lda, B + n*ldb, K);
+                }
+                epilogue(c, 0, N);
+            }
+            return;
+        }
+        bf16* packed = pack_buffer_bf16();
+        for (size_t m = 0; m < M; m++){
+            std::memset(C + m*ldc, 0, N * sizeof(float));
+        }
+        for (size_t n0 = 0; n0 < N; n0 += NC){
+            size_t nb = std::min(NC, N - n0);
+            for (size_t k0 = 0; k0 < K; k0 += KC){
+                size_t kc = std::min(KC, K - k0);
+                bool last = k0 + kc == K;
+                // an odd kc gets a zero row to complete its last pair
+                for (size_t n = 0; n < nb; n++){
+                    const bf16* b = B + (n0 + n)*ldb + k0;
+                    bf16* p = packed + 2*n;
+                    size_t k = 0;
+                    for (; k + 2 <= kc; k += 2, p += 2*nb){
+                        p[0] = b[k];
+                        p[1] = b[k + 1];
+                    }
+                    if (k < kc){
+                        p[0] = b[k];
+                        p[1] = 0;
+                    }
+                }
+                for (size_t m = 0; m < M; m++){
+                    float* c = C + m*ldc + n0;
+                    kt.packed_gemv_bf16(kc, nb, A + m*lda + k0, packed, c);
+                    if (last) epilogue(c, n0, nb);
+                }
+            }
+        }
+    }
+}
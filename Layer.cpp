@@ -5,8 +5,10 @@
 */
 
 #include"Layer.h"
-#include"ActivationFuncs.h"
-#include"CostFuncs.h"
+#include"Kernels.h"
+#include"Profiler.h"
+#include<algorithm>
+#include<cmath>
 #include<cstring>
 #include<random>
 #include<iostream>
@@ -27,22 +29,114 @@ Layer::Layer(const Layer& prev, size_t n_neurons, float init_value){
     bias = new float[n_neurons];
     neurons = new float[n_neurons];
     delta = new float[n_neurons];
-    new_weights = new float[n_neurons*input_n_neurons];
+    grad_weights = new float[n_neurons*input_n_neurons]();
+    grad_bias = new float[n_neurons]();
     this->n_neurons = n_neurons;
     number_layers += 1;
     this->initialize_weights(init_value);
 }
 
+Layer::Layer(size_t n_neurons, float* neurons){
+    this->n_neurons = n_neurons;
+    this->neurons = neurons;
+    owns_parameters = false;
+    owns_activations = false;
+    number_layers += 1;
+}
+
+Layer::Layer(const Layer& prev, size_t n_neurons, \
+                            const LayerStorage& storage, float init_value){
+    input_n_neurons = prev.getSize();
+    weights = storage.weights;
+    weights_bf16 = storage.weights_bf16;
+    grad_weights = storage.grad_weights;
+    grad_bias = storage.grad_bias;
+    bias = storage.bias;
+    neurons = storage.neurons;
+    delta = storage.delta;
+    owns_parameters = false;
+    owns_activations = false;
+    this->n_neurons = n_neurons;
+    number_layers += 1;
+    this->initialize_weights(init_value);
+}
+
+int Layer::prune(float threshold){
+    if (weights == nullptr) {
+        std::cerr << "Error: The input layer has no weights to prune." \
+                                                                << std::endl;
+        return 0;
+    }
+    size_t size = n_neurons * input_n_neurons;
+    for (size_t i = 0; i < size; i++){
+        if (std::fabs(weights[i]) < threshold) weights[i] = 0.0f;
+    }
+    setMaskFromWeights();
+    return 1;
+}
+
+int Layer::prune_top_k(size_t k){
+    if (weights == nullptr) {
+        std::cerr << "Error: The input layer has no weights to prune." \
+                                                                << std::endl;
+        return 0;
+    }
+    size_t size = n_neurons * input_n_neurons;
+    if (k < size) {
+        // exactly k are kept, whatever the ties
+        std::vector<uint32_t> order(size);
+        for (size_t i = 0; i < size; i++) order[i] = (uint32_t)i;
+        std::nth_element(order.begin(), order.begin() + k, order.end(), \
+            [this](uint32_t a, uint32_t b){
+                return std::fabs(weights[a]) > std::fabs(weights[b]);
+            });
+        for (size_t i = k; i < size; i++) weights[order[i]] = 0.0f;
+    }
+    setMaskFromWeights();
+    return 1;
+}
+
+void Layer::setMaskFromWeights(){
+    if (weights == nullptr) return;
+    if (sparse == nullptr) sparse = new Sparse::Csr();
+    *sparse = Sparse::from_dense(weights, n_neurons, input_n_neurons, \
+                                                        input_n_neurons);
+}
+
+bool Layer::isPruned() const {
+    return sparse != nullptr;
+}
+
+float Layer::getDensity() const {
+    return sparse != nullptr ? sparse->density() : 1.0f;
+}
+
+void Layer::setSparseKernels(bool enable){
+    sparse_kernels = enable && sparse != nullptr;
+}
+
+bool Layer::usesSparseKernels() const {
+    return sparse_kernels;
+}
+
+void Layer::refreshSparseValues(){
+    if (sparse != nullptr) Sparse::gather(weights, input_n_neurons, *sparse);
+}
+
 void Layer::initialize_weights(float init_value) {
     // initialize the weights and bias
     std::random_device rd;
     std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> distr(0.0f, 1.0f); 
+    // He uniform, keeps the variance of the ReLU outputs the same from
+    // layer to layer. All positive weights make the sums grow with the
+    // input size and the training diverges on inputs like MNIST.
+    float limit = std::sqrt(6.0f / input_n_neurons);
+    std::uniform_real_distribution<float> distr(-limit, limit); 
     for (size_t i = 0; i < n_neurons; i++){
         for (size_t j=0; j < input_n_neurons; j++){
             if (init_value == 0.0f) {
                 weights[i*input_n_neurons + j] = distr(gen);
-                bias[i] = distr(gen);
+                bias[i] = 0.0f;
             } else {
                 weights[i*input_n_neurons + j] = init_value;
                 bias[i] = init_value;
@@ -67,6 +161,26 @@ float* Layer::getWeights() const {
     return weights;
 }
 
+Kernels::bf16* Layer::getWeightsBf16() const {
+    return weights_bf16;
+}
+
+float* Layer::getGradWeights() const {
+    return grad_weights;
+}
+
+float* Layer::getGradBias() const {
+    return grad_bias;
+}
+
+float* Layer::getBias() const {
+    return bias;
+}
+
+size_t Layer::getInputSize() const {
+    return input_n_neurons;
+}
+
 size_t Layer::getSize() const {
     return n_neurons;
 }
@@ -83,103 +197,516 @@ void Layer::setNeurons(const float* data, size_t size){
     std::memcpy(neurons, data, size * sizeof(float));
 }
 
+void Layer::setBatchSize(size_t batch){
+    if (batch == batch_size) return;
+    batch_size = batch;
+    if (owns_activations) delete[] neurons;
+    neurons = new float[n_neurons * batch_size];
+    if (delta != nullptr) {
+        if (owns_activations) delete[] delta;
+        delta = new float[n_neurons * batch_size];
+    }
+    owns_activations = true;
+}
+
+size_t Layer::getBatchSize() const {
+    return batch_size;
+}
+
 void Layer::forward_pass(const Layer& prev){
-    // y = x*w + b
+    if (debug) {
+        trace_forward_pass(prev);
+        return;
+    }
+    // y = f(x*w + b), with one sample the product is a dot per neuron
+    forward(prev.getNeurons(), neurons, 1);
+}
+
+void Layer::trace_forward_pass(const Layer& prev){
     size_t input_size = prev.getSize();
     float *input = prev.getNeurons();
     for (size_t i=0; i < n_neurons; i++){
         float sum = 0;
-        if (debug) std::cout<< "Neuron " << i << ": ";
+        std::cout<< "Neuron " << i << ": ";
         for (size_t j=0; j < input_size; j++){
-            if (debug){
-                std::cout << weights[i*input_size + j] << "x" << input[j] << \
-                    " + ";
-            }
+            std::cout << weights[i*input_size + j] << "x" << input[j] << " + ";
             sum += (weights[i*input_size + j] * input[j]);
         }
         sum += bias[i];
-        if (debug) std::cout << bias[i] << " = " << sum << "\n";
-        neurons[i] = ActivationFuncs::ReLU(sum);
+        std::cout << bias[i] << " = " << sum << "\n";
+        neurons[i] = sum;
+    }
+    // same activation as the normal path, on the sums printed above
+    switch (activation){
+        case Activation::SIGMOID:
+            for (size_t i=0; i < n_neurons; i++){
+                neurons[i] = ActivationFuncs::Sigmoid(neurons[i]);
+            }
+            break;
+        case Activation::TANH:
+            for (size_t i=0; i < n_neurons; i++){
+                neurons[i] = ActivationFuncs::Tanh(neurons[i]);
+            }
+            break;
+        case Activation::SOFTMAX:
+            ActivationFuncs::Softmax(neurons, n_neurons);
+            break;
+        case Activation::IDENTITY:
+            break;
+        default:
+            for (size_t i=0; i < n_neurons; i++){
+                neurons[i] = ActivationFuncs::ReLU(neurons[i]);
+            }
+            break;
     }
 }
 
-void Layer::calcError(float* target){
-    error = CostFuncs::MSE(neurons, target, n_neurons);
+void Layer::calcError(float* target, Cost cost){
+    NN_PROFILE_SCOPE("loss", n_neurons, 0, 3 * n_neurons, \
+                                            2 * n_neurons * sizeof(float));
+    if (cost == Cost::CROSS_ENTROPY) {
+        error = CostFuncs::CrossEntropy(neurons, target, n_neurons);
+    } else {
+        error = CostFuncs::MSE(neurons, target, n_neurons);
+    }
+}
+
+void Layer::setActivation(Activation activation){
+    this->activation = activation;
+}
+
+Activation Layer::getActivation() const {
+    return activation;
+}
+
+void Layer::accumulate_sample_gradient(const Layer& input){
+    // dW += delta * x^T, db += delta
+    if (sparse != nullptr) {
+        Sparse::sddmm_tn(1, 1.0f, delta, n_neurons, input.getNeurons(), \
+                    input_n_neurons, *sparse, grad_weights, input_n_neurons);
+    } else {
+        Kernels::rank1_update(n_neurons, input_n_neurons, 1.0f, delta, \
+                        input.getNeurons(), grad_weights, input_n_neurons);
+    }
+    Kernels::axpy(n_neurons, 1.0f, delta, grad_bias);
+}
+
+void Layer::apply_gradients(const float learning_rate, size_t n_samples){
+    if (debug) {
+        trace_apply_gradients(learning_rate, n_samples);
+        return;
+    }
+    // W -= lr/n * dW and dW = 0 in the same pass over memory
+    float scale = -learning_rate / n_samples;
+    Kernels::sgd_step(n_neurons * input_n_neurons, scale, grad_weights, \
+                                                                weights);
+    Kernels::sgd_step(n_neurons, scale, grad_bias, bias);
+}
+
+void Layer::trace_apply_gradients(const float learning_rate, \
+                                                        size_t n_samples){
+    float scale = learning_rate / n_samples;
+    for (size_t i=0; i < n_neurons; i++){
+        for (size_t j=0; j < input_n_neurons; j++){
+            size_t w = i*input_n_neurons + j;
+            std::cout<<"Weight "<<w<<" was: "<<weights[w]<<\
+            " New Weight = "<<weights[w]<<" - "<<scale<<\
+            "*"<<grad_weights[w]<<" = ";
+            weights[w] -= scale*grad_weights[w];
+            grad_weights[w] = 0.0f;
+            std::cout<<weights[w]<<"\n";
+        }
+        bias[i] -= scale*grad_bias[i];
+        grad_bias[i] = 0.0f;
+        std::cout<<"New Bias: "<<bias[i]<<"\n";
+    }
 }
 
-void Layer::backward_pass(const float* output, const Layer& input, \
-                                                const float learning_rate){
+void Layer::backward_pass(const float* output, const Layer& input){
     size_t size = this->getSize();
+    NN_PROFILE_SCOPE("backward", n_neurons, input_n_neurons, \
+        2 * n_neurons * input_n_neurons, \
+        2 * n_neurons * input_n_neurons * sizeof(float));
     
-    for (size_t i=0; i < size; i++){
-        if (debug) std::cout<<"Delta "<<i<< " was: "<<delta[i];
-        delta[i] =  output[i] * \
-            ActivationFuncs::derivate_ReLU(neurons[i]);
-        if (debug) std::cout<<" Delta after update: "<<delta[i]<<"\n";
+    if (debug) {
+        for (size_t i=0; i < size; i++){
+            std::cout<<"Delta "<<i<< " was: "<<delta[i]<<"\n";
+        }
     }
-
-    float *input_neurons = input.getNeurons();
-    size_t input_size = input.getSize();
-    for (size_t i=0; i < size; i++){
-        for (size_t j=0; j < input_size; j++){
-            if (debug){
-                std::cout<<"Weight "<<i*size+j<<" was: "<<weights[i*size + j]<<\
-                " New Weight = "<<weights[i*size+j]<<" - "<<learning_rate<<\
-                "*"<<delta[i]<<"*"<<input_neurons[j] <<" = ";
-                
-            }
-            new_weights[i*input_size + j] = weights[i*input_size + j] - \
-                                    learning_rate*delta[i]*input_neurons[j];
-            if (debug) std::cout<<new_weights[i*input_size + j]<<"\n";
+    activation_delta(output, neurons, delta, 1);
+    if (debug) {
+        for (size_t i=0; i < size; i++){
+            std::cout<<"Delta after update "<<i<<": "<<delta[i]<<"\n";
         }
-        bias[i] -= learning_rate*delta[i];
-        if (debug) std::cout<<"New Bias: "<<bias[i]<<"\n";
     }
+    accumulate_sample_gradient(input);
 }
 
-void Layer::backward_pass(const Layer& output, const Layer& input, \
-                                                const float learning_rate) {
+void Layer::backward_pass_label(size_t label, const Layer& input){
+    if (activation != Activation::SOFTMAX || label >= n_neurons) {
+        std::cerr << "Error: Needs a softmax layer and a label below its " \
+                                                "size." << std::endl;
+        return;
+    }
+    // d(cross entropy)/dz of a softmax is y - onehot
+    std::memcpy(delta, neurons, n_neurons * sizeof(float));
+    delta[label] -= 1.0f;
+    error = -std::log(std::fmax(neurons[label], CostFuncs::MIN_PROBABILITY));
+    accumulate_sample_gradient(input);
+}
+
+void Layer::backward_pass(const Layer& output, const Layer& input) {
     size_t size = this->getSize();
     size_t output_size = output.getSize();
     float* output_delta = output.getDelta();
+    NN_PROFILE_SCOPE("backward", n_neurons, input_n_neurons, \
+        2 * n_neurons * (input_n_neurons + output_size), \
+        (2 * input_n_neurons + output_size) * n_neurons * sizeof(float));
     float* output_weights = output.getWeights();
-    float *input_neurons = input.getNeurons();
-    size_t input_size = input.getSize();
 
-    for (size_t i=0; i < size; i++){
-        float error_from_outputs = 0;
-        for (size_t j=0; j < output_size; j++){
-            error_from_outputs += output_delta[j] * output_weights[j*size + i];
+    // error_from_outputs = delta_out * W_out, accumulated one row of W_out at
+    // a time so the weights are read contiguously
+    if (debug) {
+        for (size_t i=0; i < size; i++){
+            std::cout<<"Delta "<<i<< " was: "<<delta[i]<<"\n";
+        }
+    }
+    std::memset(delta, 0, size * sizeof(float));
+    for (size_t j=0; j < output_size; j++){
+        Kernels::axpy(size, output_delta[j], output_weights + j*size, delta);
+    }
+    activation_delta(delta, neurons, delta, 1);
+    if (debug) {
+        for (size_t i=0; i < size; i++){
+            std::cout<<"Delta after update "<<i<<": "<<delta[i]<<"\n";
+        }
+    }
+    accumulate_sample_gradient(input);
+}
+
+template<typename Act, typename T>
+void Layer::forward_as(const T* weights, const float* bias, \
+                            size_t n_neurons, size_t input_n_neurons, \
+                            const T* input, float* output, size_t batch){
+    // Z(batch x n) = X(batch x in) * W^T(in x n), the bias and activation
+    // are applied by the gemm to each piece of a row as soon as it is done
+    Kernels::gemm_nt(batch, n_neurons, input_n_neurons, input, \
+            input_n_neurons, weights, input_n_neurons, output, n_neurons, \
+            [bias](float* z, size_t n0, size_t nb){
+                for (size_t i = 0; i < nb; i++){
+                    z[i] = Act::apply(z[i] + bias[n0 + i]);
+                }
+            });
+    if (Act::ROW_WISE) {
+        for (size_t r = 0; r < batch; r++){
+            Act::apply_row(output + r*n_neurons, n_neurons);
         }
-        if (debug) std::cout<<"Delta "<<i<< " was: "<<delta[i];
-        delta[i] =  error_from_outputs * \
-            ActivationFuncs::derivate_ReLU(neurons[i]);
-        if (debug) std::cout<<" Delta after update: "<<delta[i]<<"\n";
     }
+}
 
-    for (size_t i=0; i < size; i++){
-        for (size_t j=0; j < input_size; j++){
-            if (debug){
-                std::cout<<"Weight "<<i*size+j<<" was: "<<weights[i*size + j]<<\
-                " New Weight = "<<weights[i*size+j]<<" - "<<learning_rate<<\
-                "*"<<delta[i]<<"*"<<input_neurons[j] <<" = ";
-                
+template<typename Act>
+void Layer::activation_delta_as(const float* grad, const float* output, \
+                                        float* delta, size_t batch) const{
+    if (Act::ROW_WISE) {
+        // softmax: delta = y * (grad - <grad, y>) for every row
+        for (size_t r = 0; r < batch; r++){
+            const float* g = grad + r*n_neurons;
+            const float* y = output + r*n_neurons;
+            float* d = delta + r*n_neurons;
+            float dot = Kernels::dot(g, y, n_neurons);
+            for (size_t i = 0; i < n_neurons; i++){
+                d[i] = y[i] * (g[i] - dot);
             }
-            new_weights[i*input_size + j] = weights[i*input_size + j] - \
-                                        learning_rate*delta[i]*input_neurons[j];
-            if (debug) std::cout<<new_weights[i*input_size + j]<<"\n";
         }
-        bias[i] -= learning_rate*delta[i];
-        if (debug) std::cout<<"New Bias: "<<bias[i]<<"\n";
+        return;
+    }
+    size_t size = n_neurons * batch;
+    for (size_t i = 0; i < size; i++){
+        delta[i] = grad[i] * Act::derivative(output[i]);
     }
 }
 
+void Layer::forward(const float* input, float* output, size_t batch) const{
+    NN_PROFILE_SCOPE("forward", n_neurons, input_n_neurons, \
+        2 * batch * n_neurons * input_n_neurons, \
+        (n_neurons * (input_n_neurons + 1) + \
+        batch * (input_n_neurons + n_neurons)) * sizeof(float));
+    if (sparse_kernels) {
+        NN_PROFILE_WORK(2 * batch * sparse->nnz(), \
+            (sparse->nnz() * 2 + n_neurons + \
+            batch * (input_n_neurons + n_neurons)) * sizeof(float));
+        sparse_forward(*sparse, bias, activation, input, output, batch);
+        return;
+    }
+    dense_forward(weights, bias, n_neurons, input_n_neurons, activation, \
+                                                    input, output, batch);
+}
+
+void Layer::dense_forward(const float* weights, const float* bias, \
+                    size_t n_neurons, size_t input_n_neurons, \
+                    Activation activation, const float* input, float* output,\
+                    size_t batch){
+    forward_any(weights, bias, n_neurons, input_n_neurons, activation, \
+                                                    input, output, batch);
+}
+
+template<typename Act>
+void Layer::sparse_forward_as(const Sparse::Csr& weights, \
+                            const float* bias, const float* input, \
+                            float* output, size_t batch){
+    size_t n_neurons = weights.rows;
+    Sparse::spmm_nt(batch, input, weights.cols, weights, output, n_neurons);
+    for (size_t r = 0; r < batch; r++){
+        float* z = output + r*n_neurons;
+        for (size_t i = 0; i < n_neurons; i++){
+            z[i] = Act::apply(z[i] + bias[i]);
+        }
+        if (Act::ROW_WISE) Act::apply_row(z, n_neurons);
+    }
+}
+
+void Layer::sparse_forward(const Sparse::Csr& weights, \
+                    const float* bias, Activation activation, \
+                    const float* input, float* output, size_t batch){
+    using namespace ActivationFuncs;
+    switch (activation){
+        case Activation::SIGMOID:
+            sparse_forward_as<SigmoidPolicy>(weights, bias, input, output, \
+                                                                    batch);
+            break;
+        case Activation::TANH:
+            sparse_forward_as<TanhPolicy>(weights, bias, input, output, \
+                                                                    batch);
+            break;
+        case Activation::SOFTMAX:
+            sparse_forward_as<SoftmaxPolicy>(weights, bias, input, output, \
+                                                                    batch);
+            break;
+        case Activation::IDENTITY:
+            sparse_forward_as<IdentityPolicy>(weights, bias, input, output, \
+                                                                    batch);
+            break;
+        default:
+            sparse_forward_as<ReLUPolicy>(weights, bias, input, output, \
+                                                                    batch);
+            break;
+    }
+}
+
+void Layer::forward_bf16(const Kernels::bf16* input, float* output, \
+                                                        size_t batch) const{
+    NN_PROFILE_SCOPE("forward", n_neurons, input_n_neurons, \
+        2 * batch * n_neurons * input_n_neurons, \
+        n_neurons * (input_n_neurons * sizeof(Kernels::bf16) + \
+        sizeof(float)) + batch * (input_n_neurons * sizeof(Kernels::bf16) +\
+                                                n_neurons * sizeof(float)));
+    forward_any(weights_bf16, bias, n_neurons, input_n_neurons, activation,\
+                                                    input, output, batch);
+}
+
+template<typename T>
+void Layer::forward_any(const T* weights, const float* bias, \
+                    size_t n_neurons, size_t input_n_neurons, \
+                    Activation activation, const T* input, float* output, \
+                    size_t batch){
+    using namespace ActivationFuncs;
+    switch (activation){
+        case Activation::SIGMOID:
+            forward_as<SigmoidPolicy>(weights, bias, n_neurons, \
+                                input_n_neurons, input, output, batch);
+            break;
+        case Activation::TANH:
+            forward_as<TanhPolicy>(weights, bias, n_neurons, \
+                                input_n_neurons, input, output, batch);
+            break;
+        case Activation::SOFTMAX:
+            forward_as<SoftmaxPolicy>(weights, bias, n_neurons, \
+                                input_n_neurons, input, output, batch);
+            break;
+        case Activation::IDENTITY:
+            forward_as<IdentityPolicy>(weights, bias, n_neurons, \
+                                input_n_neurons, input, output, batch);
+            break;
+        default:
+            forward_as<ReLUPolicy>(weights, bias, n_neurons, \
+                                input_n_neurons, input, output, batch);
+            break;
+    }
+}
+
+void Layer::activation_delta(const float* grad, const float* output, \
+                                        float* delta, size_t batch) const{
+    using namespace ActivationFuncs;
+    switch (activation){
+        case Activation::SIGMOID:
+            activation_delta_as<SigmoidPolicy>(grad, output, delta, batch);
+            break;
+        case Activation::TANH:
+            activation_delta_as<TanhPolicy>(grad, output, delta, batch);
+            break;
+        case Activation::SOFTMAX:
+            activation_delta_as<SoftmaxPolicy>(grad, output, delta, batch);
+            break;
+        case Activation::IDENTITY:
+            activation_delta_as<IdentityPolicy>(grad, output, delta, batch);
+            break;
+        default:
+            activation_delta_as<ReLUPolicy>(grad, output, delta, batch);
+            break;
+    }
+}
+
+float Layer::forward_cross_entropy(const float* input, \
+                    const uint8_t* labels, float* output, float* delta, \
+                                                        size_t batch) const{
+    {
+        NN_PROFILE_SCOPE("forward", n_neurons, input_n_neurons, \
+            2 * batch * n_neurons * input_n_neurons, \
+            (n_neurons * (input_n_neurons + 1) + \
+            batch * (input_n_neurons + n_neurons)) * sizeof(float));
+        // the logits, the softmax is done with the loss
+        if (sparse_kernels) {
+            sparse_forward_as<ActivationFuncs::IdentityPolicy>(*sparse, \
+                                            bias, input, output, batch);
+        } else {
+            forward_as<ActivationFuncs::IdentityPolicy>(weights, bias, \
+                    n_neurons, input_n_neurons, input, output, batch);
+        }
+    }
+    return cross_entropy_rows(labels, output, delta, batch);
+}
+
+float Layer::forward_cross_entropy_bf16(const Kernels::bf16* input, \
+                    const uint8_t* labels, float* output, float* delta, \
+                                                        size_t batch) const{
+    {
+        NN_PROFILE_SCOPE("forward", n_neurons, input_n_neurons, \
+            2 * batch * n_neurons * input_n_neurons, \
+            n_neurons * (input_n_neurons * sizeof(Kernels::bf16) + \
+            sizeof(float)) + batch * (input_n_neurons * \
+                    sizeof(Kernels::bf16) + n_neurons * sizeof(float)));
+        forward_as<ActivationFuncs::IdentityPolicy>(weights_bf16, bias, \
+                    n_neurons, input_n_neurons, input, output, batch);
+    }
+    return cross_entropy_rows(labels, output, delta, batch);
+}
+
+float Layer::cross_entropy_rows(const uint8_t* labels, float* output, \
+                                        float* delta, size_t batch) const{
+    // the logits are read twice and the output written twice, the delta
+    // once, about 20 flops per exp
+    NN_PROFILE_SCOPE("softmax_cross_entropy", n_neurons, 0, \
+                24 * batch * n_neurons, 5 * batch * n_neurons * sizeof(float));
+    float loss = 0.0f;
+    for (size_t r = 0; r < batch; r++){
+        float* y = output + r*n_neurons;
+        float* d = delta + r*n_neurons;
+        loss += Kernels::softmax_cross_entropy(n_neurons, y, labels[r], y, d);
+        if (labels[r] >= n_neurons) std::memset(d, 0, n_neurons * \
+                                                            sizeof(float));
+    }
+    return loss;
+}
+
+void Layer::output_delta(const float* grad, const float* output, \
+                                        float* delta, size_t batch) const{
+    NN_PROFILE_SCOPE("output_delta", n_neurons, input_n_neurons, \
+                batch * n_neurons, 3 * batch * n_neurons * sizeof(float));
+    activation_delta(grad, output, delta, batch);
+}
+
+void Layer::hidden_delta(const Layer& next, const float* next_delta, \
+                    const float* output, float* delta, size_t batch) const{
+    NN_PROFILE_SCOPE("hidden_delta", n_neurons, input_n_neurons, \
+        2 * batch * n_neurons * next.getSize(), \
+        (next.getSize() * (n_neurons + batch) + 2 * batch * n_neurons) * \
+                                                            sizeof(float));
+    // delta(batch x n) = delta_next(batch x next) * W_next(next x n)
+    if (next.sparse_kernels) {
+        Sparse::spmm_nn(batch, next_delta, next.getSize(), *next.sparse, \
+                                                        delta, n_neurons);
+        activation_delta(delta, output, delta, batch);
+        return;
+    }
+    Kernels::gemm_nn(batch, n_neurons, next.getSize(), next_delta, \
+                next.getSize(), next.getWeights(), n_neurons, delta, n_neurons);
+    activation_delta(delta, output, delta, batch);
+}
+
+void Layer::accumulate_gradient(const float* delta, const float* input, \
+                size_t batch, float alpha, float* dW, float* dbias) const{
+    NN_PROFILE_SCOPE("gradient", n_neurons, input_n_neurons, \
+        2 * batch * n_neurons * (input_n_neurons + 1), \
+        (2 * n_neurons * (input_n_neurons + 1) + \
+        batch * (n_neurons + input_n_neurons)) * sizeof(float));
+    // dW += alpha * delta^T(n x batch) * X(batch x in)
+    if (sparse != nullptr) {
+        // the pruned weights get no gradient, so they stay 0
+        Sparse::sddmm_tn(batch, alpha, delta, n_neurons, input, \
+                            input_n_neurons, *sparse, dW, input_n_neurons);
+    } else {
+        Kernels::gemm_tn(n_neurons, input_n_neurons, batch, alpha, delta, \
+                    n_neurons, input, input_n_neurons, dW, input_n_neurons);
+    }
+    for (size_t b = 0; b < batch; b++){
+        Kernels::axpy(n_neurons, alpha, delta + b*n_neurons, dbias);
+    }
+}
+
+void Layer::hidden_delta_bf16(const Layer& next, const float* next_delta, \
+                    const float* output, float* delta, size_t batch) const{
+    NN_PROFILE_SCOPE("hidden_delta", n_neurons, input_n_neurons, \
+        2 * batch * n_neurons * next.getSize(), \
+        next.getSize() * (n_neurons * sizeof(Kernels::bf16) + \
+        batch * sizeof(float)) + 2 * batch * n_neurons * sizeof(float));
+    Kernels::gemm_nn(batch, n_neurons, next.getSize(), next_delta, \
+        next.getSize(), next.getWeightsBf16(), n_neurons, delta, n_neurons);
+    activation_delta(delta, output, delta, batch);
+}
+
+void Layer::accumulate_gradient_bf16(const float* delta, \
+                const Kernels::bf16* input, size_t batch, float alpha, \
+                                            float* dW, float* dbias) const{
+    NN_PROFILE_SCOPE("gradient", n_neurons, input_n_neurons, \
+        2 * batch * n_neurons * (input_n_neurons + 1), \
+        2 * n_neurons * (input_n_neurons + 1) * sizeof(float) + \
+        batch * (n_neurons * sizeof(float) + \
+                                input_n_neurons * sizeof(Kernels::bf16)));
+    Kernels::gemm_tn(n_neurons, input_n_neurons, batch, alpha, delta, \
+                    n_neurons, input, input_n_neurons, dW, input_n_neurons);
+    for (size_t b = 0; b < batch; b++){
+        Kernels::axpy(n_neurons, alpha, delta + b*n_neurons, dbias);
+    }
+}
+
+void Layer::forward_pass_batch(const Layer& prev){
+    forward(prev.getNeurons(), neurons, batch_size);
+}
+
+void Layer::backward_pass_batch(const float* output, const Layer& input){
+    output_delta(output, neurons, delta, batch_size);
+    accumulate_gradient(delta, input.getNeurons(), batch_size, 1.0f, \
+                                                    grad_weights, grad_bias);
+}
+
+void Layer::backward_pass_batch(const Layer& output, const Layer& input){
+    hidden_delta(output, output.getDelta(), neurons, delta, batch_size);
+    accumulate_gradient(delta, input.getNeurons(), batch_size, 1.0f, \
+                                                    grad_weights, grad_bias);
+}
+
 Layer::~Layer(){
-    if (weights!=nullptr) delete[] weights; 
-    if (bias!=nullptr) delete[] bias;
-    if (neurons!=nullptr) delete[] neurons;
-    if (delta!=nullptr) delete[] delta;
-    if (new_weights!=nullptr) delete[] new_weights;
+    if (owns_parameters){
+        if (weights!=nullptr) delete[] weights; 
+        if (bias!=nullptr) delete[] bias;
+        if (grad_weights!=nullptr) delete[] grad_weights;
+        if (grad_bias!=nullptr) delete[] grad_bias;
+    }
+    if (owns_activations){
+        if (neurons!=nullptr) delete[] neurons;
+        if (delta!=nullptr) delete[] delta;
+    }
+    delete sparse;
     number_layers -= 1;
 }
 
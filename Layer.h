@@ -8,8 +8,29 @@
 */
 #pragma once
 
+#include"ActivationFuncs.h"
+#include"CostFuncs.h"
+#include"Kernels.h"
+#include"Sparse.h"
 #include <cstddef>
 
+/**
+ * @brief Memory handed to a Layer by its owner (see NeuralNetwork's arena).
+ *        weights and grad_weights are n_neurons*input_n_neurons floats, the
+ *        others n_neurons floats. The gradients must start zeroed.
+ *        weights_bf16 is an optional bf16 copy of the weights kept up to
+ *        date by the owner, for the *_bf16 passes.
+ */
+struct LayerStorage {
+    float* weights;
+    Kernels::bf16* weights_bf16;
+    float* grad_weights;
+    float* bias;
+    float* grad_bias;
+    float* neurons;
+    float* delta;
+};
+
 class Layer {
     private:
         static bool debug;
@@ -18,12 +39,74 @@ class Layer {
         float error;
         // float** weights; Unflattened is slower (Linear layout of memory)
         float *weights = nullptr;
-        // in backprop first all gradients are calc then weights are updated
-        float *new_weights = nullptr;
+        Kernels::bf16 *weights_bf16 = nullptr; // nullptr without LayerStorage
+        // in backprop first all gradients are calc then weights are updated,
+        // the backward passes add to these until apply_gradients
+        float *grad_weights = nullptr;
         float *bias = nullptr;
+        float *grad_bias = nullptr;
         float *neurons = nullptr;
         float *delta = nullptr;
+        // neurons and delta hold batch_size rows of n_neurons each
+        size_t batch_size = 1;
+        // false when the memory belongs to someone else (LayerStorage)
+        bool owns_parameters = true;
+        bool owns_activations = true;
+        Activation activation = Activation::RELU;
         static size_t number_layers;
+        // the weights left after pruning, nullptr if the layer is dense.
+        // Only they get gradients, the pruned ones stay 0.
+        Sparse::Csr* sparse = nullptr;
+        // forward() and the hidden_delta() of the layer before use the
+        // CSR copy instead of the dense weights
+        bool sparse_kernels = false;
+
+        /**
+         * @brief dense_forward() and activation_delta() for one activation
+         *        policy (see ActivationFuncs.h), the public functions pick
+         *        the policy once per call
+         */
+        template<typename Act, typename T>
+        static void forward_as(const T* weights, const float* bias, \
+                            size_t n_neurons, size_t input_n_neurons, \
+                            const T* input, float* output, size_t batch);
+        template<typename T>
+        static void forward_any(const T* weights, const float* bias, \
+                    size_t n_neurons, size_t input_n_neurons, \
+                    Activation activation, const T* input, float* output, \
+                    size_t batch);
+        template<typename Act>
+        static void sparse_forward_as(const Sparse::Csr& weights, \
+                            const float* bias, const float* input, \
+                            float* output, size_t batch);
+        template<typename Act>
+        void activation_delta_as(const float* grad, const float* output, \
+                                        float* delta, size_t batch) const;
+
+        /**
+         * @brief delta = grad * f'(output), the Jacobian product for softmax.
+         *        grad and delta can be the same buffer.
+         */
+        void activation_delta(const float* grad, const float* output, \
+                                        float* delta, size_t batch) const;
+
+        /**
+         * @brief Softmax and cross entropy of the logits in output, row by
+         *        row, see forward_cross_entropy()
+         */
+        float cross_entropy_rows(const uint8_t* labels, float* output, \
+                                            float* delta, size_t batch) const;
+
+        /**
+         * @brief Adds delta * input^T to the gradients for a single sample
+         */
+        void accumulate_sample_gradient(const Layer& input);
+
+        // Debug versions of the passes, print every multiplication. Kept
+        // separate so the normal path has no branches in its inner loops
+        void trace_forward_pass(const Layer& prev);
+        void trace_apply_gradients(const float learning_rate, \
+                                                        size_t n_samples);
     public:
         /**
          * @brief - Constructor for input layer
@@ -40,6 +123,21 @@ class Layer {
          */
         Layer(const Layer& prev, size_t number_n, float init_value=0.0f);
 
+        /**
+         * @brief Input layer using memory owned by the caller
+         *
+         * @param neurons number_n floats, must outlive the layer
+         */
+        Layer(size_t number_n, float* neurons);
+
+        /**
+         * @brief Layer using memory owned by the caller, nothing is allocated
+         *
+         * @param storage The buffers to use, must outlive the layer
+         */
+        Layer(const Layer& prev, size_t number_n, const LayerStorage& storage,\
+                                                    float init_value=0.0f);
+
         /**
          * @brief get the number of neurons in this layer
          * @return size_t
@@ -58,6 +156,31 @@ class Layer {
          */
         float* getWeights() const;
 
+        /**
+         * @brief Get the bf16 copy of the weights, nullptr if it has none
+         */
+        Kernels::bf16* getWeightsBf16() const;
+
+        /**
+         * @brief Get the gradient of the weights accumulated so far
+         */
+        float* getGradWeights() const;
+
+        /**
+         * @brief Get the gradient of the bias accumulated so far
+         */
+        float* getGradBias() const;
+
+        /**
+         * @brief Get the bias of the neurons in this layer
+         */
+        float* getBias() const;
+
+        /**
+         * @brief Gets the number of inputs of every neuron in this layer
+         */
+        size_t getInputSize() const;
+
         /**
          * @brief Get the error in this layer (used for backprop)
          * 
@@ -75,6 +198,50 @@ class Layer {
         float getError() const;
         void setDebug(bool value);
 
+        /**
+         * @brief Sets the activation of the neurons, ReLU by default
+         */
+        void setActivation(Activation activation);
+        Activation getActivation() const;
+
+        /**
+         * @brief Magnitude pruning: sets the weights smaller than threshold
+         *        (in absolute value) to 0 and keeps them there, training
+         *        only updates the others from then on
+         */
+        int prune(float threshold);
+
+        /**
+         * @brief Magnitude pruning that keeps the k largest weights
+         */
+        int prune_top_k(size_t k);
+
+        /**
+         * @brief Makes the weights that are 0 the pruned ones, for a layer
+         *        whose weights were pruned before (copied, loaded...)
+         */
+        void setMaskFromWeights();
+        bool isPruned() const;
+
+        /**
+         * @brief Fraction of the weights that are not pruned, 1 if dense
+         */
+        float getDensity() const;
+
+        /**
+         * @brief Whether the passes multiply by the CSR copy of the
+         *        weights instead of the dense ones, only for a pruned
+         *        layer. Worth it below Sparse::crossover_density().
+         */
+        void setSparseKernels(bool enable);
+        bool usesSparseKernels() const;
+
+        /**
+         * @brief Copies the weights to the CSR copy read by the sparse
+         *        kernels, after they were updated
+         */
+        void refreshSparseValues();
+
         /**
          * @brief initialize the weights with the given value
          * 
@@ -88,6 +255,20 @@ class Layer {
          * @param data the data to be copied in the neurons of this layer
          */
         void setNeurons(const float* data, size_t size);
+
+        /**
+         * @brief Resizes the neurons and delta to hold a batch of samples.
+         *        Row b of getNeurons()/getDelta() belongs to sample b. If they
+         *        were given in a LayerStorage the layer allocates its own.
+         *
+         * @param batch The number of samples processed together
+         */
+        void setBatchSize(size_t batch);
+
+        /**
+         * @brief Gets the number of samples held by this layer
+         */
+        size_t getBatchSize() const;
         
         /**
          * @brief Executes the forward pass step
@@ -97,27 +278,172 @@ class Layer {
         void forward_pass(const Layer& prev);
         
         /**
-         * @brief backward pass for the output layer
+         * @brief backward pass for the output layer, adds the gradients of
+         *        this sample to the accumulated ones
+         *
+         * @param output The gradient of the cost w.r.t. the neurons
+         * @param input The layer before this layer
          */
-        void backward_pass(const float* output, const Layer& input,\
-                                            const float learning_rate);
+        void backward_pass(const float* output, const Layer& input);
 
         /**
-         * @brief Executes the backward pass step and updates weights
+         * @brief backward pass for a softmax output layer trained on the
+         *        cross entropy of a class index: delta = neurons -
+         *        onehot(label), no gradient of the cost needed. Also sets
+         *        the error to the cross entropy.
+         *
+         * @param label The class of the sample
+         * @param input The layer before this layer
+         */
+        void backward_pass_label(size_t label, const Layer& input);
+
+        /**
+         * @brief Executes the backward pass step, the weights are left as
+         *        they are (the layer before still needs them) and the
+         *        gradients are added to the accumulated ones
          * 
          * @param output The layer right after this layer
          * @param input The layer before this layer
-         * @param learning_rate The learning rate for this function
          */
-        void backward_pass(const Layer& output, const Layer& input,\
-                                                    const float learning_rate);
+        void backward_pass(const Layer& output, const Layer& input);
+
+        /**
+         * @brief Update step, once the backward pass of every layer is done.
+         *        W -= learning_rate/n_samples * dW (same for the bias) and
+         *        the gradients are reset to 0, in a single pass.
+         *
+         * @param learning_rate The learning rate
+         * @param n_samples The number of samples accumulated in the gradients
+         */
+        void apply_gradients(const float learning_rate, size_t n_samples=1);
+
+        /**
+         * @brief Executes the forward pass for the whole batch as one
+         *        matrix-matrix product so every weight is read once per batch
+         *
+         * @param prev - Layer to use as the input, same batch size as this
+         */
+        void forward_pass_batch(const Layer& prev);
+
+        /**
+         * @brief Batched backward pass for the output layer, the gradients of
+         *        the whole batch are added up (apply_gradients with
+         *        n_samples = batch averages them)
+         *
+         * @param output The gradient of the cost, batch x n_neurons
+         * @param input The layer before this layer
+         */
+        void backward_pass_batch(const float* output, const Layer& input);
+
+        /**
+         * @brief Batched backward pass for the hidden layers
+         *
+         * @param output The layer right after this layer
+         * @param input The layer before this layer
+         */
+        void backward_pass_batch(const Layer& output, const Layer& input);
+
+        /*
+         * The functions below only read the weights and work on buffers
+         * owned by the caller, so several threads can run them on the same
+         * layer at once. All buffers are batch rows of n_neurons (or of
+         * the input size for input).
+         */
+
+        /**
+         * @brief output = f(input * W^T + b), f is applied while each tile of
+         *        the product is still in cache
+         */
+        void forward(const float* input, float* output, size_t batch) const;
+
+        /**
+         * @brief forward() on parameters that do not belong to a Layer
+         *        (see InferenceModel)
+         *
+         * @param weights n_neurons x input_n_neurons, row-major
+         * @param bias n_neurons floats
+         */
+        static void dense_forward(const float* weights, const float* bias, \
+                    size_t n_neurons, size_t input_n_neurons, \
+                    Activation activation, const float* input, float* output,\
+                    size_t batch);
+
+        /**
+         * @brief dense_forward() with the weights in CSR
+         */
+        static void sparse_forward(const Sparse::Csr& weights, \
+                    const float* bias, Activation activation, \
+                    const float* input, float* output, size_t batch);
+
+        /**
+         * @brief delta of the output layer from the gradient of the cost
+         *
+         * @param grad The gradient of the cost w.r.t. the output
+         * @param output The output of forward() for the same batch
+         */
+        void output_delta(const float* grad, const float* output, \
+                                        float* delta, size_t batch) const;
+
+        /**
+         * @brief forward() and output_delta() of a softmax output layer
+         *        fused with the cross entropy of integer labels. The logits
+         *        go through one vector pass per row that writes output =
+         *        softmax(logits) and delta = output - onehot(label), the
+         *        one-hot targets are never stored and the Jacobian product
+         *        of the softmax is skipped. A label >= getSize() gets a
+         *        delta of 0 and no loss.
+         *
+         * @param labels The class of every row of the batch
+         * @return The cross entropy summed over the batch, computed from
+         *         the logits so it stays exact for tiny probabilities
+         */
+        float forward_cross_entropy(const float* input, \
+                    const uint8_t* labels, float* output, float* delta, \
+                                                        size_t batch) const;
+        float forward_cross_entropy_bf16(const Kernels::bf16* input, \
+                    const uint8_t* labels, float* output, float* delta, \
+                                                        size_t batch) const;
+
+        /**
+         * @brief delta of a hidden layer from the delta of the next layer
+         *
+         * @param next The layer right after this layer
+         * @param next_delta The delta of the next layer
+         * @param output The output of forward() for the same batch
+         */
+        void hidden_delta(const Layer& next, const float* next_delta, \
+                    const float* output, float* delta, size_t batch) const;
+
+        /**
+         * @brief dW += alpha * delta^T * input and dbias += alpha * delta
+         *        summed over the batch. Only at the weights left if the
+         *        layer is pruned, so dW can also be the weights.
+         */
+        void accumulate_gradient(const float* delta, const float* input, \
+                size_t batch, float alpha, float* dW, float* dbias) const;
         
+        /*
+         * Mixed precision versions of the above: the weights are read from
+         * the bf16 copy and the inputs are bf16, the products are added up
+         * and written in fp32. The sparse kernels are fp32 only, use the
+         * fp32 passes for the layers with sparse kernels (and the gradient
+         * of the pruned ones).
+         */
+        void forward_bf16(const Kernels::bf16* input, float* output, \
+                                                        size_t batch) const;
+        void hidden_delta_bf16(const Layer& next, const float* next_delta, \
+                    const float* output, float* delta, size_t batch) const;
+        void accumulate_gradient_bf16(const float* delta, \
+                const Kernels::bf16* input, size_t batch, float alpha, \
+                                            float* dW, float* dbias) const;
+
         /**
          * @brief Calculates the error using the target
          * 
          * @param target The desired values of the neurons
+         * @param cost The cost function to use
          */
-        void calcError(float* target);
+        void calcError(float* target, Cost cost=Cost::MSE);
         
         /**
          * @brief Destructor to ensure no memory leaks
@@ -8,87 +8,1368 @@
 */
 
 #include "NeuralNetwork.h"
-#include<fstream>
+#include"BatchStream.h"
+#include"CsvParser.h"
+#include"Kernels.h"
+#include"Profiler.h"
+#include"RingAllReduce.h"
+#include<algorithm>
+#include<atomic>
+#include<chrono>
 #include<string>
-#include<sstream>
 #include<vector>
 #include<iostream>
+#include<limits>
+#include<signal.h>
+#include<sys/wait.h>
+#include<unistd.h>
+
+namespace {
+    /**
+     * @brief Loss of rows samples and its gradient, one switch per batch
+     *        instead of one per sample
+     */
+    template<typename CostPolicy>
+    float batch_loss(const float* y, const uint8_t* labels, float* grad, \
+                                            size_t rows, size_t n_classes){
+        NN_PROFILE_SCOPE("loss", n_classes, 0, 3 * rows * n_classes, \
+                                    2 * rows * n_classes * sizeof(float));
+        float loss = 0.0f;
+        for (size_t r = 0; r < rows; r++){
+            loss += CostPolicy::loss_gradient(y + r*n_classes, labels[r], \
+                                        grad + r*n_classes, n_classes);
+        }
+        return loss;
+    }
+
+    /**
+     * @brief Loss of the output y of the last layer, and its delta in grad
+     */
+    float output_loss(const Layer& layer, Cost cost, const float* y, \
+                    const uint8_t* labels, float* grad, size_t rows){
+        // Gradient of the cost against the one-hot target, written in
+        // place of the delta of the output layer
+        size_t n_classes = layer.getSize();
+        float loss;
+        if (cost == Cost::CROSS_ENTROPY) {
+            loss = batch_loss<CostFuncs::CrossEntropyPolicy>(y, labels, \
+                                                grad, rows, n_classes);
+        } else {
+            loss = batch_loss<CostFuncs::MSEPolicy>(y, labels, grad, rows, \
+                                                                n_classes);
+        }
+        layer.output_delta(grad, y, grad, rows);
+        return loss;
+    }
+
+    /**
+     * @brief A buffer of a workspace, live from step first to step last of
+     *        the schedule, both included
+     */
+    struct LiveRange {
+        size_t size, first, last;
+        size_t offset = 0;
+    };
+
+    /**
+     * @brief Gives every range an offset so that ranges live at the same
+     *        step never overlap: largest first, each at the lowest offset
+     *        where it fits. Returns the floats needed for all of them.
+     */
+    size_t pack_ranges(std::vector<LiveRange>& ranges){
+        std::vector<size_t> order(ranges.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){
+            return ranges[a].size > ranges[b].size;
+        });
+        std::vector<const LiveRange*> placed, busy;
+        size_t total = 0;
+        for (size_t i : order){
+            LiveRange& range = ranges[i];
+            busy.clear();
+            for (const LiveRange* other : placed){
+                if (other->first <= range.last && range.first <= other->last) {
+                    busy.push_back(other);
+                }
+            }
+            std::sort(busy.begin(), busy.end(), \
+                    [](const LiveRange* a, const LiveRange* b){
+                return a->offset < b->offset;
+            });
+            size_t offset = 0;
+            for (const LiveRange* other : busy){
+                if (offset + range.size <= other->offset) break;
+                offset = std::max(offset, other->offset + other->size);
+            }
+            range.offset = offset;
+            total = std::max(total, offset + range.size);
+            placed.push_back(&range);
+        }
+        return total;
+    }
+}
 
 NeuralNetwork::NeuralNetwork(float learning_rate){
-    learning_rate = learning_rate;
+    OptimizerConfig config;
+    config.learning_rate = learning_rate;
+    optimizer = Optimizer(config);
 }
 
-int NeuralNetwork::add_layer(size_t size){
-    if (NeuralNetwork::number_layers == 0){ //this is the input layer
-        Layer* x = new Layer(size);
-        layers.push_back(x);
-    } else {
-        Layer* h1 = new Layer(*(layers.at(NeuralNetwork::number_layers-1)), \
-                                                        size);
-        layers.push_back(h1);
-    }
-    NeuralNetwork::number_layers += 1;
+int NeuralNetwork::add_layer(size_t size, Activation activation){
+    // The layers are only created by build(), once the whole topology is
+    // known, so that all of them fit in one allocation
+    sizes.push_back(size);
+    activations.push_back(activation);
     return 1;
 }
 
+void NeuralNetwork::set_cost(Cost cost){
+    this->cost = cost;
+}
+
 void NeuralNetwork::display_layers(){
-    for (size_t i = 0; i < NeuralNetwork::number_layers; i++){
-        Layer* curr_layer = layers.at(i);
-        std::cout<<"Layer "<<i<<": "<<"has "<<(*curr_layer).getSize()<< \
+    for (size_t i = 0; i < sizes.size(); i++){
+        std::cout<<"Layer "<<i<<": "<<"has "<<sizes.at(i)<< \
                                             " neurons\n";
     }
 }
 
+void NeuralNetwork::compile(){
+    if (sizes.size() < 2) {
+        std::cerr << "Error: Need at least 2 layers to compile." << std::endl;
+        return;
+    }
+    build();
+    refresh_sparsity();
+    compile_schedule(false);
+}
+
+void NeuralNetwork::display_plan(){
+    static const char* names[] = {"load_input", "to_bf16", "forward", \
+        "forward_bf16", "cross_entropy", "cross_entropy_bf16", "loss", \
+        "hidden_delta", "hidden_delta_bf16", "gradient", "gradient_bf16", \
+        "gradient_in_place"};
+    for (size_t i = 0; i < schedule.size(); i++){
+        std::cout << "Step " << i << ": " << \
+            names[(size_t)schedule[i].op] << " " << schedule[i].layer << \
+                                                                std::endl;
+    }
+    std::cout << "Activations and deltas of one thread: " << \
+        workspace_floats * sizeof(float) / 1024.0 << " KB (" << \
+        unshared_floats * sizeof(float) / 1024.0 << \
+                                    " KB without sharing)" << std::endl;
+}
+
+void NeuralNetwork::build(){
+    if (sizes.empty()) return;
+    size_t n_shards = std::min(get_pool().size(), batch_size);
+    size_t shard_size = (batch_size + n_shards - 1) / n_shards;
+    size_t n_state = optimizer.getStateCount();
+    if (layers.size() == sizes.size() && n_shards == built_shards && \
+            shard_size == built_shard_size && n_state == built_state && \
+            placement == built_placement && precision == built_precision) {
+        return;
+    }
+    size_t n_layers = sizes.size();
+    auto n_weights = [&](size_t l){ return sizes[l] * sizes[l-1]; };
+
+    // Size everything first so the arena is allocated once
+    size_t params = 0, total = 0;
+    for (size_t l = 1; l < n_layers; l++){
+        params += Arena::round_up(n_weights(l)) + Arena::round_up(sizes[l]);
+    }
+    total = (2 + n_state) * params; // gradients and state mirror them
+    // two bf16 per float of the arena
+    bool mixed = precision == Kernels::Precision::BF16;
+    auto half = [](size_t n){ return Arena::round_up((n + 1) / 2); };
+    if (mixed) total += half(params);
+    // The activations (and their bf16 copies) and the deltas of one
+    // worker, with the step of the schedule that writes them first and the
+    // one that reads them last: forward of layer l at step l (the loss
+    // with the output layer), then backward of layer l at 2*out + 1 - l,
+    // which takes the delta of l-1 and the gradients of l. Buffers that
+    // are never live together share memory.
+    size_t out = n_layers - 1;
+    auto backward = [&](size_t l){ return 2 * out + 1 - l; };
+    std::vector<LiveRange> ranges;
+    std::vector<size_t> act_range(n_layers), act16_range(n_layers);
+    std::vector<size_t> delta_range(n_layers);
+    for (size_t l = 0; l < n_layers; l++){
+        size_t last = l < out ? backward(l + 1) : out;
+        act_range[l] = ranges.size();
+        ranges.push_back({Arena::round_up(shard_size * sizes[l]), l, last});
+        if (mixed && l < out) {
+            act16_range[l] = ranges.size();
+            ranges.push_back({half(shard_size * sizes[l]), l, last});
+        }
+        if (l > 0) {
+            size_t first = l == out ? out : backward(l + 1);
+            delta_range[l] = ranges.size();
+            ranges.push_back({Arena::round_up(shard_size * sizes[l]), \
+                                                    first, backward(l)});
+        }
+    }
+    unshared_floats = 0;
+    for (const LiveRange& range : ranges) unshared_floats += range.size;
+    workspace_floats = pack_ranges(ranges);
+    size_t workspace_size = workspace_floats;
+    for (size_t l = 0; l < n_layers; l++){
+        total += Arena::round_up(sizes[l]) * (l > 0 ? 2 : 1);
+        if (l > 0) {
+            workspace_size += Arena::round_up(n_weights(l)) + \
+                                                Arena::round_up(sizes[l]);
+        }
+    }
+    size_t n_replicas = placement == Placement::REPLICATED ? \
+                                                    Numa::node_count() : 0;
+    // every workspace and replica starts on its own page
+    size_t page = Arena::page_floats();
+    total += n_shards * (workspace_size + page) + page;
+    total += n_replicas * (params + page);
+
+    Arena fresh;
+    fresh.reserve(total);
+    std::vector<LayerStorage> storage(n_layers, LayerStorage());
+    for (size_t l = 1; l < n_layers; l++){
+        storage[l].weights = fresh.take(n_weights(l));
+        storage[l].bias = fresh.take(sizes[l]);
+    }
+    for (size_t l = 1; l < n_layers; l++){
+        storage[l].grad_weights = fresh.take(n_weights(l));
+        storage[l].grad_bias = fresh.take(sizes[l]);
+    }
+    float* state = fresh.take(n_state * params);
+    Kernels::bf16* params_bf16 = nullptr;
+    if (mixed) {
+        params_bf16 = reinterpret_cast<Kernels::bf16*>(\
+                                                fresh.take(half(params)));
+        for (size_t l = 1; l < n_layers; l++){
+            storage[l].weights_bf16 = params_bf16 + \
+                                    (storage[l].weights - fresh.data());
+        }
+    }
+    fresh.align_to_page();
+    for (size_t l = 0; l < n_layers; l++){
+        storage[l].neurons = fresh.take(sizes[l]);
+        if (l > 0) storage[l].delta = fresh.take(sizes[l]);
+    }
+    workspaces.assign(n_shards, Workspace());
+    for (Workspace& ws : workspaces){
+        fresh.align_to_page();
+        ws.activations.assign(n_layers, nullptr);
+        ws.deltas.assign(n_layers, nullptr);
+        ws.grad_weights.assign(n_layers, nullptr);
+        ws.grad_bias.assign(n_layers, nullptr);
+        ws.activations_bf16.assign(n_layers, nullptr);
+        float* planned = fresh.take(workspace_floats);
+        for (size_t l = 0; l < n_layers; l++){
+            ws.activations[l] = planned + ranges[act_range[l]].offset;
+            if (mixed && l < out) {
+                ws.activations_bf16[l] = reinterpret_cast<Kernels::bf16*>(\
+                                    planned + ranges[act16_range[l]].offset);
+            }
+            if (l == 0) continue;
+            ws.deltas[l] = planned + ranges[delta_range[l]].offset;
+            ws.grad_weights[l] = fresh.take(n_weights(l));
+            ws.grad_bias[l] = fresh.take(sizes[l]);
+        }
+        ws.memory = planned;
+        ws.memory_size = workspace_size;
+    }
+    replica_parameters.assign(n_replicas, nullptr);
+    for (size_t k = 0; k < n_replicas; k++){
+        fresh.align_to_page();
+        replica_parameters[k] = fresh.take(params);
+        Numa::bind(replica_parameters[k], params * sizeof(float), k);
+    }
+    built_placement = placement;
+    built_precision = precision;
+    place(fresh.data(), params, 2 + n_state);
+
+    std::vector<Layer*> built;
+    built.push_back(new Layer(sizes[0], storage[0].neurons));
+    for (size_t l = 1; l < n_layers; l++){
+        built.push_back(new Layer(*built.back(), sizes[l], storage[l]));
+        built.back()->setActivation(activations[l]);
+    }
+    // Layers are only ever added at the end, so the parameters trained so
+    // far are the start of the new block
+    if (parameters != nullptr) {
+        size_t kept = std::min(n_parameters, params);
+        std::memcpy(fresh.data(), parameters, kept * sizeof(float));
+        // every block of the state has the same prefix property
+        for (size_t k = 0; k < std::min(n_state, built_state); k++){
+            std::memcpy(state + k * params, \
+                optimizer_state + k * n_parameters, kept * sizeof(float));
+        }
+    }
+    delete_layers();
+    layers = built;
+    // the replicas are layers over the copy of the parameters of a node,
+    // sharing everything else with the main ones
+    replicas.assign(n_replicas, std::vector<Layer*>());
+    for (size_t k = 0; k < n_replicas; k++){
+        replicas[k].push_back(new Layer(sizes[0], storage[0].neurons));
+        for (size_t l = 1; l < n_layers; l++){
+            LayerStorage copy = storage[l];
+            copy.weights = replica_parameters[k] + \
+                                    (storage[l].weights - fresh.data());
+            copy.bias = replica_parameters[k] + \
+                                    (storage[l].bias - fresh.data());
+            replicas[k].push_back(new Layer(*replicas[k].back(), sizes[l], \
+                                                                    copy));
+            replicas[k].back()->setActivation(activations[l]);
+        }
+    }
+    arena.swap(fresh);
+    parameters = arena.data();
+    gradients = parameters + params;
+    optimizer_state = n_state > 0 ? state : nullptr;
+    parameters_bf16 = params_bf16;
+    n_parameters = params;
+    built_shards = n_shards;
+    built_shard_size = shard_size;
+    built_state = n_state;
+    refresh_replicas();
+    refresh_bf16();
+}
+
+void NeuralNetwork::place(float* shared, size_t block, size_t n_blocks){
+    ThreadPool& threads = get_pool();
+    size_t bytes = block * n_blocks * sizeof(float);
+    if (placement == Placement::LOCAL) {
+        // written here, so the shared block lands on the node of this thread
+        std::memset(shared, 0, bytes);
+    } else if (placement == Placement::INTERLEAVED) {
+        Numa::interleave(shared, bytes);
+    } else if (placement == Placement::FIRST_TOUCH) {
+        // every chunk of the parameters, gradients and state is first
+        // written by the thread that updates it in apply_gradients
+        threads.run_static((block + chunk - 1) / chunk, [&](size_t c){
+            size_t off = c * chunk;
+            size_t len = std::min(chunk, block - off);
+            for (size_t b = 0; b < n_blocks; b++){
+                std::memset(shared + b * block + off, 0, len * sizeof(float));
+            }
+        });
+    }
+    // workspace w is always used by thread w (run_static), whatever the
+    // placement, so it is first written there
+    threads.run_static(workspaces.size(), [&](size_t w){
+        Workspace& ws = workspaces[w];
+        std::memset(ws.memory, 0, ws.memory_size * sizeof(float));
+        ws.node = Numa::current_node();
+    });
+}
+
+void NeuralNetwork::refresh_replicas(){
+    if (replicas.empty()) return;
+    size_t n_chunks = (n_parameters + chunk - 1) / chunk;
+    get_pool().run_static(replicas.size() * n_chunks, [&](size_t t){
+        size_t off = (t % n_chunks) * chunk;
+        std::memcpy(replica_parameters[t / n_chunks] + off, parameters + off,\
+                    std::min(chunk, n_parameters - off) * sizeof(float));
+    });
+}
+
+void NeuralNetwork::refresh_bf16(){
+    if (parameters_bf16 == nullptr) return;
+    size_t n_chunks = (n_parameters + chunk - 1) / chunk;
+    get_pool().run_static(n_chunks, [&](size_t c){
+        size_t off = c * chunk;
+        Kernels::to_bf16(std::min(chunk, n_parameters - off), \
+                                parameters + off, parameters_bf16 + off);
+    });
+}
+
+int NeuralNetwork::prune(float threshold){
+    if (sizes.size() < 2) {
+        std::cerr << "Error: Need at least 2 layers to prune." << std::endl;
+        return 0;
+    }
+    build();
+    for (size_t l = 1; l < layers.size(); l++){
+        layers[l]->prune(threshold);
+    }
+    pruned = true;
+    refresh_sparsity();
+    return 1;
+}
+
+int NeuralNetwork::prune_top_k(size_t k){
+    if (sizes.size() < 2) {
+        std::cerr << "Error: Need at least 2 layers to prune." << std::endl;
+        return 0;
+    }
+    build();
+    for (size_t l = 1; l < layers.size(); l++){
+        layers[l]->prune_top_k(k);
+    }
+    pruned = true;
+    refresh_sparsity();
+    return 1;
+}
+
+void NeuralNetwork::refresh_sparsity(){
+    if (!pruned) return;
+    float crossover = Sparse::crossover_density();
+    auto update = [&](const std::vector<Layer*>& net){
+        for (size_t l = 1; l < net.size(); l++){
+            Layer* layer = net[l];
+            size_t n = layer->getSize() * layer->getInputSize();
+            if (Sparse::density(layer->getWeights(), n) < 1.0f) {
+                layer->setMaskFromWeights();
+            }
+            layer->setSparseKernels(layer->getDensity() < crossover);
+        }
+    };
+    update(layers);
+    for (const std::vector<Layer*>& replica : replicas){
+        update(replica);
+    }
+    // a momentum or moment left from before the pruning would move the
+    // pruned weights again
+    if (optimizer_state == nullptr) return;
+    for (size_t l = 1; l < layers.size(); l++){
+        const float* w = layers[l]->getWeights();
+        size_t off = w - parameters;
+        size_t n = layers[l]->getSize() * layers[l]->getInputSize();
+        for (size_t k = 0; k < built_state; k++){
+            float* state = optimizer_state + k * n_parameters + off;
+            for (size_t i = 0; i < n; i++){
+                if (w[i] == 0.0f) state[i] = 0.0f;
+            }
+        }
+    }
+}
+
+void NeuralNetwork::refresh_sparse_values(){
+    if (!pruned) return;
+    for (Layer* layer : layers){
+        if (layer->usesSparseKernels()) layer->refreshSparseValues();
+    }
+    for (const std::vector<Layer*>& replica : replicas){
+        for (Layer* layer : replica){
+            if (layer->usesSparseKernels()) layer->refreshSparseValues();
+        }
+    }
+}
+
+void NeuralNetwork::delete_layers(){
+    for (Layer* layer : layers){
+        delete layer;
+    }
+    layers.clear();
+    for (std::vector<Layer*>& replica : replicas){
+        for (Layer* layer : replica){
+            delete layer;
+        }
+    }
+    replicas.clear();
+}
+
+void NeuralNetwork::set_placement(Placement placement){
+    this->placement = placement;
+}
+
+void NeuralNetwork::set_precision(Kernels::Precision precision){
+    this->precision = precision;
+}
+
+double NeuralNetwork::remote_access_fraction(){
+    prepare_training();
+    std::vector<double> remote(workspaces.size(), 0.0);
+    pool->run_static(workspaces.size(), [&](size_t w){
+        const Workspace& ws = workspaces[w];
+        size_t node = Numa::current_node();
+        const float* params = replicas.empty() ? parameters : \
+            replica_parameters[std::min(ws.node, replicas.size() - 1)];
+        double param_bytes = n_parameters * sizeof(float);
+        double ws_bytes = ws.memory_size * sizeof(float);
+        remote[w] = (Numa::remote_fraction(params, param_bytes, node) * \
+            param_bytes + Numa::remote_fraction(ws.memory, ws_bytes, node) \
+                                    * ws_bytes) / (param_bytes + ws_bytes);
+    });
+    double total = 0.0;
+    for (double r : remote) total += r;
+    return remote.empty() ? 0.0 : total / remote.size();
+}
+
+float* NeuralNetwork::getParameters(){
+    build();
+    return parameters;
+}
+
+size_t NeuralNetwork::getParameterSize(){
+    build();
+    return n_parameters;
+}
+
+int NeuralNetwork::export_model(InferenceModel& model){
+    build();
+    return model.load(sizes, activations, parameters);
+}
+
+int NeuralNetwork::quantize_model(QuantizedModel& model, size_t n_samples){
+    size_t rows = data.getRows(), cols = data.getCols();
+    if (rows == 0 || cols != sizes[0]) {
+        std::cerr << "Error: Need loaded data matching the input layer to " \
+                                                "quantize." << std::endl;
+        return 0;
+    }
+    build();
+    n_samples = std::min(n_samples, rows);
+    std::vector<float> calibration(n_samples * cols);
+    const uint8_t* features = data.getFeatures();
+    for (size_t s = 0; s < n_samples; s++){
+        // every (rows/n_samples)th row, so all of the data is represented
+        const uint8_t* row = features + (s * rows / n_samples) * cols;
+        for (size_t j = 0; j < cols; j++){
+            calibration[s * cols + j] = row[j] / 255.0f;
+        }
+    }
+    return model.quantize(sizes, activations, parameters, calibration.data(),\
+                                                                n_samples);
+}
+
+int NeuralNetwork::save_checkpoint(std::string file_name){
+    build();
+    return Checkpoint::save(file_name, sizes, activations, parameters, \
+                                            n_parameters, epochs_trained);
+}
+
+int NeuralNetwork::load_checkpoint(std::string file_name){
+    Checkpoint checkpoint;
+    if (!checkpoint.open(file_name)) return 0;
+    // checked before anything is replaced, a bad file leaves the network
+    // as it was
+    const std::vector<size_t>& loaded = checkpoint.getSizes();
+    size_t expected = 0;
+    for (size_t l = 1; l < loaded.size(); l++){
+        expected += Arena::round_up(loaded[l] * loaded[l-1]) + \
+                                                Arena::round_up(loaded[l]);
+    }
+    if (loaded.size() < 2 || expected != checkpoint.getParameterSize()) {
+        std::cerr << "Error: " << file_name << " does not match its layers."\
+                                                                << std::endl;
+        return 0;
+    }
+    sizes = loaded;
+    activations = checkpoint.getActivations();
+    // start from a fresh arena, nothing of the old topology is kept
+    delete_layers();
+    parameters = nullptr;
+    build();
+    // the state was zeroed with the arena, the bias correction of Adam
+    // must start over with it
+    optimizer.reset();
+    std::memcpy(parameters, checkpoint.getParameters(), \
+                                        n_parameters * sizeof(float));
+    epochs_trained = checkpoint.getEpochs();
+    // the zeros of a pruned checkpoint are its masks, whether this network
+    // was pruned before or not
+    pruned = false;
+    for (size_t l = 1; l < layers.size(); l++){
+        size_t n = layers[l]->getSize() * layers[l]->getInputSize();
+        if (Sparse::density(layers[l]->getWeights(), n) < 1.0f) {
+            pruned = true;
+        }
+    }
+    refresh_sparsity();
+    return 1;
+}
+
+void NeuralNetwork::set_checkpointing(std::string file_name, size_t epochs){
+    checkpoint_file = file_name;
+    checkpoint_every = epochs;
+}
+
+int NeuralNetwork::set_validation(std::string file_name, size_t epochs){
+    validate_every = 0;
+    if (epochs == 0) return 1;
+    if (!validator.open(file_name, get_pool())) return 0;
+    validate_every = epochs;
+    return 1;
+}
+
+void NeuralNetwork::set_early_stopping(size_t patience, \
+                                            std::string best_checkpoint){
+    this->patience = patience;
+    validator.set_best_checkpoint(best_checkpoint);
+}
+
+const std::vector<ValidationResult>& \
+                            NeuralNetwork::getValidationHistory() const {
+    return validation_history;
+}
+
+bool NeuralNetwork::end_epoch(){
+    epochs_trained += 1;
+    NN_PROFILE_REPORT(epochs_trained - 1);
+    if (checkpoint_every != 0 && epochs_trained % checkpoint_every == 0) {
+        checkpoint_writer.start(checkpoint_file);
+        checkpoint_writer.submit(sizes, activations, parameters, \
+                                            n_parameters, epochs_trained);
+    }
+    if (validate_every != 0 && epochs_trained % validate_every == 0) {
+        if (validator.getCols() == sizes.front()) {
+            // waits for the previous validation if it is not done yet
+            validator.submit(sizes, activations, cost, parameters, \
+                                            n_parameters, epochs_trained);
+        } else {
+            std::cerr << "Error: Input layer size does not match the " \
+                                    "validation data." << std::endl;
+            validate_every = 0;
+        }
+    }
+    collect_validations();
+    if (patience == 0 || stale_validations < patience) return true;
+    std::cout << "Early stopping: no better validation loss in the last " \
+                                << patience << " validations" << std::endl;
+    return false;
+}
+
+void NeuralNetwork::collect_validations(){
+    size_t first = validation_history.size();
+    validator.take_results(validation_history);
+    for (size_t i = first; i < validation_history.size(); i++){
+        const ValidationResult& result = validation_history[i];
+        std::cout << "Validation after " << result.epochs << \
+            " epochs: loss " << result.loss << ", accuracy " << \
+            result.accuracy << " (" << result.seconds << " s)" << std::endl;
+        if (result.loss < best_validation_loss) {
+            best_validation_loss = result.loss;
+            stale_validations = 0;
+        } else {
+            stale_validations += 1;
+        }
+    }
+}
+
+void NeuralNetwork::end_training(){
+    checkpoint_writer.stop();
+    validator.stop();
+    collect_validations();
+}
+
 int NeuralNetwork::read_input(std::string file_name){
-    std::ifstream input_file(file_name); 
-    std::string line;
-    if (!input_file.is_open()) {
+    NN_PROFILE_SCOPE("read_input", 0, 0, 0, 0);
+    std::vector<uint8_t> features, targets;
+    size_t n_features = 0;
+    long skipped = CsvParser::parse(file_name, get_pool(), features, \
+                                                    targets, n_features);
+    NN_PROFILE_WORK(0, features.size() + targets.size());
+    if (skipped < 0) {
         std::cerr << "Error: Could not open the file." << std::endl;
-        return 1;
+        return 0;
+    }
+    if (skipped > 0) {
+        std::cerr << "Skipped " << skipped << " invalid rows" << std::endl;
+    }
+    return data.assign(std::move(features), std::move(targets), n_features);
+}
+
+int NeuralNetwork::read_binary(std::string file_name){
+    return data.open_binary(file_name);
+}
+
+int NeuralNetwork::save_input(std::string file_name){
+    return data.save_binary(file_name);
+}
+
+void NeuralNetwork::display_input(size_t size){
+    size = std::min(size, data.getRows());
+    for (size_t i = 0; i < size; i++){
+        std::cout<<"Target at "<< i << ": "<< (int)data.getLabel(i)<<std::endl; 
+        for (size_t j = 0; j < std::min<size_t>(50, data.getCols()); j++){
+            std::cout<<"Pixel at "<<j<<": "<< (int)data.getRow(i)[j]<<std::endl;
+        }
+    }
+}
+
+int NeuralNetwork::set_data(std::vector<uint8_t> features, \
+                            std::vector<uint8_t> targets, size_t n_features){
+    return data.assign(std::move(features), std::move(targets), n_features);
+}
+
+void NeuralNetwork::set_batch_size(size_t size){
+    batch_size = std::max<size_t>(size, 1);
+}
+
+void NeuralNetwork::set_threads(size_t threads, bool pin){
+    n_threads = threads;
+    pin_threads = pin;
+    pool.reset();
+}
+
+void NeuralNetwork::set_optimizer(const OptimizerConfig& config){
+    optimizer = Optimizer(config);
+    if (optimizer_state != nullptr) {
+        std::fill(optimizer_state, optimizer_state + \
+                                built_state * n_parameters, 0.0f);
     }
+}
+
+ThreadPool& NeuralNetwork::get_pool(){
+    if (!pool) pool.reset(new ThreadPool(n_threads, pin_threads, first_core));
+    return *pool;
+}
 
-    std::getline(input_file, line); //ignore the header line
-    while (std::getline(input_file, line)) {
-        std::stringstream ss(line);
-        std::string field;
-        std::vector<int> current_row_inputs;
-        bool is_first_column = true;
+void NeuralNetwork::prepare_training(){
+    build();
+    // the parameters may have been changed since (load_checkpoint...)
+    refresh_replicas();
+    refresh_bf16();
+    refresh_sparsity();
+    compile_schedule(false);
+    // early stopping counts from the start of every training run
+    stale_validations = 0;
+    best_validation_loss = std::numeric_limits<float>::infinity();
+    validator.reset();
+}
 
-        // Split line by comma
-        while (std::getline(ss, field, ',')) {
-            try {
-                int value = std::stoi(field); // Convert string to integer
+void NeuralNetwork::compile_schedule(bool in_place){
+    // with Precision::BF16 the passes read the inputs of every layer and
+    // the weights in bf16, the bf16 copy would go stale with updates in
+    // place. The sparse kernels are fp32 only.
+    bool mixed = parameters_bf16 != nullptr && !in_place;
+    size_t out = layers.size() - 1;
+    auto sparse = [&](size_t l){ return layers[l]->usesSparseKernels(); };
+    schedule.clear();
+    schedule.push_back({StepOp::LOAD_INPUT, 0});
+    if (mixed) schedule.push_back({StepOp::TO_BF16, 0});
+    // a softmax output trained on cross entropy gets its forward pass, loss
+    // and delta from one fused pass over the logits (see Layer.h)
+    bool fused = cost == Cost::CROSS_ENTROPY && \
+                        layers[out]->getActivation() == Activation::SOFTMAX;
+    for (size_t l = 1; l < out; l++){
+        bool bf16 = mixed && !sparse(l);
+        schedule.push_back({bf16 ? StepOp::FORWARD_BF16 : StepOp::FORWARD, l});
+        if (mixed) schedule.push_back({StepOp::TO_BF16, l});
+    }
+    bool bf16 = mixed && !sparse(out);
+    if (fused) {
+        schedule.push_back({bf16 ? StepOp::CROSS_ENTROPY_BF16 : \
+                                            StepOp::CROSS_ENTROPY, out});
+    } else {
+        schedule.push_back({bf16 ? StepOp::FORWARD_BF16 : \
+                                            StepOp::FORWARD, out});
+        schedule.push_back({StepOp::LOSS, out});
+    }
+    // The delta of the layer below needs the weights before their update
+    // in place, and once the gradients are taken the delta of the layer is
+    // dead, so build can give its memory to later buffers
+    for (size_t l = out; l >= 1; l--){
+        if (l > 1) {
+            schedule.push_back({mixed && !sparse(l) ? \
+                StepOp::HIDDEN_DELTA_BF16 : StepOp::HIDDEN_DELTA, l - 1});
+        }
+        StepOp gradient = StepOp::GRADIENT;
+        if (in_place) {
+            gradient = StepOp::GRADIENT_IN_PLACE;
+        } else if (mixed && !layers[l]->isPruned()) {
+            gradient = StepOp::GRADIENT_BF16;
+        }
+        schedule.push_back({gradient, l});
+    }
+
+    // Slices small enough to spread the reduction over all the threads
+    reduce_tasks.clear();
+    for (size_t l = 1; l < layers.size(); l++){
+        size_t n_weights = layers[l]->getSize() * layers[l]->getInputSize();
+        for (size_t off = 0; off < n_weights; off += chunk){
+            reduce_tasks.push_back({l, false, off, \
+                                        std::min(chunk, n_weights - off)});
+        }
+        reduce_tasks.push_back({l, true, 0, layers[l]->getSize()});
+    }
+}
 
-                if (is_first_column) {
-                    targets.push_back(value); // First column is target
-                    is_first_column = false;
+void NeuralNetwork::train_shard(Workspace& ws, const BatchInput& batch, \
+                        size_t first, size_t count, float update_scale){
+    // the layers reading the parameters on the node of this thread, but
+    // updates in place must go to the parameters themselves
+    const std::vector<Layer*>& net = replicas.empty() || \
+        update_scale != 0.0f ? layers : \
+        replicas[std::min(ws.node, replicas.size() - 1)];
+    std::vector<Kernels::bf16*>& x16 = ws.activations_bf16;
+    size_t out = net.size() - 1;
+    size_t n_inputs = net[0]->getSize();
+    const float* x = batch.features != nullptr ? \
+                    batch.features + first * n_inputs : ws.activations[0];
+    const uint8_t* labels = batch.labels + first;
+    float* y = ws.activations[out];
+    float* grad = ws.deltas[out];
+    for (const Step& step : schedule){
+        size_t l = step.layer;
+        const float* input = l <= 1 ? x : ws.activations[l-1];
+        switch (step.op){
+            case StepOp::LOAD_INPUT: {
+                if (batch.features != nullptr) break;
+                const uint8_t* rows = batch.pixels + first * n_inputs;
+                NN_PROFILE_SCOPE("load_batch", n_inputs, 0, \
+                    count * n_inputs, count * n_inputs * (1 + sizeof(float)));
+                for (size_t j = 0; j < count * n_inputs; j++){
+                    ws.activations[0][j] = rows[j] / 255.0f;
+                }
+                break;
+            }
+            case StepOp::TO_BF16:
+                Kernels::to_bf16(count * net[l]->getSize(), \
+                                    l == 0 ? x : ws.activations[l], x16[l]);
+                break;
+            case StepOp::FORWARD:
+                net[l]->forward(input, ws.activations[l], count);
+                break;
+            case StepOp::FORWARD_BF16:
+                net[l]->forward_bf16(x16[l-1], ws.activations[l], count);
+                break;
+            case StepOp::CROSS_ENTROPY:
+                ws.loss = net[l]->forward_cross_entropy(input, labels, y, \
+                                                            grad, count);
+                break;
+            case StepOp::CROSS_ENTROPY_BF16:
+                ws.loss = net[l]->forward_cross_entropy_bf16(x16[l-1], \
+                                                labels, y, grad, count);
+                break;
+            case StepOp::LOSS:
+                ws.loss = output_loss(*net[l], cost, y, labels, grad, count);
+                break;
+            case StepOp::HIDDEN_DELTA:
+                net[l]->hidden_delta(*net[l+1], ws.deltas[l+1], \
+                                    ws.activations[l], ws.deltas[l], count);
+                break;
+            case StepOp::HIDDEN_DELTA_BF16:
+                net[l]->hidden_delta_bf16(*net[l+1], ws.deltas[l+1], \
+                                    ws.activations[l], ws.deltas[l], count);
+                break;
+            case StepOp::GRADIENT_IN_PLACE:
+                // W += scale * dW without ever storing dW
+                net[l]->accumulate_gradient(ws.deltas[l], input, count, \
+                    update_scale, net[l]->getWeights(), net[l]->getBias());
+                break;
+            case StepOp::GRADIENT:
+            case StepOp::GRADIENT_BF16: {
+                size_t size = net[l]->getSize();
+                std::fill(ws.grad_weights[l], ws.grad_weights[l] + \
+                                    size * net[l]->getInputSize(), 0.0f);
+                std::fill(ws.grad_bias[l], ws.grad_bias[l] + size, 0.0f);
+                if (step.op == StepOp::GRADIENT_BF16) {
+                    net[l]->accumulate_gradient_bf16(ws.deltas[l], \
+                        x16[l-1], count, 1.0f, ws.grad_weights[l], \
+                                                        ws.grad_bias[l]);
                 } else {
-                    current_row_inputs.push_back(value); // Others are inputs
+                    net[l]->accumulate_gradient(ws.deltas[l], input, count,\
+                                1.0f, ws.grad_weights[l], ws.grad_bias[l]);
                 }
-            } catch (const std::exception& e) {
-                // Skip headers or invalid numeric strings
-                continue; 
+                break;
             }
         }
-        
-        if (!current_row_inputs.empty()) {
-            inputs.push_back(current_row_inputs);
+    }
+}
+
+void NeuralNetwork::reduce_gradients(size_t n_shards){
+    NN_PROFILE_SCOPE("reduce_gradients", n_parameters, 0, \
+            n_shards * n_parameters, \
+            (n_shards + 2) * n_parameters * sizeof(float));
+    pool->run_static(reduce_tasks.size(), [&](size_t t){
+        const ReduceTask& task = reduce_tasks[t];
+        Layer* layer = layers[task.layer];
+        float* dst = task.is_bias ? layer->getGradBias() : \
+                                layer->getGradWeights() + task.offset;
+        // always summed in shard order so the result is reproducible
+        for (size_t w = 0; w < n_shards; w++){
+            const float* grad = task.is_bias ? \
+                workspaces[w].grad_bias[task.layer] : \
+                workspaces[w].grad_weights[task.layer] + task.offset;
+            Kernels::axpy(task.size, 1.0f, grad, dst);
         }
+    });
+}
+
+void NeuralNetwork::apply_gradients(size_t batch){
+    // The gradients and the state have the same layout as the parameters,
+    // so the update is one streaming pass over the blocks, whatever the
+    // layers are
+    // memory bound, the bytes are what matters: the parameters, the
+    // gradients and the state are all read and written once, and the bf16
+    // copy written
+    NN_PROFILE_SCOPE("optimizer", n_parameters, 0, 0, \
+        2 * (2 + optimizer.getStateCount()) * n_parameters * sizeof(float) + \
+        (parameters_bf16 ? n_parameters * sizeof(Kernels::bf16) : 0));
+    optimizer.begin_step(1.0f / batch);
+    size_t n_chunks = (n_parameters + chunk - 1) / chunk;
+    pool->run_static(n_chunks, [&](size_t c){
+        size_t off = c * chunk;
+        float* state = optimizer_state ? optimizer_state + off : nullptr;
+        size_t len = std::min(chunk, n_parameters - off);
+        optimizer.update(len, parameters + off, gradients + off, state, \
+                                                            n_parameters);
+        // rounded while the chunk is still in cache
+        if (parameters_bf16 != nullptr) {
+            Kernels::to_bf16(len, parameters + off, parameters_bf16 + off);
+        }
+    });
+    refresh_replicas();
+    refresh_sparse_values();
+}
+
+float NeuralNetwork::compute_gradients(const BatchInput& batch){
+    size_t n_shards = std::min(workspaces.size(), batch.rows);
+    size_t shard_size = (batch.rows + n_shards - 1) / n_shards;
+    n_shards = (batch.rows + shard_size - 1) / shard_size; // none empty
+    auto shard = [&](size_t w){
+        size_t first = w * shard_size;
+        train_shard(workspaces[w], batch, first, \
+                                    std::min(shard_size, batch.rows - first));
+    };
+    // too many captures for the small buffer of std::function, through a
+    // reference it does not allocate at every step
+    pool->run_static(n_shards, std::ref(shard));
+    float loss = 0.0f;
+    for (size_t w = 0; w < n_shards; w++){
+        loss += workspaces[w].loss;
     }
-    return 1;
+    reduce_gradients(n_shards);
+    return loss;
 }
 
-void NeuralNetwork::display_input(size_t size){
-    for (size_t i = 0; i < size; i++){
-        std::cout<<"Target at "<< i << ": "<< targets.at(i)<<std::endl; 
-        for (size_t j = 0; j < 50; j++){
-            std::cout<<"Pixel at "<<j<<": "<< inputs.at(i).at(j)<<std::endl;
+float NeuralNetwork::train_batch(const BatchInput& batch){
+    float loss = compute_gradients(batch);
+    apply_gradients(batch.rows);
+    return loss;
+}
+
+void NeuralNetwork::setup_pipeline(size_t n_stages, size_t micro_size, \
+                                                            size_t n_micro){
+    size_t n_layers = sizes.size();
+    // the passes of a layer cost about its number of weights
+    std::vector<size_t> costs;
+    for (size_t l = 1; l < n_layers; l++){
+        costs.push_back(sizes[l] * sizes[l-1] + sizes[l]);
+    }
+    std::vector<size_t> ranges = Pipeline::partition(costs, n_stages);
+    pipeline.clear();
+    pipeline_stats = PipelineStats();
+    pipeline_stats.micro_batches = n_micro;
+    pipeline_stats.ideal_bubble = (double)(n_stages - 1) / \
+                                                (n_micro + n_stages - 1);
+    for (size_t s = 0; s < n_stages; s++){
+        std::unique_ptr<PipelineStage> stage(new PipelineStage());
+        size_t first = ranges[s] + 1, last = ranges[s+1] + 1;
+        stage->first = first;
+        stage->last = last;
+        size_t n_slots = Pipeline::in_flight(pipeline_schedule, s, \
+                                                        n_stages, n_micro);
+        size_t slot_floats = first == 1 ? \
+                                Arena::round_up(micro_size * sizes[0]) : 0;
+        for (size_t l = first; l < last; l++){
+            slot_floats += 2 * Arena::round_up(micro_size * sizes[l]);
+        }
+        stage->memory.reserve(n_slots * slot_floats);
+        stage->slots.assign(n_slots, PipelineSlot());
+        for (PipelineSlot& slot : stage->slots){
+            // the input of the other stages comes with every micro-batch
+            slot.activations.assign(last - first + 1, nullptr);
+            slot.deltas.assign(last - first + 1, nullptr);
+            if (first == 1) {
+                slot.activations[0] = stage->memory.take(micro_size * \
+                                                                sizes[0]);
+            }
+            for (size_t l = first; l < last; l++){
+                size_t floats = micro_size * sizes[l];
+                slot.activations[l - first + 1] = stage->memory.take(floats);
+                slot.deltas[l - first + 1] = stage->memory.take(floats);
+            }
+        }
+        // every message of the batch fits, so a push never waits
+        stage->inbox.reset(n_micro);
+        stage->returns.reset(n_micro);
+        size_t end = last < n_layers ? \
+                    layers[last]->getWeights() - parameters : n_parameters;
+        size_t params = end - (layers[first]->getWeights() - parameters);
+        PipelineStageStats stats = {first, last, \
+            (2 + built_state) * params * sizeof(float), \
+                        n_slots * slot_floats * sizeof(float), 0.0, 0.0};
+        pipeline_stats.stages.push_back(stats);
+        pipeline.push_back(std::move(stage));
+    }
+    // stage s always runs on thread s (run_static), which touches its
+    // slots first so they land on its node
+    pool->run_static(n_stages, [&](size_t s){
+        Arena& memory = pipeline[s]->memory;
+        std::memset(memory.data(), 0, memory.size() * sizeof(float));
+    });
+}
+
+void NeuralNetwork::run_stage(size_t s, const BatchInput& batch, \
+                                        size_t micro_size, size_t n_micro){
+    auto start = std::chrono::steady_clock::now();
+    PipelineStage& stage = *pipeline[s];
+    PipelineStage* prev = s > 0 ? pipeline[s-1].get() : nullptr;
+    PipelineStage* next = s + 1 < pipeline.size() ? \
+                                                pipeline[s+1].get() : nullptr;
+    size_t first = stage.first, last = stage.last;
+    size_t out = layers.size() - 1;
+    bool fused = cost == Cost::CROSS_ENTROPY && \
+                        layers[out]->getActivation() == Activation::SOFTMAX;
+    double waited = 0.0;
+    // the time spent spinning on an empty queue is the bubble
+    auto receive = [&](SpscQueue<PipelineMessage>& queue, \
+                                                PipelineMessage& message){
+        if (queue.try_pop(message)) return;
+        auto begin = std::chrono::steady_clock::now();
+        queue.pop(message);
+        waited += std::chrono::duration<double>( \
+                            std::chrono::steady_clock::now() - begin).count();
+    };
+    stage.loss = 0.0f;
+    for (size_t i = 0; i < 2 * n_micro; i++){
+        Pipeline::Op op = Pipeline::op_at(pipeline_schedule, s, \
+                                            pipeline.size(), n_micro, i);
+        PipelineSlot& slot = stage.slots[op.micro % stage.slots.size()];
+        std::vector<float*>& a = slot.activations;
+        std::vector<float*>& d = slot.deltas;
+        size_t row = op.micro * micro_size;
+        size_t count = std::min(micro_size, batch.rows - row);
+        PipelineMessage message;
+        if (op.forward) {
+            if (prev == nullptr) {
+                size_t n_inputs = sizes[0];
+                const uint8_t* pixels = batch.pixels + row * n_inputs;
+                for (size_t j = 0; j < count * n_inputs; j++){
+                    a[0][j] = pixels[j] / 255.0f;
+                }
+            } else {
+                receive(stage.inbox, message);
+                a[0] = message.activations;
+                d[0] = message.delta;
+            }
+            for (size_t l = first; l < last; l++){
+                size_t k = l - first;
+                if (l < out) {
+                    layers[l]->forward(a[k], a[k+1], count);
+                } else if (fused) {
+                    stage.loss += layers[l]->forward_cross_entropy(a[k], \
+                                batch.labels + row, a[k+1], d[k+1], count);
+                } else {
+                    layers[l]->forward(a[k], a[k+1], count);
+                    stage.loss += output_loss(*layers[l], cost, a[k+1], \
+                                    batch.labels + row, d[k+1], count);
+                }
+            }
+            if (next != nullptr) {
+                next->inbox.push({op.micro, a.back(), d.back()});
+            }
+        } else {
+            // the next stage has written the delta of the last layer
+            if (next != nullptr) receive(stage.returns, message);
+            for (size_t l = last - 1; l >= first; l--){
+                size_t k = l - first;
+                // below the first layer, the delta goes to the memory of
+                // the previous stage, which never reads these weights
+                if (l > first || prev != nullptr) {
+                    layers[l-1]->hidden_delta(*layers[l], d[k+1], a[k], \
+                                                            d[k], count);
+                }
+                layers[l]->accumulate_gradient(d[k+1], a[k], count, 1.0f, \
+                        layers[l]->getGradWeights(), layers[l]->getGradBias());
+            }
+            // only now, the previous stage reuses the input once it gets
+            // the message
+            if (prev != nullptr) prev->returns.push({op.micro});
+        }
+    }
+    // The parameters of the stage are one range of the block, updated
+    // by this thread only, so they never leave its caches
+    size_t offset = layers[first]->getWeights() - parameters;
+    size_t end = last < layers.size() ? \
+                    layers[last]->getWeights() - parameters : n_parameters;
+    float* state = optimizer_state ? optimizer_state + offset : nullptr;
+    optimizer.update(end - offset, parameters + offset, gradients + offset, \
+                                                        state, n_parameters);
+    if (parameters_bf16 != nullptr) {
+        Kernels::to_bf16(end - offset, parameters + offset, \
+                                                parameters_bf16 + offset);
+    }
+    for (size_t l = first; l < last; l++){
+        if (layers[l]->usesSparseKernels()) layers[l]->refreshSparseValues();
+    }
+    stage.busy += std::chrono::duration<double>( \
+                std::chrono::steady_clock::now() - start).count() - waited;
+    stage.waited += waited;
+}
+
+bool NeuralNetwork::can_train(size_t n_samples, size_t n_features){
+    if (sizes.size() < 2 || n_samples == 0) {
+        std::cerr << "Error: Need at least 2 layers and some data to train."\
+                                                                << std::endl;
+        return false;
+    }
+    if (n_features != sizes[0]) {
+        std::cerr << "Error: Input layer size does not match the data." \
+                                                                << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void NeuralNetwork::train(size_t epochs){
+    if (!can_train(data.getRows(), data.getCols())) return;
+    prepare_training();
+    size_t n_samples = data.getRows();
+    for (size_t epoch = 0; epoch < epochs; epoch++){
+        float total_loss = 0.0f;
+        for (size_t start = 0; start < n_samples; start += batch_size){
+            BatchInput batch = {nullptr, data.getRow(start), \
+                                data.getLabels() + start, \
+                                std::min(batch_size, n_samples - start)};
+            total_loss += train_batch(batch);
+        }
+        std::cout << "Epoch " << epoch << ": loss " << \
+                                    total_loss / n_samples << std::endl;
+        if (!end_epoch()) break;
+    }
+    end_training();
+}
+
+void NeuralNetwork::train_hogwild(size_t epochs){
+    if (!can_train(data.getRows(), data.getCols())) return;
+    if (optimizer.getConfig().type != OptimizerType::SGD) {
+        std::cerr << "Error: Hogwild training only supports SGD." << \
+                                                                std::endl;
+        return;
+    }
+    prepare_training();
+    // the updates in place would leave the CSR copies stale, the pruned
+    // layers keep their mask but read the dense weights
+    for (Layer* layer : layers){
+        layer->setSparseKernels(false);
+    }
+    compile_schedule(true);
+    size_t n_samples = data.getRows();
+    size_t step = built_shard_size;
+    float learning_rate = optimizer.getConfig().learning_rate;
+    BatchInput all = {nullptr, data.getFeatures(), data.getLabels(), \
+                                                                n_samples};
+    for (size_t epoch = 0; epoch < epochs; epoch++){
+        std::atomic<size_t> next{0};
+        std::vector<float> losses(workspaces.size(), 0.0f);
+        pool->run_static(workspaces.size(), [&](size_t w){
+            Workspace& ws = workspaces[w];
+            size_t first;
+            while ((first = next.fetch_add(step, std::memory_order_relaxed))\
+                                                                < n_samples){
+                size_t count = std::min(step, n_samples - first);
+                // Racy on purpose: other threads read and write the same
+                // weights at the same time
+                train_shard(ws, all, first, count, -learning_rate / count);
+                losses[w] += ws.loss;
+            }
+        });
+        float total_loss = 0.0f;
+        for (float loss : losses) total_loss += loss;
+        std::cout << "Epoch " << epoch << ": loss " << \
+                                    total_loss / n_samples << std::endl;
+        if (!end_epoch()) break;
+    }
+    end_training();
+}
+
+void NeuralNetwork::train_processes(size_t epochs, size_t n_processes){
+    if (!can_train(data.getRows(), data.getCols())) return;
+    n_processes = std::max<size_t>(n_processes, 1);
+    size_t shard_rows = data.getRows() / n_processes;
+    if (shard_rows == 0) {
+        std::cerr << "Error: Fewer samples than processes." << std::endl;
+        return;
+    }
+    // the replicas start from the same parameters
+    prepare_training();
+    RingAllReduce ring;
+    std::string name = "/nn_ring_" + std::to_string(getpid());
+    if (!ring.create(name, n_processes, n_parameters)) return;
+    // threads do not survive a fork, every process starts its own pool
+    size_t pool_size = pool->size();
+    pool.reset();
+    std::cout.flush();
+    size_t rank = 0;
+    std::vector<pid_t> children;
+    for (size_t r = 1; r < n_processes; r++){
+        pid_t pid = fork();
+        if (pid == 0) {
+            rank = r;
+            children.clear();
+            break;
+        }
+        if (pid < 0) {
+            // the others would wait forever for the missing rank
+            std::cerr << "Error: Could not start process " << r << std::endl;
+            for (pid_t child : children){
+                kill(child, SIGKILL);
+                waitpid(child, nullptr, 0);
+            }
+            return;
+        }
+        children.push_back(pid);
+    }
+    ring.set_rank(rank);
+    first_core = rank * pool_size;
+    get_pool();
+
+    size_t first_row = rank * shard_rows;
+    size_t local_batch = std::max<size_t>(batch_size / n_processes, 1);
+    for (size_t epoch = 0; epoch < epochs; epoch++){
+        float total_loss = 0.0f;
+        for (size_t start = 0; start < shard_rows; start += local_batch){
+            size_t row = first_row + start;
+            size_t rows = std::min(local_batch, shard_rows - start);
+            BatchInput batch = {nullptr, data.getRow(row), \
+                                            data.getLabels() + row, rows};
+            total_loss += compute_gradients(batch);
+            ring.all_reduce(gradients, n_parameters);
+            // every process has the same number of rows in this step
+            apply_gradients(rows * n_processes);
+        }
+        ring.all_reduce(&total_loss, 1);
+        float stop = 0.0f;
+        if (rank == 0) {
+            std::cout << "Epoch " << epoch << ": loss " << \
+                    total_loss / (shard_rows * n_processes) << std::endl;
+            stop = end_epoch() ? 0.0f : 1.0f;
+        }
+        // every process has to leave the loop at the same epoch
+        ring.all_reduce(&stop, 1);
+        if (stop != 0.0f) break;
+    }
+    if (rank != 0) {
+        std::cout.flush();
+        _exit(0);
+    }
+    for (pid_t child : children){
+        waitpid(child, nullptr, 0);
+    }
+    first_core = 0;
+    pool.reset();
+    end_training();
+}
+
+void NeuralNetwork::train_pipeline(size_t epochs, size_t n_stages, \
+                    size_t n_micro_batches, PipelineSchedule schedule){
+    if (!can_train(data.getRows(), data.getCols())) return;
+    if (n_stages == 0 || n_stages >= sizes.size()) {
+        std::cerr << "Error: Need between 1 and " << sizes.size() - 1 << \
+                    " stages, one per layer after the input at most." << \
+                                                                std::endl;
+        return;
+    }
+    if (get_pool().size() < n_stages) {
+        std::cerr << "Error: Need a thread per stage (set_threads)." << \
+                                                                std::endl;
+        return;
+    }
+    prepare_training();
+    // micro-batches of the same size, but for the last one
+    size_t n_micro = std::min(std::max<size_t>(n_micro_batches, 1), \
+                                                                batch_size);
+    size_t micro_size = (batch_size + n_micro - 1) / n_micro;
+    n_micro = (batch_size + micro_size - 1) / micro_size;
+    pipeline_schedule = schedule;
+    setup_pipeline(n_stages, micro_size, n_micro);
+    for (size_t s = 0; s < n_stages; s++){
+        const PipelineStageStats& stats = pipeline_stats.stages[s];
+        std::cout << "Stage " << s << ": layers " << stats.first_layer << \
+            "-" << stats.last_layer - 1 << ", " << \
+            stats.parameter_bytes / 1024.0 << " KB of parameters, " << \
+            stats.activation_bytes / 1024.0 << " KB of activations" << \
+                                                                std::endl;
+    }
+    size_t n_samples = data.getRows();
+    for (size_t epoch = 0; epoch < epochs; epoch++){
+        for (auto& stage : pipeline){
+            stage->busy = 0.0;
+            stage->waited = 0.0;
         }
+        auto start = std::chrono::steady_clock::now();
+        float total_loss = 0.0f;
+        for (size_t first = 0; first < n_samples; first += batch_size){
+            BatchInput batch = {nullptr, data.getRow(first), \
+                                data.getLabels() + first, \
+                                std::min(batch_size, n_samples - first)};
+            size_t m = (batch.rows + micro_size - 1) / micro_size;
+            optimizer.begin_step(1.0f / batch.rows);
+            auto stage = [&](size_t s){
+                run_stage(s, batch, micro_size, m);
+            };
+            // the end of the run is the flush of the pipeline, the next
+            // batch starts from the updated parameters
+            pool->run_static(n_stages, std::ref(stage));
+            total_loss += pipeline.back()->loss;
+        }
+        double seconds = std::chrono::duration<double>( \
+                            std::chrono::steady_clock::now() - start).count();
+        double busy = 0.0;
+        for (size_t s = 0; s < n_stages; s++){
+            pipeline_stats.stages[s].busy = pipeline[s]->busy;
+            pipeline_stats.stages[s].waited = pipeline[s]->waited;
+            busy += pipeline[s]->busy;
+        }
+        pipeline_stats.seconds = seconds;
+        pipeline_stats.samples_per_second = n_samples / seconds;
+        // waits, the flush at the end of every batch and the wake ups
+        pipeline_stats.bubble = 1.0 - busy / (n_stages * seconds);
+        std::cout << "Epoch " << epoch << ": loss " << \
+            total_loss / n_samples << ", " << \
+            pipeline_stats.samples_per_second << " samples/s, bubble " << \
+            100.0 * pipeline_stats.bubble << "% (" << \
+            100.0 * pipeline_stats.ideal_bubble << "% at best)" << std::endl;
+        if (!end_epoch()) break;
     }
+    // the passes read the main parameters only
+    refresh_replicas();
+    end_training();
+}
+
+const PipelineStats& NeuralNetwork::getPipelineStats() const {
+    return pipeline_stats;
 }
 
-void train(size_t epoch){
-    return;
+void NeuralNetwork::train_stream(std::string file_name, size_t epochs, \
+                                                        size_t n_buffers){
+    BatchStream stream;
+    if (!stream.open(file_name, batch_size, n_buffers)) return;
+    if (!can_train(stream.getRows(), stream.getCols())) return;
+    prepare_training();
+    stream.start(epochs);
+    for (size_t epoch = 0; epoch < epochs; epoch++){
+        auto start = std::chrono::steady_clock::now();
+        float total_loss = 0.0f;
+        BatchStream::Batch next;
+        while (stream.next(next)){
+            BatchInput batch = {next.features, nullptr, next.labels, \
+                                                                next.rows};
+            total_loss += train_batch(batch);
+            stream.release();
+        }
+        if (stream.has_failed()) {
+            std::cerr << "Error: Stopped training, the rest of the data " \
+                                        "could not be read." << std::endl;
+            break;
+        }
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+        double waited, loading;
+        stream.take_times(waited, loading);
+        // waited near 0 means the loads were fully hidden behind training
+        std::cout << "Epoch " << epoch << ": loss " << \
+            total_loss / stream.getRows() << ", waited on data " << \
+            waited << " s (" << 100.0 * waited / elapsed.count() << \
+            "% of the epoch), loader busy " << loading << " s" << std::endl;
+        if (!end_epoch()) break;
+    }
+    end_training();
 }
 
-size_t NeuralNetwork::number_layers = 0;
\ No newline at end of file
+NeuralNetwork::~NeuralNetwork(){
+    delete_layers();
+}
\ No newline at end of file
@@ -1,25 +1,578 @@
 #pragma once
 
+#include<cstdint>
 #include<cstring>
 #include<fstream>
+#include"Arena.h"
+#include"Checkpoint.h"
+#include"Dataset.h"
+#include"InferenceModel.h"
 #include"Layer.h"
+#include"Numa.h"
+#include"Optimizer.h"
+#include"Pipeline.h"
+#include"QuantizedModel.h"
+#include"SpscQueue.h"
+#include"StaticNetwork.h"
+#include"ThreadPool.h"
+#include"Validator.h"
+#include<memory>
 #include<vector>
 
 
 
 class NeuralNetwork{
-    float learning_rate;
-    static size_t number_layers;
-    std::ifstream train_fp, test_fp;
-    std::vector<Layer*> layers;
-    std::vector<int> targets;
-    std::vector<std::vector<int>> inputs;
+    Optimizer optimizer;
+    size_t batch_size = 32;
+    size_t n_threads = 0; // 0 is one thread per core
+    bool pin_threads = false;
+    size_t first_core = 0; // of the pinned threads
+    std::vector<size_t> sizes; // neurons of every layer, in order
+    std::vector<Activation> activations; // of every layer, same order
+    Cost cost = Cost::MSE;
+    std::vector<Layer*> layers; // made from sizes by build()
+    Dataset data;
+    std::unique_ptr<ThreadPool> pool;
+    size_t epochs_trained = 0;
+    // periodic checkpoints during training, off when checkpoint_every is 0
+    std::string checkpoint_file;
+    size_t checkpoint_every = 0;
+    CheckpointWriter checkpoint_writer;
+    // validation on a held-out set, off when validate_every is 0, and early
+    // stopping after patience validations without a better loss (0 is off)
+    Validator validator;
+    size_t validate_every = 0;
+    size_t patience = 0, stale_validations = 0;
+    float best_validation_loss = 0.0f;
+    std::vector<ValidationResult> validation_history;
+
+    // Holds, in this order: the weights and bias of every layer, their
+    // gradients and the state of the optimizer (both with the same layout),
+    // the neurons and delta of every layer and the workspaces. The first
+    // part is the parameters block.
+    Arena arena;
+    float* parameters = nullptr;
+    float* gradients = nullptr;
+    float* optimizer_state = nullptr; // getStateCount() blocks
+    size_t n_parameters = 0;
+    size_t built_shards = 0, built_shard_size = 0, built_state = 0;
+    Placement placement = Placement::LOCAL, built_placement = placement;
+    // Placement::REPLICATED: a copy of the parameters (in the arena) and
+    // layers reading it for every NUMA node, refreshed after every update
+    std::vector<float*> replica_parameters;
+    std::vector<std::vector<Layer*>> replicas;
+    // Precision::BF16: a bf16 copy of the parameters (in the arena, same
+    // layout) read by the training passes, refreshed after every update
+    Kernels::Precision precision = Kernels::Precision::FP32;
+    Kernels::Precision built_precision = precision;
+    Kernels::bf16* parameters_bf16 = nullptr;
+    // set by prune() and by load_checkpoint for a pruned checkpoint, the
+    // pruned weights are the ones that are 0
+    bool pruned = false;
+
+    // Everything one worker writes while training on its shard of a batch,
+    // one entry per layer (views into the arena). Layer 0 has no delta or
+    // gradients. The activations, their bf16 copies and the deltas share
+    // memory when they are not live at the same step of the schedule (see
+    // build), so a later delta may overwrite an earlier activation.
+    struct Workspace {
+        std::vector<float*> activations, deltas;
+        std::vector<float*> grad_weights, grad_bias;
+        // the activations as inputs of the next layer, with Precision::BF16
+        std::vector<Kernels::bf16*> activations_bf16;
+        float loss = 0.0f;
+        // all of the above is one run of pages, used by one thread
+        float* memory = nullptr;
+        size_t memory_size = 0;
+        size_t node = 0; // of the thread using it
+    };
+    std::vector<Workspace> workspaces;
+    // floats of one workspace, and what they would be without the reuse
+    size_t workspace_floats = 0, unshared_floats = 0;
+
+    // The passes of one shard as a flat list of steps, compiled once per
+    // training run by compile_schedule and replayed by train_shard
+    enum class StepOp {
+        LOAD_INPUT,         // pixels to floats, unless the batch has floats
+        TO_BF16,            // rounds the output of the layer for the next
+        FORWARD,            // gemm with the bias and activation as epilogue
+        FORWARD_BF16,       // the same on the bf16 input and weights
+        CROSS_ENTROPY,      // gemm, softmax, loss and output delta
+        CROSS_ENTROPY_BF16,
+        LOSS,               // loss gradient and output delta
+        HIDDEN_DELTA,       // delta of the layer from the one above
+        HIDDEN_DELTA_BF16,
+        GRADIENT,           // gradients of the layer to the workspace
+        GRADIENT_BF16,
+        GRADIENT_IN_PLACE   // added to the weights straight away (Hogwild)
+    };
+    struct Step {
+        StepOp op;
+        size_t layer;
+    };
+    std::vector<Step> schedule;
+
+    // A slice of the parameters of one layer summed by one reduction task
+    struct ReduceTask {
+        size_t layer;
+        bool is_bias;
+        size_t offset, size;
+    };
+    std::vector<ReduceTask> reduce_tasks;
+    // Floats summed or updated by one task
+    static constexpr size_t chunk = 16384;
+
+    // A batch either points at normalized features (streamed) or at the
+    // raw pixels of the loaded data, which the workers normalize themselves
+    struct BatchInput {
+        const float* features;
+        const uint8_t* pixels;
+        const uint8_t* labels;
+        size_t rows;
+    };
+
+    // Pipeline parallel training (train_pipeline): stage s runs a
+    // contiguous range of layers on thread s of the pool
+    struct PipelineMessage {
+        size_t micro = 0;
+        float* activations = nullptr; // output of the sending stage
+        float* delta = nullptr;       // where the next stage writes its delta
+    };
+    // The buffers of one micro-batch in flight in a stage. Entry 0 is the
+    // input of the stage and its delta (the output of the previous stage,
+    // in the memory of that stage), entry i the output and delta of the
+    // i-th layer of the stage.
+    struct PipelineSlot {
+        std::vector<float*> activations, deltas;
+    };
+    struct PipelineStage {
+        size_t first = 0, last = 0; // layers [first, last)
+        std::vector<PipelineSlot> slots;
+        Arena memory; // of the slots, first touched by the stage thread
+        // forward messages from the previous stage, backward messages
+        // from the next one
+        SpscQueue<PipelineMessage> inbox, returns;
+        float loss = 0.0f; // of the batch, last stage only
+        double busy = 0.0, waited = 0.0;
+    };
+    std::vector<std::unique_ptr<PipelineStage>> pipeline;
+    PipelineSchedule pipeline_schedule = PipelineSchedule::ONE_F_ONE_B;
+    PipelineStats pipeline_stats;
+
+    ThreadPool& get_pool();
+
+    /**
+     * @brief Creates the layers and lays out the arena for the current
+     *        topology, batch size and number of threads, if any of them
+     *        changed. Parameters trained so far are kept.
+     */
+    void build();
+
+    /**
+     * @brief Places the freshly laid out arena following the placement
+     *        policy, before anything is written to it
+     *
+     * @param shared The parameters, gradients and optimizer state, n_blocks
+     *        blocks of block floats
+     */
+    void place(float* shared, size_t block, size_t n_blocks);
+
+    /**
+     * @brief Copies the parameters to the replica of every node
+     */
+    void refresh_replicas();
+
+    /**
+     * @brief Rounds the parameters to their bf16 copy, if there is one
+     */
+    void refresh_bf16();
+
+    /**
+     * @brief Marks the weights that are 0 as pruned in every layer (after
+     *        a build the layers are new) and picks the sparse kernels for
+     *        the layers sparse enough for them, if prune() was called
+     */
+    void refresh_sparsity();
+
+    /**
+     * @brief Copies the weights to the CSR copy of the layers using the
+     *        sparse kernels
+     */
+    void refresh_sparse_values();
+    /**
+     * @brief Compiles the steps train_shard runs for the current layers,
+     *        after the kernels of every layer are picked, and the slices
+     *        of the reduction
+     *
+     * @param in_place The gradients are added to the weights by
+     *        train_shard (train_hogwild) instead of kept
+     */
+    void compile_schedule(bool in_place);
+    void delete_layers();
+    bool can_train(size_t n_samples, size_t n_features);
+    /**
+     * @brief Counts the epoch and hands the parameters to the checkpoint
+     *        writer and the validator when it is their turn
+     *
+     * @return false when early stopping says training should stop
+     */
+    bool end_epoch();
+
+    /**
+     * @brief Prints the validations finished since the last call and
+     *        updates the early stopping counter
+     */
+    void collect_validations();
+
+    /**
+     * @brief Waits for the background threads at the end of a training
+     *        run
+     */
+    void end_training();
+    void prepare_training();
+    /**
+     * @brief Forward and backward pass of rows [first, first+count) of the
+     *        batch, replaying the schedule. The gradients go to the
+     *        workspace, or with a schedule compiled in place are added to
+     *        the weights times update_scale.
+     */
+    void train_shard(Workspace& ws, const BatchInput& batch, size_t first, \
+                                    size_t count, float update_scale = 0.0f);
+    /**
+     * @brief Sums the gradients of every shard into the gradients of the
+     *        layers, in shard order so the result is reproducible
+     */
+    void reduce_gradients(size_t n_shards);
+
+    /**
+     * @brief Update step of the optimizer over the whole parameters block,
+     *        also zeroes the gradients for the next batch
+     */
+    void apply_gradients(size_t batch);
+
+    /**
+     * @brief Gradients of the batch in the gradients block, summed over
+     *        its samples, returns its loss
+     */
+    float compute_gradients(const BatchInput& batch);
+
+    /**
+     * @brief One gradient descent step on the batch, returns its loss
+     */
+    float train_batch(const BatchInput& batch);
+
+    /**
+     * @brief Cuts the layers in stages and lays out their slots for
+     *        micro-batches of micro_size rows
+     */
+    void setup_pipeline(size_t n_stages, size_t micro_size, size_t n_micro);
+
+    /**
+     * @brief The passes of stage s over the n_micro micro-batches of the
+     *        batch in the order of the schedule, then the update of the
+     *        parameters of its layers
+     */
+    void run_stage(size_t s, const BatchInput& batch, size_t micro_size, \
+                                                            size_t n_micro);
 
     public:
         NeuralNetwork(float learning_rate=0.0);
-        int add_layer(size_t size);
+        /**
+         * @brief Adds a layer after the last one
+         *
+         * @param size The number of neurons
+         * @param activation The activation of its neurons (unused for the
+         *                   input layer)
+         */
+        int add_layer(size_t size, Activation activation=Activation::RELU);
+
+        /**
+         * @brief The cost minimized by train, MSE by default. Cross entropy
+         *        expects probabilities, so a softmax (or sigmoid) output.
+         *        With a softmax output the softmax, loss and delta are one
+         *        fused pass over the logits (Layer::forward_cross_entropy).
+         */
+        void set_cost(Cost cost);
+        /**
+         * @brief Parses a csv file with the target in the first column and
+         *        the pixel values (0-255) in the others, using all threads
+         */
         int read_input(std::string filename);
+
+        /**
+         * @brief Maps a binary file written by save_input (no parsing)
+         */
+        int read_binary(std::string filename);
+
+        /**
+         * @brief Writes the loaded data in the binary format, so later runs
+         *        can use read_binary instead of parsing the csv again
+         */
+        int save_input(std::string filename);
+
+        /**
+         * @brief Uses the given samples instead of reading them from a file
+         *
+         * @param features n_features pixel values (0-255) per sample
+         * @param targets The class of every sample
+         * @param n_features The number of features of one sample
+         */
+        int set_data(std::vector<uint8_t> features, \
+                            std::vector<uint8_t> targets, size_t n_features);
         void display_input(size_t size);
+
+        /**
+         * @brief Number of samples averaged in every weight update
+         */
+        void set_batch_size(size_t size);
+
+        /**
+         * @brief Number of threads used by train, 0 for one per core
+         *
+         * @param pin Binds every thread to its own core, for steadier
+         *        timings
+         */
+        void set_threads(size_t threads, bool pin = false);
+
+        /**
+         * @brief Where the parameters and the buffers of every thread go on
+         *        machines with several NUMA nodes (see Numa.h). The
+         *        buffers of a thread always go on its own node. Pin the
+         *        threads for the placement to hold. Takes effect at the
+         *        next build.
+         */
+        void set_placement(Placement placement);
+
+        /**
+         * @brief Share of the memory read by the training threads (the
+         *        parameters and their own buffers) that is on another
+         *        NUMA node than theirs, 0 on one node
+         */
+        double remote_access_fraction();
+
+        /**
+         * @brief Mixed precision training with Precision::BF16: the
+         *        activations and a copy of the weights are stored in bf16
+         *        for the forward and backward passes, which read half the
+         *        bytes, while the dot products add up in fp32 and the
+         *        updates go to the fp32 weights. Uses the native bf16
+         *        instructions of the CPU if it has them (see Kernels.h).
+         *        The weights are still read in fp32 by train_hogwild. Takes
+         *        effect at the next build.
+         */
+        void set_precision(Kernels::Precision precision);
+
+        /**
+         * @brief Magnitude pruning: the weights smaller than threshold (in
+         *        absolute value) are set to 0 and stay 0 from then on, the
+         *        training only updates the others. The layers whose density
+         *        is below Sparse::crossover_density() then run on their
+         *        weights in CSR (see Sparse.h), the others stay dense.
+         */
+        int prune(float threshold);
+
+        /**
+         * @brief Same as prune, but keeps the k largest weights of every
+         *        layer
+         */
+        int prune_top_k(size_t k);
+
+        /**
+         * @brief Replaces the update rule (plain SGD with the learning rate
+         *        of the constructor by default). Its state starts at 0.
+         */
+        void set_optimizer(const OptimizerConfig& config);
+
+        /**
+         * @brief Trains on the loaded data with mini-batch gradient descent.
+         *        Every batch is split in one shard per thread, each thread
+         *        keeps its own gradients which are then summed in a fixed
+         *        order, so the result does not depend on the scheduling.
+         *
+         * @param epochs Number of passes over the data
+         */
         void train(size_t epochs);
+
+        /**
+         * @brief Same as train, but reads the batches from a binary dataset
+         *        file on a background thread instead of from the loaded data,
+         *        for datasets larger than memory. Prints how long every epoch
+         *        waited for data.
+         *
+         * @param filename A file written by save_input
+         * @param epochs Number of passes over the file
+         * @param n_buffers Number of batches loaded ahead of the trainer
+         */
+        void train_stream(std::string filename, size_t epochs, \
+                                                    size_t n_buffers=4);
+
+        /**
+         * @brief Asynchronous (Hogwild) training on the loaded data. Every
+         *        thread takes the next few samples from a shared counter,
+         *        computes their gradient in its own buffers and subtracts
+         *        it from the shared weights straight away, without locks
+         *        and without waiting for the other threads. Updates of
+         *        different threads may overwrite each other now and then,
+         *        which SGD tolerates, so no thread ever waits. The results
+         *        depend on the scheduling.
+         *        Threads take batch_size / threads samples at a time (set
+         *        the batch size to the number of threads for one sample per
+         *        step). Only plain SGD is supported.
+         *
+         * @param epochs Number of passes over the data
+         */
+        void train_hogwild(size_t epochs);
+
+        /**
+         * @brief Data parallel training on the loaded data with several
+         *        processes (Linux/POSIX). n_processes - 1 copies of this
+         *        one are forked, each trains a full replica on its own
+         *        slice of the data with batch_size / n_processes samples
+         *        per step, and the gradients are summed over the processes
+         *        through shared memory (see RingAllReduce.h) before every
+         *        update, so all the replicas stay the same. Rows past the
+         *        last full slice are not used. When threads are pinned,
+         *        every process gets its own cores.
+         *
+         * @param epochs Number of passes over the data
+         * @param n_processes Number of processes, this one included
+         */
+        void train_processes(size_t epochs, size_t n_processes);
+
+        /**
+         * @brief Pipeline parallel training on the loaded data (see
+         *        Pipeline.h). The layers are cut in n_stages stages with
+         *        about the same number of weights, stage s runs on thread
+         *        s (set_threads(n, true) gives every stage its own core),
+         *        and every batch is cut in n_micro_batches micro-batches
+         *        passed between the stages through lock-free queues. A
+         *        stage only reads and updates its own parameters, so they
+         *        stay in the caches of its core. The gradients of every
+         *        layer are summed in micro-batch order, so the results do
+         *        not depend on the number of stages or on the schedule.
+         *        Runs the fp32 passes whatever the precision. Prints the
+         *        throughput and the bubble of every epoch.
+         *
+         * @param epochs Number of passes over the data
+         * @param n_stages At most the number of threads and of layers
+         *        after the input
+         * @param n_micro_batches Micro-batches per batch, more make the
+         *        bubble smaller but the matrices thinner
+         */
+        void train_pipeline(size_t epochs, size_t n_stages, \
+                size_t n_micro_batches, \
+                PipelineSchedule schedule = PipelineSchedule::ONE_F_ONE_B);
+
+        /**
+         * @brief Throughput, bubble and layout of the stages of the last
+         *        epoch of train_pipeline
+         */
+        const PipelineStats& getPipelineStats() const;
         void display_layers();
-};
\ No newline at end of file
+
+        /**
+         * @brief Lays out the arena and compiles the schedule now rather
+         *        than at the start of the first training run. Call it after
+         *        the last add_layer and set_* call, it is run again anyway
+         *        if any of them changed since.
+         */
+        void compile();
+
+        /**
+         * @brief Prints the schedule of one shard and the memory of the
+         *        buffers of one thread
+         */
+        void display_plan();
+
+        /**
+         * @brief Gets the weights and bias of all layers as one contiguous,
+         *        64 byte aligned block (layer by layer, W then b, each
+         *        padded to 64 bytes)
+         */
+        float* getParameters();
+
+        /**
+         * @brief Gets the number of floats in getParameters(), padding
+         *        included
+         */
+        size_t getParameterSize();
+
+        /**
+         * @brief Copies the trained parameters to a read-only model for
+         *        serving, which needs no training buffers
+         */
+        int export_model(InferenceModel& model);
+
+        /**
+         * @brief Copies the trained parameters to a network of fixed
+         *        topology, which must have the same sizes
+         */
+        template<size_t... Sizes>
+        int export_model(StaticNetwork<Sizes...>& model){
+            build();
+            return model.load(sizes, activations, parameters);
+        }
+
+        /**
+         * @brief Makes an int8 copy of the trained parameters for serving,
+         *        calibrated on samples spread over the loaded data
+         *
+         * @param n_samples Samples used for the calibration
+         */
+        int quantize_model(QuantizedModel& model, size_t n_samples = 1000);
+
+        /**
+         * @brief Writes the topology and the parameters to a checkpoint
+         */
+        int save_checkpoint(std::string filename);
+
+        /**
+         * @brief Replaces the topology and the parameters with the ones of
+         *        a checkpoint, to resume training. The optimizer state
+         *        starts from 0.
+         */
+        int load_checkpoint(std::string filename);
+
+        /**
+         * @brief Saves a checkpoint every few epochs while training, from a
+         *        background thread so the training does not wait for it
+         *
+         * @param epochs Epochs between checkpoints, 0 turns them off
+         */
+        void set_checkpointing(std::string filename, size_t epochs);
+
+        /**
+         * @brief Measures the loss and accuracy on a held-out set every few
+         *        epochs while training. The parameters are copied once to a
+         *        snapshot and a background thread validates it while the
+         *        next epoch trains, so the training only pays for the copy.
+         *        The result of an epoch is printed at the end of the next
+         *        one (or of the training).
+         *
+         * @param filename A csv file like read_input's or a binary file
+         *                 written by save_input
+         * @param epochs Epochs between validations, 0 turns them off
+         */
+        int set_validation(std::string filename, size_t epochs = 1);
+
+        /**
+         * @brief Stops training when the validation loss has not improved
+         *        for patience validations in a row. The results arrive
+         *        while the next epoch trains, so training may stop one
+         *        epoch after the last stale validation. Needs
+         *        set_validation.
+         *
+         * @param patience 0 turns early stopping off
+         * @param best_checkpoint If not empty, every snapshot with the
+         *        lowest validation loss so far is saved there (by the
+         *        validation thread), so it holds the best parameters seen
+         */
+        void set_early_stopping(size_t patience, \
+                                        std::string best_checkpoint = "");
+
+        /**
+         * @brief Every validation finished so far, oldest first
+         */
+        const std::vector<ValidationResult>& getValidationHistory() const;
+        ~NeuralNetwork();
+};
@@ -0,0 +1,118 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the Numa functions defined in Numa.h
+ */
+
+#include"Numa.h"
+#include<cstdint>
+#include<fstream>
+#include<string>
+#include<vector>
+#include<unistd.h>
+#ifdef __linux__
+#include<linux/mempolicy.h>
+#include<sys/syscall.h>
+#endif
+
+namespace {
+    // A mask of nodes for mbind, one bit per node
+    std::vector<unsigned long> node_mask(size_t first, size_t count){
+        const size_t bits = 8 * sizeof(unsigned long);
+        std::vector<unsigned long> mask((first + count + bits - 1) / bits, 0);
+        for (size_t n = first; n < first + count; n++){
+            mask[n / bits] |= 1UL << (n % bits);
+        }
+        return mask;
+    }
+
+    int set_policy(void* p, size_t bytes, int mode, \
+                                    const std::vector<unsigned long>& mask){
+#ifdef __linux__
+        if (Numa::node_count() < 2 || bytes == 0) return 1;
+        long r = syscall(SYS_mbind, p, bytes, mode, mask.data(), \
+                                8 * sizeof(unsigned long) * mask.size(), 0);
+        return r == 0;
+#else
+        (void)p; (void)bytes; (void)mode; (void)mask;
+        return 1;
+#endif
+    }
+}
+
+namespace Numa {
+    size_t node_count(){
+        // "0" or "0-1", read once
+        static size_t count = [](){
+            std::ifstream online("/sys/devices/system/node/online");
+            std::string ranges;
+            if (!(online >> ranges)) return (size_t)1;
+            size_t dash = ranges.rfind('-');
+            size_t comma = ranges.rfind(',');
+            size_t start = dash == std::string::npos ? 0 : dash + 1;
+            if (comma != std::string::npos && comma > dash) start = comma + 1;
+            return (size_t)std::stoul(ranges.substr(start)) + 1;
+        }();
+        return count;
+    }
+
+    size_t current_node(){
+#ifdef __linux__
+        unsigned cpu = 0, node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) return node;
+#endif
+        return 0;
+    }
+
+    size_t page_size(){
+        static size_t size = sysconf(_SC_PAGESIZE);
+        return size;
+    }
+
+    int interleave(void* p, size_t bytes){
+#ifdef __linux__
+        return set_policy(p, bytes, MPOL_INTERLEAVE, \
+                                            node_mask(0, node_count()));
+#else
+        return set_policy(p, bytes, 0, {});
+#endif
+    }
+
+    int bind(void* p, size_t bytes, size_t node){
+#ifdef __linux__
+        return set_policy(p, bytes, MPOL_BIND, node_mask(node, 1));
+#else
+        (void)node;
+        return set_policy(p, bytes, 0, {});
+#endif
+    }
+
+    double remote_fraction(const void* p, size_t bytes, size_t node){
+#ifdef __linux__
+        size_t page = page_size();
+        uintptr_t begin = (uintptr_t)p / page * page;
+        uintptr_t end = (uintptr_t)p + bytes;
+        std::vector<void*> pages;
+        for (uintptr_t a = begin; a < end; a += page){
+            pages.push_back((void*)a);
+        }
+        if (pages.empty()) return 0.0;
+        // with no target nodes move_pages only reports where pages are
+        std::vector<int> status(pages.size(), -1);
+        if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, \
+                                                    status.data(), 0) != 0) {
+            return 0.0;
+        }
+        size_t touched = 0, remote = 0;
+        for (int s : status){
+            if (s < 0) continue; // not touched yet
+            touched += 1;
+            remote += (size_t)s != node;
+        }
+        return touched ? (double)remote / touched : 0.0;
+#else
+        (void)p; (void)bytes; (void)node;
+        return 0.0;
+#endif
+    }
+}
@@ -0,0 +1,58 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Memory placement on machines with several NUMA nodes (sockets), through
+ *  the Linux system calls directly so no libnuma is needed. Everywhere else,
+ *  or on one node, the machine is treated as a single node and the calls
+ *  do nothing.
+ */
+
+#pragma once
+
+#include<cstddef>
+
+/**
+ * @brief Where NeuralNetwork puts its parameters and buffers
+ */
+enum class Placement {
+    LOCAL,       // parameters on the node of the thread that builds it
+    FIRST_TOUCH, // every page on the node of the thread that uses it most
+    INTERLEAVED, // parameters spread page by page over all the nodes
+    REPLICATED   // one copy of the parameters per node, read locally
+};
+
+namespace Numa {
+    /**
+     * @brief Number of nodes, 1 if unknown
+     */
+    size_t node_count();
+
+    /**
+     * @brief The node the calling thread runs on, 0 if unknown
+     */
+    size_t current_node();
+
+    size_t page_size();
+
+    /**
+     * @brief Pages of [p, p+bytes) not touched yet go round robin over all
+     *        the nodes. p must be page aligned.
+     *
+     * @return 1 on success, 0 if the kernel refused
+     */
+    int interleave(void* p, size_t bytes);
+
+    /**
+     * @brief Pages of [p, p+bytes) not touched yet go to the given node
+     */
+    int bind(void* p, size_t bytes, size_t node);
+
+    /**
+     * @brief Share of the touched pages of [p, p+bytes) that are not on
+     *        the given node, i.e. how much of the reads of a thread there
+     *        go to another node
+     *
+     * @return In [0, 1], 0 if the pages can't be queried
+     */
+    double remote_fraction(const void* p, size_t bytes, size_t node);
+}
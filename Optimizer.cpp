@@ -0,0 +1,76 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the optimizers declared in Optimizer.h
+ */
+
+#include"Optimizer.h"
+#include<cmath>
+
+Optimizer::Optimizer(const OptimizerConfig& config){
+    this->config = config;
+}
+
+size_t Optimizer::getStateCount() const {
+    switch (config.type){
+        case OptimizerType::MOMENTUM:
+            return 1;
+        case OptimizerType::ADAM:
+        case OptimizerType::ADAMW:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+const OptimizerConfig& Optimizer::getConfig() const {
+    return config;
+}
+
+size_t Optimizer::getSteps() const {
+    return t;
+}
+
+void Optimizer::reset(){
+    t = 0;
+}
+
+void Optimizer::begin_step(float grad_scale){
+    t += 1;
+    this->grad_scale = grad_scale;
+    if (config.type != OptimizerType::ADAM && \
+                                    config.type != OptimizerType::ADAMW) {
+        return;
+    }
+    // The bias corrections only change once per step, so they are folded
+    // into the constants instead of being computed for every parameter
+    adam.grad_scale = grad_scale;
+    adam.beta1 = config.beta1;
+    adam.beta2 = config.beta2;
+    adam.epsilon = config.epsilon;
+    adam.step_size = config.learning_rate / \
+                            (1.0f - std::pow(config.beta1, (float)t));
+    adam.v_correction = 1.0f / (1.0f - std::pow(config.beta2, (float)t));
+    adam.decay = 1.0f;
+    if (config.type == OptimizerType::ADAMW) {
+        adam.decay -= config.learning_rate * config.weight_decay;
+    }
+}
+
+void Optimizer::update(size_t n, float* param, float* grad, float* state, \
+                                                        size_t stride) const{
+    switch (config.type){
+        case OptimizerType::MOMENTUM:
+            Kernels::momentum_step(n, config.learning_rate, config.momentum, \
+                                            grad_scale, grad, state, param);
+            break;
+        case OptimizerType::ADAM:
+        case OptimizerType::ADAMW:
+            Kernels::adam_step(n, adam, grad, state, state + stride, param);
+            break;
+        default:
+            Kernels::sgd_step(n, -config.learning_rate * grad_scale, grad, \
+                                                                    param);
+            break;
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Update rules applied to the parameters once the gradients of a batch are
+ *  summed. The optimizer does not own any memory, its state (momentum or
+ *  moments) is handed to it by the network, which keeps it in the arena
+ *  right after the gradients with the same layout as the parameters.
+ */
+
+#pragma once
+
+#include"Kernels.h"
+#include<cstddef>
+
+enum class OptimizerType { SGD, MOMENTUM, ADAM, ADAMW };
+
+struct OptimizerConfig {
+    OptimizerType type = OptimizerType::SGD;
+    float learning_rate = 0.01f;
+    float momentum = 0.9f;                          // MOMENTUM
+    float beta1 = 0.9f, beta2 = 0.999f;             // ADAM and ADAMW
+    float epsilon = 1e-8f;                          // ADAM and ADAMW
+    float weight_decay = 0.01f;                     // ADAMW
+};
+
+class Optimizer {
+    private:
+        OptimizerConfig config;
+        size_t t = 0; // steps taken, for the bias correction of Adam
+        float grad_scale = 1.0f;
+        Kernels::AdamStep adam;
+    public:
+        Optimizer(const OptimizerConfig& config = OptimizerConfig());
+
+        /**
+         * @brief Number of floats of state per parameter (0, 1 or 2)
+         */
+        size_t getStateCount() const;
+        const OptimizerConfig& getConfig() const;
+        size_t getSteps() const;
+
+        /**
+         * @brief Forgets the steps taken, for a state that was zeroed
+         *        without replacing the optimizer (a loaded checkpoint):
+         *        Adam corrects zero moments as if they were its first
+         */
+        void reset();
+
+        /**
+         * @brief Starts a step, must be called once before the update()
+         *        calls of that step
+         *
+         * @param grad_scale Multiplies the gradients, 1/batch to average them
+         */
+        void begin_step(float grad_scale);
+
+        /**
+         * @brief Updates n parameters and zeroes their gradients, in one
+         *        pass. Different slices can be updated by different threads.
+         *
+         * @param state The state of the first of the n parameters, state
+         *              vector k of that parameter is at state + k*stride
+         * @param stride The distance between two state vectors, in floats
+         */
+        void update(size_t n, float* param, float* grad, float* state, \
+                                                        size_t stride) const;
+};
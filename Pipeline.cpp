@@ -0,0 +1,65 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the functions declared in Pipeline.h
+ */
+
+#include"Pipeline.h"
+#include<algorithm>
+#include<limits>
+
+std::vector<size_t> Pipeline::partition(const std::vector<size_t>& costs, \
+                                                        size_t n_stages){
+    size_t n = costs.size();
+    n_stages = std::max<size_t>(1, std::min(n_stages, n));
+    std::vector<size_t> prefix(n + 1, 0);
+    for (size_t i = 0; i < n; i++) prefix[i+1] = prefix[i] + costs[i];
+    // best[k][i]: the smallest largest stage cutting the first i layers
+    // in k stages, cut[k][i]: where its last stage starts
+    const size_t none = std::numeric_limits<size_t>::max();
+    std::vector<std::vector<size_t>> best(n_stages + 1, \
+                                            std::vector<size_t>(n + 1, none));
+    std::vector<std::vector<size_t>> cut(n_stages + 1, \
+                                            std::vector<size_t>(n + 1, 0));
+    best[0][0] = 0;
+    for (size_t k = 1; k <= n_stages; k++){
+        for (size_t i = k; i <= n; i++){
+            for (size_t j = k - 1; j < i; j++){
+                if (best[k-1][j] == none) continue;
+                size_t largest = std::max(best[k-1][j], prefix[i] - prefix[j]);
+                if (largest < best[k][i]) {
+                    best[k][i] = largest;
+                    cut[k][i] = j;
+                }
+            }
+        }
+    }
+    std::vector<size_t> ranges(n_stages + 1, n);
+    for (size_t k = n_stages; k > 0; k--){
+        ranges[k-1] = cut[k][ranges[k]];
+    }
+    return ranges;
+}
+
+Pipeline::Op Pipeline::op_at(PipelineSchedule schedule, size_t stage, \
+                            size_t n_stages, size_t n_micro, size_t i){
+    if (schedule == PipelineSchedule::GPIPE) {
+        return i < n_micro ? Op{true, i} : Op{false, i - n_micro};
+    }
+    // 1F1B: the forward passes that fill the pipeline below this stage,
+    // then one forward and one backward in turn, then the backward passes
+    // left
+    size_t warmup = std::min(n_stages - stage - 1, n_micro);
+    if (i < warmup) return {true, i};
+    size_t k = i - warmup, steady = n_micro - warmup;
+    if (k < 2 * steady) {
+        return k % 2 == 0 ? Op{true, warmup + k / 2} : Op{false, k / 2};
+    }
+    return {false, k - steady};
+}
+
+size_t Pipeline::in_flight(PipelineSchedule schedule, size_t stage, \
+                                        size_t n_stages, size_t n_micro){
+    if (schedule == PipelineSchedule::GPIPE) return n_micro;
+    return std::min(n_micro, n_stages - stage);
+}
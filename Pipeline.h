@@ -0,0 +1,79 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  How pipeline parallel training (NeuralNetwork::train_pipeline) splits
+ *  the work. The layers are cut in contiguous stages of about the same
+ *  cost, each run by its own thread, and every batch is cut in
+ *  micro-batches that go down the stages (forward) and back up (backward).
+ *  A stage only ever reads its own weights, so they stay in the caches of
+ *  its core instead of being read by every thread as in data parallel
+ *  training.
+ *
+ *  With S stages and M micro-batches the first stage waits S-1 steps for
+ *  its first backward and the last one S-1 steps for its first forward, so
+ *  at best (S-1)/(M+S-1) of the time of the stages is lost, the bubble.
+ */
+
+#pragma once
+
+#include<cstddef>
+#include<vector>
+
+/**
+ * @brief Order of the forward and backward passes in one stage
+ */
+enum class PipelineSchedule {
+    GPIPE,       // the forward passes of all the micro-batches, then their
+                 // backward passes: M micro-batches in flight per stage
+    ONE_F_ONE_B  // a backward pass as soon as one can run, alternating with
+                 // the forward passes: stage s has at most S-s in flight
+};
+
+struct PipelineStageStats {
+    size_t first_layer, last_layer; // layers [first_layer, last_layer)
+    size_t parameter_bytes;  // weights, gradients and optimizer state
+    size_t activation_bytes; // activations and deltas of the micro-batches
+    double busy;             // seconds computing over the epoch
+    double waited;           // seconds waiting for another stage
+};
+
+struct PipelineStats {
+    size_t micro_batches;     // per batch
+    double seconds;           // of the epoch
+    double samples_per_second;
+    double bubble;            // share of the time of the stages not busy
+    double ideal_bubble;      // (S-1)/(M+S-1)
+    std::vector<PipelineStageStats> stages;
+};
+
+namespace Pipeline {
+    struct Op {
+        bool forward;
+        size_t micro; // the micro-batch
+    };
+
+    /**
+     * @brief Cuts costs (one per layer) in n_stages contiguous ranges,
+     *        each with at least one layer, so that the largest sum is the
+     *        smallest possible
+     *
+     * @return n_stages + 1 indices into costs, stage s is [r[s], r[s+1])
+     */
+    std::vector<size_t> partition(const std::vector<size_t>& costs, \
+                                                        size_t n_stages);
+
+    /**
+     * @brief The i-th of the 2 * n_micro passes of a stage. Every stage
+     *        runs the backward passes in micro-batch order whatever the
+     *        schedule, so the gradients are summed in the same order.
+     */
+    Op op_at(PipelineSchedule schedule, size_t stage, size_t n_stages, \
+                                                size_t n_micro, size_t i);
+
+    /**
+     * @brief Micro-batches in flight at most in a stage, i.e. the number
+     *        of sets of activations it needs
+     */
+    size_t in_flight(PipelineSchedule schedule, size_t stage, \
+                                        size_t n_stages, size_t n_micro);
+}
@@ -0,0 +1,159 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the profiler defined in Profiler.h
+ */
+
+#include"Profiler.h"
+#include<cstdlib>
+#include<fstream>
+#include<iostream>
+#include<map>
+#include<memory>
+#include<mutex>
+#include<new>
+#include<tuple>
+
+namespace {
+    thread_local uint64_t thread_allocations = 0;
+
+    using Key = std::tuple<std::string, size_t, size_t>;
+
+    struct Registry {
+        std::mutex mutex;
+        // map nodes never move, so the references handed out stay valid
+        std::map<Key, std::unique_ptr<Profiler::Counters>> scopes;
+        std::string prefix = "profile";
+        std::chrono::steady_clock::time_point since = \
+                                            std::chrono::steady_clock::now();
+    };
+
+    Registry& registry(){
+        static Registry r;
+        return r;
+    }
+}
+
+#ifdef NN_PROFILE
+// Every new goes through here to be counted, the array, sized and nothrow
+// versions of the standard library all end up calling these two
+void* operator new(size_t size){
+    thread_allocations += 1;
+    void* p = std::malloc(size ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+#endif
+
+namespace Profiler {
+    Counters& counters(const char* scope, size_t n_neurons, \
+                                                        size_t input_size){
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        std::unique_ptr<Counters>& c = \
+                            r.scopes[Key(scope, n_neurons, input_size)];
+        if (!c) c.reset(new Counters());
+        return *c;
+    }
+
+    uint64_t allocations(){
+        return thread_allocations;
+    }
+
+    void set_output(const std::string& prefix){
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.prefix = prefix;
+    }
+
+    void reset(){
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        for (auto& entry : r.scopes){
+            Counters& c = *entry.second;
+            c.calls = 0;
+            c.nanoseconds = 0;
+            c.flops = 0;
+            c.bytes = 0;
+            c.allocations = 0;
+        }
+        r.since = std::chrono::steady_clock::now();
+    }
+
+    int write_report(size_t epoch){
+        Registry& r = registry();
+        std::unique_lock<std::mutex> lock(r.mutex);
+        std::chrono::duration<double> wall = \
+                                std::chrono::steady_clock::now() - r.since;
+        std::string csv_name = r.prefix + ".csv";
+        bool new_file = !std::ifstream(csv_name).good();
+        std::ofstream csv(csv_name, std::ios::app);
+        std::ofstream json(r.prefix + ".json", std::ios::app);
+        if (!csv || !json) {
+            std::cerr << "Error: Could not write the profile to " << \
+                                            r.prefix << std::endl;
+            return 0;
+        }
+        if (new_file) {
+            csv << "epoch,scope,neurons,inputs,calls,seconds,gflops,"\
+                                "gbytes_per_second,allocations\n";
+        }
+        // one JSON object per line, so a report can be appended every epoch
+        json << "{\"epoch\":" << epoch << ",\"wall_seconds\":" << \
+                                        wall.count() << ",\"scopes\":[";
+        bool first = true;
+        for (auto& entry : r.scopes){
+            const Counters& c = *entry.second;
+            if (c.calls == 0) continue;
+            double seconds = c.nanoseconds * 1e-9;
+            double gflops = seconds > 0 ? c.flops / seconds * 1e-9 : 0.0;
+            double gbytes = seconds > 0 ? c.bytes / seconds * 1e-9 : 0.0;
+            const std::string& scope = std::get<0>(entry.first);
+            size_t neurons = std::get<1>(entry.first);
+            size_t inputs = std::get<2>(entry.first);
+            csv << epoch << "," << scope << "," << neurons << "," << \
+                inputs << "," << c.calls << "," << seconds << "," << \
+                gflops << "," << gbytes << "," << c.allocations << "\n";
+            json << (first ? "" : ",") << "{\"scope\":\"" << scope << \
+                "\",\"neurons\":" << neurons << ",\"inputs\":" << inputs << \
+                ",\"calls\":" << c.calls << ",\"seconds\":" << seconds << \
+                ",\"gflops\":" << gflops << ",\"gbytes_per_second\":" << \
+                gbytes << ",\"allocations\":" << c.allocations << "}";
+            first = false;
+        }
+        json << "]}\n";
+        lock.unlock();
+        reset();
+        return 1;
+    }
+
+    ScopedTimer::ScopedTimer(const char* scope, size_t n_neurons, \
+                size_t input_size, uint64_t flops, uint64_t bytes) \
+                : c(counters(scope, n_neurons, input_size)), flops(flops), \
+                bytes(bytes), start_allocations(thread_allocations), \
+                start(std::chrono::steady_clock::now()) {}
+
+    void ScopedTimer::add_work(uint64_t more_flops, uint64_t more_bytes){
+        flops += more_flops;
+        bytes += more_bytes;
+    }
+
+    ScopedTimer::~ScopedTimer(){
+        std::chrono::nanoseconds elapsed = \
+                                std::chrono::steady_clock::now() - start;
+        c.calls.fetch_add(1, std::memory_order_relaxed);
+        c.nanoseconds.fetch_add(elapsed.count(), std::memory_order_relaxed);
+        c.flops.fetch_add(flops, std::memory_order_relaxed);
+        c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+        c.allocations.fetch_add(thread_allocations - start_allocations, \
+                                                std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,98 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Scoped timers and counters for the hot paths, switched on at compile
+ *  time with -DNN_PROFILE. Without it the NN_PROFILE_* macros expand to
+ *  nothing, their arguments are not even evaluated.
+ *
+ *  Every scope is keyed by its name and the shape of the layer it ran on
+ *  (neurons x inputs), and records the calls, the wall time, the floating
+ *  point operations, the bytes moved and the heap allocations made inside
+ *  it. Times of scopes run by the workers are summed over the threads.
+ *  NeuralNetwork writes a report at the end of every epoch (one CSV row
+ *  per scope and one JSON object per epoch) and starts counting again.
+ */
+
+#pragma once
+
+#include<atomic>
+#include<chrono>
+#include<cstddef>
+#include<cstdint>
+#include<string>
+
+namespace Profiler {
+    struct Counters {
+        std::atomic<uint64_t> calls{0}, nanoseconds{0}, flops{0}, bytes{0};
+        std::atomic<uint64_t> allocations{0};
+    };
+
+    /**
+     * @brief Gets the counters of a scope, created on first use. They live
+     *        until the end of the program.
+     *
+     * @param scope A string literal naming the code measured
+     * @param n_neurons, input_size The shape of the layer, 0 if none
+     */
+    Counters& counters(const char* scope, size_t n_neurons, \
+                                                        size_t input_size);
+
+    /**
+     * @brief Heap allocations made by this thread so far, only counted
+     *        when built with NN_PROFILE
+     */
+    uint64_t allocations();
+
+    /**
+     * @brief Sets the files the reports go to, prefix.csv and prefix.json
+     *        (default "profile")
+     */
+    void set_output(const std::string& prefix);
+
+    /**
+     * @brief Appends the counters of every scope since the last report to
+     *        the report files and resets them
+     *
+     * @param epoch The epoch the report is for
+     * @return 1 on success, 0 if the files can't be written
+     */
+    int write_report(size_t epoch);
+
+    /**
+     * @brief Sets every counter back to 0
+     */
+    void reset();
+
+    /**
+     * @brief Adds its lifetime to the counters of a scope
+     */
+    class ScopedTimer {
+        private:
+            Counters& c;
+            uint64_t flops, bytes, start_allocations;
+            std::chrono::steady_clock::time_point start;
+        public:
+            ScopedTimer(const char* scope, size_t n_neurons, \
+                    size_t input_size, uint64_t flops, uint64_t bytes);
+            ScopedTimer(const ScopedTimer&) = delete;
+            ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+            /**
+             * @brief Adds work only known once the scope has run
+             */
+            void add_work(uint64_t more_flops, uint64_t more_bytes);
+            ~ScopedTimer();
+    };
+}
+
+#ifdef NN_PROFILE
+#define NN_PROFILE_SCOPE(scope, n_neurons, input_size, flops, bytes) \
+    Profiler::ScopedTimer nn_profile_timer(scope, n_neurons, input_size, \
+                                                            flops, bytes)
+#define NN_PROFILE_WORK(flops, bytes) nn_profile_timer.add_work(flops, bytes)
+#define NN_PROFILE_REPORT(epoch) Profiler::write_report(epoch)
+#else
+#define NN_PROFILE_SCOPE(scope, n_neurons, input_size, flops, bytes)
+#define NN_PROFILE_WORK(flops, bytes)
+#define NN_PROFILE_REPORT(epoch)
+#endif
@@ -0,0 +1,219 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the QuantizedModel class defined in QuantizedModel.h
+ */
+
+#include"QuantizedModel.h"
+#include"Arena.h"
+#include"Kernels.h"
+#include"Layer.h"
+#include<algorithm>
+#include<cmath>
+#include<iostream>
+
+namespace {
+    /**
+     * @brief f(z) in place, the switch happens once per row
+     */
+    void activate(Activation activation, float* z, size_t n){
+        switch (activation){
+            case Activation::SIGMOID:
+                for (size_t i = 0; i < n; i++){
+                    z[i] = ActivationFuncs::Sigmoid(z[i]);
+                }
+                break;
+            case Activation::TANH:
+                for (size_t i = 0; i < n; i++){
+                    z[i] = ActivationFuncs::Tanh(z[i]);
+                }
+                break;
+            case Activation::SOFTMAX:
+                ActivationFuncs::Softmax(z, n);
+                break;
+            case Activation::IDENTITY:
+                break;
+            default:
+                for (size_t i = 0; i < n; i++){
+                    z[i] = ActivationFuncs::ReLU(z[i]);
+                }
+                break;
+        }
+    }
+
+    // clamped in float first so the conversion is a plain (vectorizable)
+    // truncation of a non negative value
+    uint8_t quantize_value(float x, float inv_scale, int32_t zero){
+        float q = std::min(255.0f, std::max(0.0f, x * inv_scale + zero));
+        return (uint8_t)(q + 0.5f);
+    }
+}
+
+int QuantizedModel::quantize(const std::vector<size_t>& sizes, \
+                        const std::vector<Activation>& activations, \
+                        const float* parameters, const float* calibration, \
+                        size_t n_samples){
+    if (sizes.size() < 2 || activations.size() != sizes.size() || \
+                                                        n_samples == 0) {
+        std::cerr << "Error: Need at least 2 layers and some samples to " \
+                                            "quantize." << std::endl;
+        return 0;
+    }
+    size_t n_layers = sizes.size();
+
+    // Calibration: the float network on the samples, keeping the range of
+    // the input of every layer
+    std::vector<float> low(n_layers, 0.0f), high(n_layers, 0.0f);
+    std::vector<std::vector<float>> outputs(n_layers);
+    outputs[0].assign(calibration, calibration + n_samples * sizes[0]);
+    const float* p = parameters;
+    std::vector<const float*> weights(n_layers), bias(n_layers);
+    for (size_t l = 1; l < n_layers; l++){
+        weights[l] = p;
+        p += Arena::round_up(sizes[l] * sizes[l-1]);
+        bias[l] = p;
+        p += Arena::round_up(sizes[l]);
+    }
+    for (size_t l = 0; l + 1 < n_layers; l++){
+        auto range = std::minmax_element(outputs[l].begin(), outputs[l].end());
+        // 0 is always in the range so a zero input stays exactly 0
+        low[l] = std::min(0.0f, *range.first);
+        high[l] = std::max(0.0f, *range.second);
+        outputs[l+1].resize(n_samples * sizes[l+1]);
+        Layer::dense_forward(weights[l+1], bias[l+1], sizes[l+1], sizes[l], \
+            activations[l+1], outputs[l].data(), outputs[l+1].data(), \
+                                                                n_samples);
+    }
+
+    layers.assign(n_layers - 1, QuantizedLayer());
+    for (size_t l = 1; l < n_layers; l++){
+        QuantizedLayer& q = layers[l-1];
+        q.size = sizes[l];
+        q.input_size = sizes[l-1];
+        q.activation = activations[l];
+        q.bias.assign(bias[l], bias[l] + q.size);
+        q.weights.resize(q.size * q.input_size);
+        q.weight_scale.resize(q.size);
+        q.weight_sum.resize(q.size);
+        for (size_t i = 0; i < q.size; i++){
+            const float* w = weights[l] + i * q.input_size;
+            float max = 0.0f;
+            for (size_t j = 0; j < q.input_size; j++){
+                max = std::max(max, std::fabs(w[j]));
+            }
+            float scale = max > 0.0f ? max / 127.0f : 1.0f;
+            int32_t sum = 0;
+            for (size_t j = 0; j < q.input_size; j++){
+                int8_t v = (int8_t)std::lround(w[j] / scale);
+                q.weights[i * q.input_size + j] = v;
+                sum += v;
+            }
+            q.weight_scale[i] = scale;
+            q.weight_sum[i] = sum;
+        }
+        float span = high[l-1] - low[l-1];
+        q.input_scale = span > 0.0f ? span / 255.0f : 1.0f;
+        q.input_zero = (int32_t)std::lround(-low[l-1] / q.input_scale);
+    }
+    // pixels / 255 in [0, 1] quantize back to the pixels themselves
+    if (low[0] == 0.0f && high[0] <= 1.0f) {
+        layers[0].input_scale = 1.0f / 255.0f;
+        layers[0].input_zero = 0;
+    }
+
+    size_t widest = 0;
+    for (size_t l = 0; l < n_layers; l++){
+        widest = std::max(widest, sizes[l]);
+    }
+    input.resize(sizes[0]);
+    ping_pong[0].resize(widest);
+    ping_pong[1].resize(widest);
+    row.resize(widest);
+    return 1;
+}
+
+void QuantizedModel::run(const uint8_t* input, float* out){
+    for (size_t l = 0; l < layers.size(); l++){
+        const QuantizedLayer& q = layers[l];
+        bool last = l + 1 == layers.size();
+        float* z = last ? out : row.data();
+        for (size_t i = 0; i < q.size; i++){
+            int32_t dot = Kernels::dot_u8s8(input, \
+                            q.weights.data() + i * q.input_size, q.input_size);
+            z[i] = q.input_scale * q.weight_scale[i] * \
+                    (float)(dot - q.input_zero * q.weight_sum[i]) + q.bias[i];
+        }
+        activate(q.activation, z, q.size);
+        if (last) break;
+        const QuantizedLayer& next = layers[l+1];
+        uint8_t* next_input = ping_pong[l % 2].data();
+        float inv_scale = 1.0f / next.input_scale;
+        for (size_t i = 0; i < q.size; i++){
+            next_input[i] = quantize_value(z[i], inv_scale, next.input_zero);
+        }
+        input = next_input;
+    }
+}
+
+int QuantizedModel::predict(const float* X, size_t n, float* out){
+    if (layers.empty()) {
+        std::cerr << "Error: No model quantized." << std::endl;
+        return 0;
+    }
+    const QuantizedLayer& first = layers[0];
+    float inv_scale = 1.0f / first.input_scale;
+    for (size_t s = 0; s < n; s++){
+        const float* x = X + s * first.input_size;
+        for (size_t j = 0; j < first.input_size; j++){
+            input[j] = quantize_value(x[j], inv_scale, first.input_zero);
+        }
+        run(input.data(), out + s * getOutputSize());
+    }
+    return 1;
+}
+
+int QuantizedModel::predict_pixels(const uint8_t* pixels, size_t n, \
+                                                                float* out){
+    if (layers.empty()) {
+        std::cerr << "Error: No model quantized." << std::endl;
+        return 0;
+    }
+    const QuantizedLayer& first = layers[0];
+    if (first.input_zero != 0 || first.input_scale != 1.0f / 255.0f) {
+        std::cerr << "Error: The model was not calibrated on pixels." << \
+                                                                    std::endl;
+        return 0;
+    }
+    for (size_t s = 0; s < n; s++){
+        run(pixels + s * first.input_size, out + s * getOutputSize());
+    }
+    return 1;
+}
+
+int QuantizedModel::predict_class(const float* X, size_t n, \
+                                                            size_t* classes){
+    size_t n_out = getOutputSize();
+    std::vector<float> out(n * n_out);
+    if (!predict(X, n, out.data())) return 0;
+    for (size_t s = 0; s < n; s++){
+        const float* y = out.data() + s * n_out;
+        classes[s] = std::max_element(y, y + n_out) - y;
+    }
+    return 1;
+}
+
+size_t QuantizedModel::getInputSize() const {
+    return layers.empty() ? 0 : layers.front().input_size;
+}
+
+size_t QuantizedModel::getOutputSize() const {
+    return layers.empty() ? 0 : layers.back().size;
+}
+
+size_t QuantizedModel::getWeightBytes() const {
+    size_t bytes = 0;
+    for (const QuantizedLayer& q : layers){
+        bytes += q.weights.size();
+    }
+    return bytes;
+}
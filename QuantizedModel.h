@@ -0,0 +1,89 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  int8 copy of a trained network for serving. The weights of every
+ *  output neuron (channel) get their own scale, w = scale * q with q in
+ *  [-127, 127], so 4x less memory than float. The input of every layer is
+ *  stored as uint8 with a scale and zero point measured by a calibration
+ *  pass over sample inputs, x = scale * (q - zero). Each neuron is then
+ *  one exact integer dot product (VNNI when the CPU has it):
+ *      y = x_scale * w_scale * (sum(qx * qw) - zero * sum(qw)) + b
+ *  Raw 0-255 pixels are already the uint8 input of the first layer.
+ */
+
+#pragma once
+
+#include"ActivationFuncs.h"
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+class QuantizedModel {
+    private:
+        struct QuantizedLayer {
+            size_t size = 0, input_size = 0;
+            Activation activation = Activation::RELU;
+            std::vector<int8_t> weights;     // size x input_size
+            std::vector<float> weight_scale; // per neuron
+            std::vector<int32_t> weight_sum; // sum of the row, per neuron
+            std::vector<float> bias;
+            float input_scale = 1.0f;
+            int32_t input_zero = 0;
+        };
+        std::vector<QuantizedLayer> layers;
+        // the quantized input of the first layer, the uint8 inputs of the
+        // next layer and the float outputs of one sample, reused by every
+        // call
+        std::vector<uint8_t> input;
+        std::vector<uint8_t> ping_pong[2];
+        std::vector<float> row;
+
+        /**
+         * @brief Runs one sample whose input is already quantized for the
+         *        first layer
+         */
+        void run(const uint8_t* input, float* out);
+    public:
+        /**
+         * @brief Quantizes a network
+         *
+         * @param sizes The neurons of every layer, input layer first
+         * @param activations The activation of every layer
+         * @param parameters Laid out like NeuralNetwork::getParameters()
+         * @param calibration n_samples inputs (normalized like for
+         *                    training) used to find the range of the input
+         *                    of every layer
+         */
+        int quantize(const std::vector<size_t>& sizes, \
+                        const std::vector<Activation>& activations, \
+                        const float* parameters, const float* calibration, \
+                        size_t n_samples);
+
+        /**
+         * @brief Runs n samples through the network
+         *
+         * @param X n rows of getInputSize() floats
+         * @param out n rows of getOutputSize() floats
+         */
+        int predict(const float* X, size_t n, float* out);
+
+        /**
+         * @brief Same as predict, on raw 0-255 pixels (the inputs used for
+         *        training divided by 255), which need no conversion
+         */
+        int predict_pixels(const uint8_t* pixels, size_t n, float* out);
+
+        /**
+         * @brief The most likely class (the largest output) of n samples
+         */
+        int predict_class(const float* X, size_t n, size_t* classes);
+
+        size_t getInputSize() const;
+        size_t getOutputSize() const;
+
+        /**
+         * @brief Bytes taken by the weights, to compare with 4 bytes per
+         *        float weight
+         */
+        size_t getWeightBytes() const;
+};
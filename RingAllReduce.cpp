@@ -0,0 +1,165 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the RingAllReduce class defined in RingAllReduce.h
+ */
+
+#include"RingAllReduce.h"
+#include"Kernels.h"
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+#include<thread>
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<unistd.h>
+
+int RingAllReduce::create(const std::string& name, size_t n_ranks, \
+                                                        size_t n_floats){
+    close();
+    if (n_ranks == 0) {
+        std::cerr << "Error: Need at least one rank." << std::endl;
+        return 0;
+    }
+    size_t counters = sizeof(Header) + n_ranks * sizeof(Counter);
+    size_t size = counters + 2 * n_ranks * n_floats * sizeof(float);
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        std::cerr << "Error: Could not create shared memory " << name << \
+                                                                std::endl;
+        return 0;
+    }
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    shm_unlink(name.c_str()); // the mappings keep it alive
+    if (map == MAP_FAILED) {
+        std::cerr << "Error: Could not map shared memory " << name << \
+                                                                std::endl;
+        return 0;
+    }
+    // a new segment is zero filled, which is a valid state for the atomics
+    mapping = map;
+    mapping_size = size;
+    this->n_ranks = n_ranks;
+    this->n_floats = n_floats;
+    header = static_cast<Header*>(map);
+    published = reinterpret_cast<Counter*>(header + 1);
+    mailboxes = reinterpret_cast<float*>(static_cast<char*>(map) + counters);
+    sent = received = 0;
+    return 1;
+}
+
+void RingAllReduce::set_rank(size_t rank){
+    this->rank = rank;
+}
+
+float* RingAllReduce::mailbox(size_t owner, size_t phase){
+    return mailboxes + (2 * owner + phase) * n_floats;
+}
+
+void RingAllReduce::publish(){
+    sent += 1;
+    published[rank].value.store(sent, std::memory_order_release);
+}
+
+void RingAllReduce::wait_for_left(){
+    size_t left = (rank + n_ranks - 1) % n_ranks;
+    received += 1;
+    size_t spins = 0;
+    while (published[left].value.load(std::memory_order_acquire) < received){
+        // there may be fewer cores than ranks, let the neighbour run
+        if (++spins > 64) std::this_thread::yield();
+    }
+}
+
+void RingAllReduce::all_reduce(float* data, size_t n){
+    if (n_ranks <= 1 || n == 0) return;
+    if (n > n_floats) {
+        std::cerr << "Error: all_reduce of more floats than reserved." << \
+                                                                std::endl;
+        return;
+    }
+    size_t P = n_ranks;
+    size_t left = (rank + P - 1) % P;
+    auto segment_begin = [&](size_t s){ return s * n / P; };
+
+    // phase 0 (reduce-scatter) sends partial sums, phase 1 (all-gather)
+    // the totals. Step 0 of a phase sends a segment of this rank, then at
+    // every step the segment received from the left is combined with the
+    // local one chunk by chunk and sent on right away
+    for (size_t phase = 0; phase < 2; phase++){
+        float* out = mailbox(rank, phase);
+        const float* in = mailbox(left, phase);
+        // the segment this rank starts the phase with
+        size_t first = phase == 0 ? rank : (rank + 1) % P;
+        for (size_t i = segment_begin(first); i < segment_begin(first + 1); \
+                                                                i += CHUNK){
+            size_t len = std::min(CHUNK, segment_begin(first + 1) - i);
+            std::memcpy(out + i, data + i, len * sizeof(float));
+            publish();
+        }
+        for (size_t step = 1; step < P; step++){
+            size_t s = (first + P - step) % P;
+            bool forward = step + 1 < P;
+            for (size_t i = segment_begin(s); i < segment_begin(s + 1); \
+                                                                i += CHUNK){
+                size_t len = std::min(CHUNK, segment_begin(s + 1) - i);
+                wait_for_left();
+                if (phase == 0) {
+                    Kernels::axpy(len, 1.0f, in + i, data + i);
+                } else {
+                    std::memcpy(data + i, in + i, len * sizeof(float));
+                }
+                if (forward) {
+                    std::memcpy(out + i, data + i, len * sizeof(float));
+                    publish();
+                }
+            }
+        }
+    }
+    // the mailboxes are reused by the next call, nobody may still be
+    // reading them
+    barrier();
+}
+
+void RingAllReduce::barrier(){
+    if (n_ranks <= 1) return;
+    uint64_t generation = \
+                header->generation.value.load(std::memory_order_acquire);
+    if (header->arrived.value.fetch_add(1, std::memory_order_acq_rel) + 1 \
+                                                            == n_ranks) {
+        header->arrived.value.store(0, std::memory_order_relaxed);
+        header->generation.value.fetch_add(1, std::memory_order_release);
+        return;
+    }
+    size_t spins = 0;
+    while (header->generation.value.load(std::memory_order_acquire) == \
+                                                            generation){
+        if (++spins > 64) std::this_thread::yield();
+    }
+}
+
+size_t RingAllReduce::getRanks() const {
+    return n_ranks;
+}
+
+size_t RingAllReduce::getRank() const {
+    return rank;
+}
+
+void RingAllReduce::close(){
+    if (mapping != nullptr) munmap(mapping, mapping_size);
+    mapping = nullptr;
+    mapping_size = 0;
+    header = nullptr;
+    published = nullptr;
+    mailboxes = nullptr;
+    n_ranks = 0;
+}
+
+RingAllReduce::~RingAllReduce(){
+    close();
+}
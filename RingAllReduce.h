@@ -0,0 +1,89 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Sums an array of floats across several processes on one machine (every
+ *  process ends with the total) through a POSIX shared memory segment.
+ *
+ *  The ranks form a ring, each one only reads from the rank before it. The
+ *  array is cut in one segment per rank: in P-1 reduce-scatter steps every
+ *  rank adds the partial sums coming from its left to its own, ending with
+ *  one fully summed segment, and in P-1 all-gather steps the summed
+ *  segments go once around the ring. Each rank moves 2(P-1)/P of the array
+ *  whatever P is. Segments travel in chunks, each published with a counter
+ *  as soon as it is written, so a rank starts adding the first chunk of a
+ *  step while its neighbour still writes the rest, and forwards every
+ *  chunk as soon as it has added it.
+ */
+
+#pragma once
+
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+#include<string>
+
+class RingAllReduce {
+    private:
+        // Chunk the data travels in, 16KB
+        static constexpr size_t CHUNK = 4096;
+
+        struct alignas(64) Counter {
+            std::atomic<uint64_t> value;
+        };
+        struct Header {
+            Counter arrived, generation; // barrier
+        };
+
+        void* mapping = nullptr;
+        size_t mapping_size = 0;
+        size_t n_ranks = 0, n_floats = 0, rank = 0;
+        Header* header = nullptr;
+        Counter* published = nullptr; // chunks written so far, per rank
+        float* mailboxes = nullptr;    // 2 arrays of n_floats per rank
+        // chunks this rank wrote and read from its left, since the start
+        uint64_t sent = 0, received = 0;
+
+        float* mailbox(size_t owner, size_t phase);
+        void publish();
+        void wait_for_left();
+    public:
+        RingAllReduce() = default;
+        RingAllReduce(const RingAllReduce&) = delete;
+        RingAllReduce& operator=(const RingAllReduce&) = delete;
+
+        /**
+         * @brief Creates the shared segment. It is unlinked straight away,
+         *        the processes forked afterwards keep it mapped.
+         *
+         * @param name A name not used by another segment, like "/nn_ring"
+         * @param n_ranks The number of processes taking part
+         * @param n_floats The largest array summed
+         * @return 1 on success, 0 if the segment can't be created
+         */
+        int create(const std::string& name, size_t n_ranks, size_t n_floats);
+
+        /**
+         * @brief Sets which process this is, in [0, n_ranks), once forked
+         */
+        void set_rank(size_t rank);
+
+        /**
+         * @brief Replaces data with its sum over every rank. All the ranks
+         *        must call it with the same n, in the same order.
+         */
+        void all_reduce(float* data, size_t n);
+
+        /**
+         * @brief Returns once every rank called it
+         */
+        void barrier();
+
+        size_t getRanks() const;
+        size_t getRank() const;
+
+        /**
+         * @brief Unmaps the segment
+         */
+        void close();
+        ~RingAllReduce();
+};
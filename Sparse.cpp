@@ -0,0 +1,216 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the sparse kernels defined in Sparse.h
+ */
+
+#include"Sparse.h"
+#include"Kernels.h"
+#include<algorithm>
+#include<chrono>
+#include<cstring>
+#include<random>
+
+namespace {
+    /**
+     * @brief Scratch for the transposed operands, one pair per thread so the
+     *        shards can run the kernels at the same time
+     */
+    float* scratch(size_t which, size_t n){
+        thread_local std::vector<float> buffers[2];
+        std::vector<float>& buffer = buffers[which];
+        if (buffer.size() < n) buffer.resize(n);
+        return buffer.data();
+    }
+
+    /**
+     * @brief T(cols x rows) = A(rows x cols)^T, in 8x8 blocks so both the
+     *        reads and the writes stay within a few cache lines
+     */
+    void transpose(size_t rows, size_t cols, const float* A, size_t lda, \
+                                                    float* T, size_t ldt){
+        constexpr size_t B = 8;
+        for (size_t r0 = 0; r0 < rows; r0 += B){
+            size_t r1 = std::min(rows, r0 + B);
+            for (size_t c0 = 0; c0 < cols; c0 += B){
+                size_t c1 = std::min(cols, c0 + B);
+                for (size_t r = r0; r < r1; r++){
+                    for (size_t c = c0; c < c1; c++){
+                        T[c*ldt + r] = A[r*lda + c];
+                    }
+                }
+            }
+        }
+    }
+}
+
+size_t Sparse::Csr::nnz() const {
+    return values.size();
+}
+
+float Sparse::Csr::density() const {
+    if (rows * cols == 0) return 1.0f;
+    return (float)nnz() / (float)(rows * cols);
+}
+
+Sparse::Csr Sparse::from_dense(const float* W, size_t rows, size_t cols, \
+                                                                size_t ld){
+    Csr csr;
+    csr.rows = rows;
+    csr.cols = cols;
+    csr.row_start.reserve(rows + 1);
+    csr.row_start.push_back(0);
+    for (size_t r = 0; r < rows; r++){
+        const float* w = W + r*ld;
+        for (size_t c = 0; c < cols; c++){
+            if (w[c] != 0.0f) {
+                csr.columns.push_back((uint32_t)c);
+                csr.values.push_back(w[c]);
+            }
+        }
+        csr.row_start.push_back((uint32_t)csr.values.size());
+    }
+    return csr;
+}
+
+float Sparse::density(const float* W, size_t n){
+    if (n == 0) return 1.0f;
+    size_t nonzero = 0;
+    for (size_t i = 0; i < n; i++){
+        nonzero += W[i] != 0.0f;
+    }
+    return (float)nonzero / (float)n;
+}
+
+void Sparse::gather(const float* W, size_t ld, Csr& csr){
+    for (size_t r = 0; r < csr.rows; r++){
+        const float* w = W + r*ld;
+        for (uint32_t i = csr.row_start[r]; i < csr.row_start[r + 1]; i++){
+            csr.values[i] = w[csr.columns[i]];
+        }
+    }
+}
+
+void Sparse::spmm_nt(size_t M, const float* X, size_t ldx, const Csr& W, \
+                                                    float* C, size_t ldc){
+    size_t N = W.rows, K = W.cols;
+    if (M < 8){
+        // too few rows to pay for the transposes, gather straight from X
+        for (size_t m = 0; m < M; m++){
+            const float* x = X + m*ldx;
+            float* c = C + m*ldc;
+            for (size_t n = 0; n < N; n++){
+                float sum = 0.0f;
+                for (uint32_t i = W.row_start[n]; i < W.row_start[n+1]; i++){
+                    sum += W.values[i] * x[W.columns[i]];
+                }
+                c[n] = sum;
+            }
+        }
+        return;
+    }
+    // Z^T(N x M) = W * X^T: with X^T every nonzero w[n][k] adds w * row k
+    // of X^T to row n of Z^T, a contiguous axpy over the batch
+    const Kernels::KernelTable& kt = Kernels::active();
+    float* XT = scratch(0, K * M);
+    float* ZT = scratch(1, N * M);
+    transpose(M, K, X, ldx, XT, M);
+    std::memset(ZT, 0, N * M * sizeof(float));
+    for (size_t n = 0; n < N; n++){
+        float* z = ZT + n*M;
+        for (uint32_t i = W.row_start[n]; i < W.row_start[n + 1]; i++){
+            kt.axpy(M, W.values[i], XT + W.columns[i]*M, z);
+        }
+    }
+    transpose(N, M, ZT, M, C, ldc);
+}
+
+void Sparse::spmm_nn(size_t M, const float* D, size_t ldd, const Csr& W, \
+                                                    float* C, size_t ldc){
+    size_t N = W.rows, K = W.cols;
+    if (M < 8){
+        for (size_t m = 0; m < M; m++){
+            const float* d = D + m*ldd;
+            float* c = C + m*ldc;
+            std::memset(c, 0, K * sizeof(float));
+            for (size_t n = 0; n < N; n++){
+                for (uint32_t i = W.row_start[n]; i < W.row_start[n+1]; i++){
+                    c[W.columns[i]] += W.values[i] * d[n];
+                }
+            }
+        }
+        return;
+    }
+    // C^T(K x M) = W^T * D^T: the nonzero w[n][k] adds w * row n of D^T to
+    // row k of C^T
+    const Kernels::KernelTable& kt = Kernels::active();
+    float* DT = scratch(0, N * M);
+    float* CT = scratch(1, K * M);
+    transpose(M, N, D, ldd, DT, M);
+    std::memset(CT, 0, K * M * sizeof(float));
+    for (size_t n = 0; n < N; n++){
+        const float* d = DT + n*M;
+        for (uint32_t i = W.row_start[n]; i < W.row_start[n + 1]; i++){
+            kt.axpy(M, W.values[i], d, CT + W.columns[i]*M);
+        }
+    }
+    transpose(K, M, CT, M, C, ldc);
+}
+
+void Sparse::sddmm_tn(size_t M, float alpha, const float* D, size_t ldd, \
+                const float* X, size_t ldx, const Csr& pattern, float* dW, \
+                                                                size_t lddw){
+    size_t N = pattern.rows, K = pattern.cols;
+    // dW[n][k] += alpha * <column n of D, column k of X>, both columns are
+    // rows of the transposes
+    const Kernels::KernelTable& kt = Kernels::active();
+    float* DT = scratch(0, N * M);
+    float* XT = scratch(1, K * M);
+    transpose(M, N, D, ldd, DT, M);
+    transpose(M, K, X, ldx, XT, M);
+    for (size_t n = 0; n < N; n++){
+        const float* d = DT + n*M;
+        float* w = dW + n*lddw;
+        for (uint32_t i = pattern.row_start[n]; \
+                                        i < pattern.row_start[n + 1]; i++){
+            uint32_t k = pattern.columns[i];
+            w[k] += alpha * kt.dot(d, XT + k*M, M);
+        }
+    }
+}
+
+float Sparse::crossover_density(){
+    static const float crossover = []{
+        constexpr size_t M = 64, N = 256, K = 256, REPEATS = 20;
+        std::mt19937 gen(42);
+        std::uniform_real_distribution<float> distr(-1.0f, 1.0f);
+        std::vector<float> X(M * K), W(N * K), C(M * N), pruned(N * K);
+        for (float& x : X) x = distr(gen);
+        for (float& w : W) w = distr(gen);
+        auto time = [&](auto&& product){
+            product();  // warm up the caches and the scratch buffers
+            auto start = std::chrono::steady_clock::now();
+            for (size_t r = 0; r < REPEATS; r++) product();
+            return std::chrono::duration<double>( \
+                            std::chrono::steady_clock::now() - start).count();
+        };
+        double dense = time([&]{
+            Kernels::gemm_nt(M, N, K, X.data(), K, W.data(), K, C.data(), N);
+        });
+        // the densest tried at which the sparse product is faster
+        const float densities[] = {0.5f, 0.3f, 0.2f, 0.1f, 0.05f};
+        for (float d : densities){
+            std::uniform_real_distribution<float> keep(0.0f, 1.0f);
+            for (size_t i = 0; i < N * K; i++){
+                pruned[i] = keep(gen) < d ? W[i] : 0.0f;
+            }
+            Csr csr = from_dense(pruned.data(), N, K, K);
+            double sparse = time([&]{
+                spmm_nt(M, X.data(), K, csr, C.data(), N);
+            });
+            if (sparse < dense) return d;
+        }
+        return 0.0f;
+    }();
+    return crossover;
+}
@@ -0,0 +1,78 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Compressed sparse row (CSR) weights for pruned layers, and the products
+ *  the passes need with them. The dense operand is transposed first, so
+ *  every nonzero weight becomes one contiguous axpy (or dot) over the
+ *  batch, done by the vector kernels of Kernels.h.
+ */
+
+#pragma once
+
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+namespace Sparse {
+    /**
+     * @brief The nonzero entries of a rows x cols row-major matrix. Row r
+     *        has the entries [row_start[r], row_start[r+1]) of columns
+     *        and values, in increasing column order.
+     */
+    struct Csr {
+        size_t rows = 0, cols = 0;
+        std::vector<uint32_t> row_start, columns;
+        std::vector<float> values;
+
+        size_t nnz() const;
+        /**
+         * @brief nnz / (rows * cols)
+         */
+        float density() const;
+    };
+
+    /**
+     * @brief The nonzero entries of a dense matrix
+     *
+     * @param ld The row stride of W in floats
+     */
+    Csr from_dense(const float* W, size_t rows, size_t cols, size_t ld);
+
+    /**
+     * @brief Fraction of the entries of W that are not 0
+     */
+    float density(const float* W, size_t n);
+
+    /**
+     * @brief Copies the values at the pattern of csr from W, after W was
+     *        updated
+     */
+    void gather(const float* W, size_t ld, Csr& csr);
+
+    /**
+     * @brief C(MxN) = X(MxK) * W^T, W is N x K. Used by the forward pass.
+     */
+    void spmm_nt(size_t M, const float* X, size_t ldx, const Csr& W, \
+                                                    float* C, size_t ldc);
+
+    /**
+     * @brief C(MxK) = D(MxN) * W, W is N x K. Used to propagate the deltas.
+     */
+    void spmm_nn(size_t M, const float* D, size_t ldd, const Csr& W, \
+                                                    float* C, size_t ldc);
+
+    /**
+     * @brief dW += alpha * D(MxN)^T * X(MxK) only at the entries of the
+     *        pattern, the others are left as they are. dW is a dense
+     *        N x K matrix. Used for the weight gradient of pruned layers.
+     */
+    void sddmm_tn(size_t M, float alpha, const float* D, size_t ldd, \
+                const float* X, size_t ldx, const Csr& pattern, float* dW, \
+                                                                size_t lddw);
+
+    /**
+     * @brief Density below which spmm_nt beats the dense gemm_nt on this
+     *        machine, measured once on a 256x256 layer and a batch of 64
+     */
+    float crossover_density();
+}
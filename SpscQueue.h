@@ -0,0 +1,85 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  A bounded queue between exactly one producer thread and one consumer
+ *  thread, without locks. The producer only writes the tail and the
+ *  consumer only writes the head, each on its own cache line, so a push or
+ *  pop costs one release store and one acquire load. Used to pass the
+ *  micro-batches between the stages of the pipeline (see
+ *  NeuralNetwork::train_pipeline).
+ */
+
+#pragma once
+
+#include<atomic>
+#include<cstddef>
+#include<thread>
+#include<vector>
+
+template<typename T>
+class SpscQueue {
+    private:
+        struct alignas(64) Index {
+            std::atomic<size_t> value{0};
+        };
+        std::vector<T> items;
+        size_t mask = 0;
+        // items pushed and popped since the start, the slot of an item is
+        // its count modulo the capacity
+        Index head, tail;
+    public:
+        SpscQueue() = default;
+        SpscQueue(const SpscQueue&) = delete;
+        SpscQueue& operator=(const SpscQueue&) = delete;
+
+        /**
+         * @brief Empties the queue and makes room for at least capacity
+         *        items. Neither thread may use the queue meanwhile.
+         */
+        void reset(size_t capacity){
+            size_t size = 1;
+            while (size < capacity) size *= 2;
+            items.assign(size, T());
+            mask = size - 1;
+            head.value.store(0, std::memory_order_relaxed);
+            tail.value.store(0, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Producer side, false if the queue is full
+         */
+        bool try_push(const T& item){
+            size_t t = tail.value.load(std::memory_order_relaxed);
+            if (t - head.value.load(std::memory_order_acquire) > mask) {
+                return false;
+            }
+            items[t & mask] = item;
+            tail.value.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Consumer side, false if the queue is empty
+         */
+        bool try_pop(T& item){
+            size_t h = head.value.load(std::memory_order_relaxed);
+            if (h == tail.value.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = items[h & mask];
+            head.value.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * @brief Spin until there is room, yielding so that a thread
+         *        sharing the core can make it
+         */
+        void push(const T& item){
+            while (!try_push(item)) std::this_thread::yield();
+        }
+
+        void pop(T& item){
+            while (!try_pop(item)) std::this_thread::yield();
+        }
+};
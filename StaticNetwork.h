@@ -0,0 +1,269 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  A network whose topology is fixed at compile time, for small models
+ *  served one sample at a time, where the loops over runtime sizes and the
+ *  pointer chasing of InferenceModel cost more than the math. The sizes are
+ *  template arguments, StaticNetwork<16, 32, 4> is a 16-32-4 network, so
+ *  every loop has a constant trip count and the parameters and activations
+ *  live in std::arrays inside the object: no heap allocation at all.
+ *
+ *  The weights are kept transposed (input major), so every input adds a
+ *  scaled row of them to the outputs: no reduction. Layers with at most
+ *  UNROLL_LIMIT weights do it in loops the compiler fully unrolls, larger
+ *  ones with Kernels::packed_gemv, which keeps the outputs in vector
+ *  registers. The object holds all the parameters, so large networks
+ *  belong in static storage rather than on the stack.
+ */
+
+#pragma once
+
+#include"ActivationFuncs.h"
+#include"Arena.h"
+#include"Checkpoint.h"
+#include"Kernels.h"
+#include<algorithm>
+#include<array>
+#include<cmath>
+#include<cstddef>
+#include<cstring>
+#include<iostream>
+#include<string>
+#include<vector>
+
+namespace StaticLayout {
+    constexpr size_t round_up(size_t n){
+        return (n + Arena::ALIGN_FLOATS - 1) / Arena::ALIGN_FLOATS * \
+                                                        Arena::ALIGN_FLOATS;
+    }
+
+    // same layout as NeuralNetwork::getParameters(), layer by layer W then
+    // b, each padded to 64 bytes
+    template<size_t N>
+    constexpr size_t weights_offset(const std::array<size_t, N>& sizes, \
+                                                                size_t l){
+        size_t offset = 0;
+        for (size_t k = 1; k < l; k++){
+            offset += round_up(sizes[k] * sizes[k-1]) + round_up(sizes[k]);
+        }
+        return offset;
+    }
+
+    template<size_t N>
+    constexpr size_t widest_hidden(const std::array<size_t, N>& sizes){
+        size_t widest = 1;
+        for (size_t l = 1; l + 1 < N; l++){
+            widest = std::max(widest, sizes[l]);
+        }
+        return widest;
+    }
+}
+
+template<size_t... Sizes>
+class StaticNetwork {
+    public:
+        static constexpr size_t N_LAYERS = sizeof...(Sizes);
+        static_assert(N_LAYERS >= 2, "Need at least 2 layers");
+        static constexpr std::array<size_t, N_LAYERS> SIZES = {Sizes...};
+        static constexpr size_t INPUT_SIZE = SIZES.front();
+        static constexpr size_t OUTPUT_SIZE = SIZES.back();
+        static constexpr size_t N_PARAMETERS = \
+                                StaticLayout::weights_offset(SIZES, N_LAYERS);
+        // weights of the largest layer run by the unrolled loops, larger
+        // ones go to Kernels::packed_gemv
+        static constexpr size_t UNROLL_LIMIT = 256;
+        // rows with fewer outputs take the scalar softmax
+        static constexpr size_t SHORT_ROW = 16;
+
+    private:
+        using Buffer = std::array<float, StaticLayout::widest_hidden(SIZES)>;
+
+        static constexpr bool unrolled(size_t l){
+            return SIZES[l] * SIZES[l-1] <= UNROLL_LIMIT;
+        }
+
+        static constexpr size_t weights_offset(size_t l){
+            return StaticLayout::weights_offset(SIZES, l);
+        }
+
+        static constexpr size_t bias_offset(size_t l){
+            return weights_offset(l) + \
+                                StaticLayout::round_up(SIZES[l] * SIZES[l-1]);
+        }
+
+        alignas(Arena::ALIGNMENT) std::array<float, N_PARAMETERS> parameters{};
+        std::array<Activation, N_LAYERS> activations{};
+
+        template<typename Act, size_t N>
+        static void activate_as(float* z){
+            for (size_t i = 0; i < N; i++){
+                z[i] = Act::apply(z[i]);
+            }
+            if (Act::ROW_WISE) Act::apply_row(z, N);
+        }
+
+        /**
+         * @brief Softmax of a row shorter than one vector, where a few
+         *        std::exp cost less than the vector kernel
+         */
+        template<size_t N>
+        static void softmax_short(float* z){
+            float max = z[0];
+            for (size_t i = 1; i < N; i++) max = std::max(max, z[i]);
+            float sum = 0.0f;
+            for (size_t i = 0; i < N; i++){
+                z[i] = std::exp(z[i] - max);
+                sum += z[i];
+            }
+            float inv = 1.0f / sum;
+            for (size_t i = 0; i < N; i++) z[i] *= inv;
+        }
+
+        template<size_t N>
+        static void activate(Activation activation, float* z){
+            using namespace ActivationFuncs;
+            switch (activation){
+                case Activation::SIGMOID:
+                    activate_as<SigmoidPolicy, N>(z);
+                    break;
+                case Activation::TANH:
+                    activate_as<TanhPolicy, N>(z);
+                    break;
+                case Activation::SOFTMAX:
+                    if constexpr (N < SHORT_ROW) {
+                        softmax_short<N>(z);
+                    } else {
+                        activate_as<SoftmaxPolicy, N>(z);
+                    }
+                    break;
+                case Activation::IDENTITY:
+                    break;
+                case Activation::RELU:
+                default:
+                    activate_as<ReLUPolicy, N>(z);
+                    break;
+            }
+        }
+
+        /**
+         * @brief y = activation(W x + b) for layer L
+         */
+        template<size_t L>
+        void layer(const float* x, float* y) const {
+            constexpr size_t IN = SIZES[L-1], OUT = SIZES[L];
+            const float* W = parameters.data() + weights_offset(L);
+            const float* b = parameters.data() + bias_offset(L);
+            // W is IN x OUT, so every input adds a scaled row of it
+            if constexpr (unrolled(L)) {
+                // PARTS independent sums, so the adds of consecutive inputs
+                // do not wait for each other
+                constexpr size_t PARTS = 4;
+                float z[PARTS][OUT] = {};
+                size_t i = 0;
+                for (; i + PARTS <= IN; i += PARTS){
+                    for (size_t p = 0; p < PARTS; p++){
+                        const float* w = W + (i + p) * OUT;
+                        for (size_t o = 0; o < OUT; o++){
+                            z[p][o] += x[i + p] * w[o];
+                        }
+                    }
+                }
+                if constexpr (IN % PARTS != 0) {
+                    for (; i < IN; i++){
+                        for (size_t o = 0; o < OUT; o++){
+                            z[0][o] += x[i] * W[i * OUT + o];
+                        }
+                    }
+                }
+                for (size_t o = 0; o < OUT; o++){
+                    y[o] = b[o] + ((z[0][o] + z[1][o]) + (z[2][o] + z[3][o]));
+                }
+            } else {
+                for (size_t o = 0; o < OUT; o++) y[o] = b[o];
+                Kernels::active().packed_gemv(IN, OUT, x, W, y);
+            }
+            activate<OUT>(activations[L], y);
+        }
+
+        template<size_t L>
+        void forward(const float* x, float* y, Buffer (&buffers)[2]) const {
+            if constexpr (L + 1 == N_LAYERS) {
+                layer<L>(x, y);
+            } else {
+                float* next = buffers[L % 2].data();
+                layer<L>(x, next);
+                forward<L + 1>(next, y, buffers);
+            }
+        }
+
+    public:
+        /**
+         * @brief Copies the parameters of a network with the same sizes
+         *        (see NeuralNetwork::export_model)
+         *
+         * @param parameters The weights and bias of every layer, laid out
+         *                   like NeuralNetwork::getParameters()
+         */
+        int load(const std::vector<size_t>& sizes, \
+                        const std::vector<Activation>& activations, \
+                        const float* parameters){
+            if (sizes.size() != N_LAYERS || activations.size() != N_LAYERS \
+                    || !std::equal(sizes.begin(), sizes.end(), \
+                                            SIZES.begin()) || !parameters) {
+                std::cerr << "Error: The network does not have the sizes " \
+                                            "of the model." << std::endl;
+                return 0;
+            }
+            std::copy(activations.begin(), activations.end(), \
+                                                    this->activations.begin());
+            std::memcpy(this->parameters.data(), parameters, \
+                                                N_PARAMETERS * sizeof(float));
+            for (size_t l = 1; l < N_LAYERS; l++){
+                size_t in = SIZES[l-1], out = SIZES[l];
+                const float* W = parameters + weights_offset(l);
+                float* T = this->parameters.data() + weights_offset(l);
+                for (size_t o = 0; o < out; o++){
+                    for (size_t i = 0; i < in; i++){
+                        T[i * out + o] = W[o * in + i];
+                    }
+                }
+            }
+            return 1;
+        }
+
+        /**
+         * @brief Copies the parameters of a checkpoint (see Checkpoint.h)
+         *        with the same sizes
+         */
+        int load(const std::string& file_name){
+            Checkpoint checkpoint;
+            if (!checkpoint.open(file_name)) return 0;
+            if (checkpoint.getParameterSize() != N_PARAMETERS) {
+                std::cerr << "Error: " << file_name << " does not have the " \
+                                        "sizes of the model." << std::endl;
+                return 0;
+            }
+            return load(checkpoint.getSizes(), checkpoint.getActivations(), \
+                                                checkpoint.getParameters());
+        }
+
+        /**
+         * @brief Runs one sample through the network
+         *
+         * @param x INPUT_SIZE floats
+         * @param y OUTPUT_SIZE floats
+         */
+        void predict(const float* x, float* y) const {
+            Buffer buffers[2];
+            forward<1>(x, y, buffers);
+        }
+
+        /**
+         * @brief The index of the largest output for one sample
+         */
+        size_t predict_class(const float* x) const {
+            float y[OUTPUT_SIZE];
+            predict(x, y);
+            return std::max_element(y, y + OUTPUT_SIZE) - y;
+        }
+};
@@ -0,0 +1,114 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the ThreadPool class defined in ThreadPool.h
+ */
+
+#include"ThreadPool.h"
+#ifdef __linux__
+#include<pthread.h>
+#include<sched.h>
+#endif
+
+ThreadPool::ThreadPool(size_t n_threads, bool pin, size_t first_core){
+    if (n_threads == 0) n_threads = std::thread::hardware_concurrency();
+    if (n_threads == 0) n_threads = 1;
+    if (pin) pin_to_core(first_core);
+    for (size_t i = 1; i < n_threads; i++){
+        workers.emplace_back([this, pin, first_core, i](){
+            if (pin) pin_to_core(first_core + i);
+            worker_loop(i);
+        });
+    }
+}
+
+void ThreadPool::pin_to_core(size_t core){
+#ifdef __linux__
+    size_t n_cores = std::thread::hardware_concurrency();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(n_cores ? core % n_cores : 0, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)core;
+#endif
+}
+
+size_t ThreadPool::size() const {
+    return workers.size() + 1;
+}
+
+void ThreadPool::run_tasks(size_t index){
+    if (fixed) {
+        for (size_t task = index; task < n_tasks; task += size()){
+            (*job)(task);
+        }
+        return;
+    }
+    size_t task;
+    while ((task = next_task.fetch_add(1)) < n_tasks){
+        (*job)(task);
+    }
+}
+
+void ThreadPool::worker_loop(size_t index){
+    size_t seen = 0;
+    while (true){
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&](){ return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        run_tasks(index);
+        std::lock_guard<std::mutex> lock(mutex);
+        done_workers += 1;
+        if (done_workers == workers.size()) finished.notify_one();
+    }
+}
+
+void ThreadPool::run(size_t tasks, const std::function<void(size_t)>& task){
+    start(tasks, task, false);
+}
+
+void ThreadPool::run_static(size_t tasks, \
+                                    const std::function<void(size_t)>& task){
+    start(tasks, task, true);
+}
+
+void ThreadPool::start(size_t tasks, const std::function<void(size_t)>& task,\
+                                                                bool fixed){
+    if (workers.empty() || tasks == 1){
+        for (size_t i = 0; i < tasks; i++){
+            task(i);
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &task;
+        n_tasks = tasks;
+        next_task = 0;
+        done_workers = 0;
+        this->fixed = fixed;
+        generation += 1;
+    }
+    wake.notify_all();
+    run_tasks(0);
+    // every worker takes part in every run, so none of them can still be
+    // looking at this job when the next run() starts
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&](){ return done_workers == workers.size(); });
+    job = nullptr;
+}
+
+ThreadPool::~ThreadPool(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers){
+        t.join();
+    }
+}
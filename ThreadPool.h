@@ -0,0 +1,75 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  A pool of worker threads that live as long as the network, so starting
+ *  a parallel step costs a wake up instead of creating threads every batch.
+ */
+
+#pragma once
+
+#include<atomic>
+#include<condition_variable>
+#include<cstddef>
+#include<functional>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+class ThreadPool {
+    private:
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake, finished;
+        const std::function<void(size_t)>* job = nullptr;
+        size_t n_tasks = 0;
+        std::atomic<size_t> next_task{0};
+        size_t done_workers = 0;
+        size_t generation = 0;
+        bool stopping = false;
+        // tasks go to fixed threads instead of the first one free
+        bool fixed = false;
+
+        void worker_loop(size_t index);
+        void run_tasks(size_t index);
+        void start(size_t n_tasks, const std::function<void(size_t)>& task,\
+                                                                bool fixed);
+    public:
+        /**
+         * @brief Starts n_threads - 1 workers, the thread calling run() is
+         *        the last one
+         *
+         * @param n_threads Total number of threads, 0 means one per core
+         * @param pin Binds thread i (the caller is thread 0) to core
+         *        first_core + i, so the scheduler does not move them
+         *        between runs (Linux only)
+         */
+        ThreadPool(size_t n_threads=0, bool pin=false, size_t first_core=0);
+
+        /**
+         * @brief Binds the calling thread to one core (modulo the number of
+         *        cores), does nothing outside Linux
+         */
+        static void pin_to_core(size_t core);
+
+        /**
+         * @brief Gets the number of threads including the caller
+         */
+        size_t size() const;
+
+        /**
+         * @brief Calls task(i) for every i in [0, n_tasks) spread over the
+         *        threads and returns once all of them are done
+         */
+        void run(size_t n_tasks, const std::function<void(size_t)>& task);
+
+        /**
+         * @brief Same as run, but thread t (the caller is thread 0) always
+         *        runs tasks t, t + size(), t + 2*size()... So a task keeps
+         *        using the caches, and the NUMA node, of the same thread
+         *        from one run to the next.
+         */
+        void run_static(size_t n_tasks, \
+                                    const std::function<void(size_t)>& task);
+
+        ~ThreadPool();
+};
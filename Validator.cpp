@@ -0,0 +1,182 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Implementation of the Validator class defined in Validator.h
+ */
+
+#include"Validator.h"
+#include"Checkpoint.h"
+#include"CsvParser.h"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstring>
+#include<fstream>
+#include<iostream>
+
+namespace {
+    // samples run through the model at a time
+    constexpr size_t BATCH = 256;
+}
+
+int Validator::open(const std::string& file_name, ThreadPool& pool){
+    stop();
+    char magic[4] = {0, 0, 0, 0};
+    {
+        std::ifstream file(file_name, std::ios::binary);
+        if (!file) {
+            std::cerr << "Error: Could not open the file." << std::endl;
+            return 0;
+        }
+        file.read(magic, sizeof(magic));
+    }
+    if (std::memcmp(magic, "NNDS", 4) == 0) {
+        return data.open_binary(file_name);
+    }
+    std::vector<uint8_t> features, labels;
+    size_t n_features = 0;
+    long skipped = CsvParser::parse(file_name, pool, features, labels, \
+                                                                n_features);
+    if (skipped < 0) {
+        std::cerr << "Error: Could not open the file." << std::endl;
+        return 0;
+    }
+    if (skipped > 0) {
+        std::cerr << "Skipped " << skipped << " invalid rows" << std::endl;
+    }
+    return data.assign(std::move(features), std::move(labels), n_features);
+}
+
+void Validator::set_best_checkpoint(const std::string& file_name){
+    std::lock_guard<std::mutex> lock(mutex);
+    best_file = file_name;
+    has_best = false;
+}
+
+void Validator::reset(){
+    std::lock_guard<std::mutex> lock(mutex);
+    has_best = false;
+}
+
+void Validator::submit(const std::vector<size_t>& sizes, \
+                            const std::vector<Activation>& activations, \
+                            Cost cost, const float* parameters, \
+                            size_t n_parameters, size_t epochs){
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        // one validation is normally much shorter than one epoch, so this
+        // rarely waits, and it keeps a single snapshot in memory
+        idle.wait(lock, [this]{ return !busy && !has_pending; });
+        this->sizes = sizes;
+        this->activations = activations;
+        this->cost = cost;
+        snapshot.assign(parameters, parameters + n_parameters);
+        snapshot_epochs = epochs;
+        has_pending = true;
+        if (!worker.joinable()) {
+            stopping = false;
+            worker = std::thread(&Validator::run, this);
+        }
+    }
+    wake.notify_one();
+}
+
+void Validator::run(){
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true){
+        wake.wait(lock, [this]{ return has_pending || stopping; });
+        if (!has_pending) break;
+        has_pending = false;
+        busy = true;
+        lock.unlock();
+        ValidationResult result = evaluate();
+        lock.lock();
+        if (!best_file.empty() && (!has_best || result.loss < best_loss)) {
+            best_loss = result.loss;
+            has_best = true;
+            std::string target = best_file;
+            lock.unlock();
+            // submit waits while busy, so the snapshot can't change
+            Checkpoint::save(target, sizes, activations, snapshot.data(), \
+                                            snapshot.size(), snapshot_epochs);
+            lock.lock();
+        }
+        finished.push_back(result);
+        busy = false;
+        idle.notify_all();
+    }
+}
+
+ValidationResult Validator::evaluate(){
+    auto start = std::chrono::steady_clock::now();
+    ValidationResult result = {snapshot_epochs, 0.0f, 0.0f, 0.0};
+    size_t rows = data.getRows(), cols = data.getCols();
+    if (rows == 0 || cols != sizes.front() || \
+                            !model.view(sizes, activations, snapshot.data())) {
+        return result;
+    }
+    model.set_max_batch(BATCH);
+    size_t n_out = sizes.back();
+    inputs.resize(BATCH * cols);
+    outputs.resize(BATCH * n_out);
+    double total_loss = 0.0;
+    size_t correct = 0;
+    for (size_t first = 0; first < rows; first += BATCH){
+        size_t count = std::min(BATCH, rows - first);
+        const uint8_t* pixels = data.getRow(first);
+        for (size_t i = 0; i < count * cols; i++){
+            inputs[i] = pixels[i] / 255.0f;
+        }
+        model.predict(inputs.data(), count, outputs.data());
+        for (size_t r = 0; r < count; r++){
+            const float* y = outputs.data() + r * n_out;
+            size_t target = data.getLabel(first + r);
+            // same losses as the training, see CostFuncs.h
+            if (cost == Cost::CROSS_ENTROPY) {
+                if (target < n_out) {
+                    total_loss -= std::log(std::fmax(y[target], \
+                                            CostFuncs::MIN_PROBABILITY));
+                }
+            } else {
+                for (size_t i = 0; i < n_out; i++){
+                    float diff = y[i] - (i == target ? 1.0f : 0.0f);
+                    total_loss += diff * diff;
+                }
+            }
+            correct += (size_t)(std::max_element(y, y + n_out) - y) == target;
+        }
+    }
+    result.loss = (float)(total_loss / rows);
+    result.accuracy = (float)correct / rows;
+    result.seconds = std::chrono::duration<double>( \
+                            std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+void Validator::take_results(std::vector<ValidationResult>& results){
+    std::lock_guard<std::mutex> lock(mutex);
+    results.insert(results.end(), finished.begin(), finished.end());
+    finished.clear();
+}
+
+void Validator::stop(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    // the thread finishes a pending validation before it sees stopping
+    if (worker.joinable()) worker.join();
+}
+
+size_t Validator::getRows() const {
+    return data.getRows();
+}
+
+size_t Validator::getCols() const {
+    return data.getCols();
+}
+
+Validator::~Validator(){
+    stop();
+}
@@ -0,0 +1,111 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Validation on a held-out set while training goes on. submit() copies
+ *  the parameters to the one snapshot buffer and returns, a background
+ *  thread then runs the held-out samples through an InferenceModel that
+ *  reads the snapshot in place (no second copy) and measures their loss
+ *  and accuracy, while the trainer is already on the next epoch. The best
+ *  snapshot so far can be written as a checkpoint by the same thread.
+ */
+
+#pragma once
+
+#include"ActivationFuncs.h"
+#include"CostFuncs.h"
+#include"Dataset.h"
+#include"InferenceModel.h"
+#include"ThreadPool.h"
+#include<condition_variable>
+#include<cstddef>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
+
+struct ValidationResult {
+    size_t epochs;      // epochs trained when the snapshot was taken
+    float loss;         // mean over the samples
+    float accuracy;     // fraction of the samples classified right
+    double seconds;     // spent by the validation thread
+};
+
+class Validator {
+    private:
+        Dataset data;
+        std::vector<size_t> sizes;
+        std::vector<Activation> activations;
+        Cost cost = Cost::MSE;
+        // the only copy of the parameters, written by submit while the
+        // thread is idle, read by the thread otherwise
+        std::vector<float> snapshot;
+        size_t snapshot_epochs = 0;
+        std::string best_file;  // empty for no best checkpoint
+        float best_loss = 0.0f;
+        bool has_best = false;
+        bool has_pending = false, busy = false, stopping = false;
+        std::vector<ValidationResult> finished; // not taken yet
+        InferenceModel model;   // used by the thread only
+        std::vector<float> inputs, outputs;
+        std::mutex mutex;
+        std::condition_variable wake, idle;
+        std::thread worker;
+
+        void run();
+
+        /**
+         * @brief Loss and accuracy of the snapshot on all the samples
+         */
+        ValidationResult evaluate();
+    public:
+        Validator() = default;
+        Validator(const Validator&) = delete;
+        Validator& operator=(const Validator&) = delete;
+
+        /**
+         * @brief Loads the held-out samples, from a binary file written by
+         *        NeuralNetwork::save_input or else from a csv file (target
+         *        in the first column)
+         *
+         * @param pool The threads the csv is parsed with
+         */
+        int open(const std::string& file_name, ThreadPool& pool);
+
+        /**
+         * @brief Writes every snapshot whose loss is the lowest so far to a
+         *        checkpoint, empty turns it off. Forgets the best loss.
+         */
+        void set_best_checkpoint(const std::string& file_name);
+
+        /**
+         * @brief Forgets the best loss, for a new training run
+         */
+        void reset();
+
+        /**
+         * @brief Copies the parameters and starts validating them. Waits
+         *        for the previous validation if it is still running, so
+         *        there is never more than one snapshot.
+         */
+        void submit(const std::vector<size_t>& sizes, \
+                            const std::vector<Activation>& activations, \
+                            Cost cost, const float* parameters, \
+                            size_t n_parameters, size_t epochs);
+
+        /**
+         * @brief Moves the results finished since the last call to results,
+         *        in submit order
+         */
+        void take_results(std::vector<ValidationResult>& results);
+
+        /**
+         * @brief Finishes the validation still running and stops the
+         *        thread, submit starts it again
+         */
+        void stop();
+
+        size_t getRows() const;
+        size_t getCols() const;
+
+        ~Validator();
+};
@@ -0,0 +1,357 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Reproducible benchmark suite, built with `make bench_suite`.
+ *  Three levels of sweeps:
+ *      kernel - dot, gemm, the sparse gemm and the optimizer updates for
+ *               several sizes
+ *      layer  - the single sample and batched passes of MNIST shaped layers
+ *      epoch  - one training epoch on synthetic MNIST shaped data
+ *  Every case runs a few warmup repetitions first, then its timed ones are
+ *  summarized (min, median, mean, standard deviation, p90). The medians can
+ *  be saved as a baseline and later runs compared against it, a case
+ *  slower than the baseline by more than the tolerance is a regression and
+ *  makes the exit code 1.
+ *
+ *  Usage: bench_suite [--level kernel|layer|epoch|all] [--filter text]
+ *                     [--warmup n] [--reps n] [--threads n] [--pin]
+ *                     [--save file] [--compare file] [--tolerance 0.1]
+ */
+
+#include"Kernels.h"
+#include"Layer.h"
+#include"NeuralNetwork.h"
+#include"Sparse.h"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstdlib>
+#include<cstring>
+#include<fstream>
+#include<functional>
+#include<iomanip>
+#include<iostream>
+#include<map>
+#include<random>
+#include<sstream>
+#include<string>
+#include<vector>
+
+struct Options {
+    std::string level = "all";
+    std::string filter;
+    size_t warmup = 3;
+    size_t reps = 20;
+    size_t threads = 1;
+    bool pin = false;
+    std::string save, compare;
+    double tolerance = 0.1;
+};
+
+struct Result {
+    std::string name;
+    double min, median, mean, stddev, p90; // seconds per repetition
+    double work;                           // flops (or samples) per rep
+    const char* unit;
+};
+
+/**
+ * @brief Runs f warmup times, then times reps runs of it
+ */
+Result measure(const Options& opt, const std::string& name, double work, \
+                        const char* unit, const std::function<void()>& f){
+    for (size_t i = 0; i < opt.warmup; i++) f();
+    std::vector<double> times(opt.reps);
+    for (size_t i = 0; i < opt.reps; i++){
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+        times[i] = elapsed.count();
+    }
+    std::sort(times.begin(), times.end());
+    Result r;
+    r.name = name;
+    r.work = work;
+    r.unit = unit;
+    r.min = times.front();
+    r.median = times[times.size() / 2];
+    r.p90 = times[std::min(times.size() - 1, times.size() * 9 / 10)];
+    r.mean = 0.0;
+    for (double t : times) r.mean += t;
+    r.mean /= times.size();
+    r.stddev = 0.0;
+    for (double t : times) r.stddev += (t - r.mean) * (t - r.mean);
+    r.stddev = std::sqrt(r.stddev / times.size());
+    return r;
+}
+
+void print(const Result& r){
+    std::cout << std::left << std::setw(34) << r.name << std::right << \
+        std::fixed << std::setprecision(4) << \
+        std::setw(11) << r.median * 1e3 << std::setw(11) << r.mean * 1e3 << \
+        std::setw(10) << r.stddev * 1e3 << std::setw(11) << r.min * 1e3 << \
+        std::setw(11) << r.p90 * 1e3 << std::setw(12) << \
+        std::setprecision(2) << r.work / r.median * 1e-9 << " " << r.unit << \
+        std::defaultfloat << "\n";
+}
+
+void fill(std::vector<float>& v, float low, float high){
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> distr(low, high);
+    for (float& x : v) x = distr(gen);
+}
+
+void kernel_level(const Options& opt, std::vector<Result>& results){
+    const Kernels::KernelTable& kt = Kernels::active();
+    for (size_t n : {256, 4096, 65536}){
+        std::vector<float> a(n), b(n);
+        fill(a, -1.0f, 1.0f);
+        fill(b, -1.0f, 1.0f);
+        volatile float sink = 0.0f;
+        results.push_back(measure(opt, "kernel/dot/" + std::to_string(n), \
+                        2.0 * n * 100, "GFLOP/s", [&](){
+            for (size_t r = 0; r < 100; r++){
+                sink = sink + kt.dot(a.data(), b.data(), n);
+            }
+        }));
+    }
+    // forward pass shapes: batch x neurons x inputs
+    size_t shapes[][3] = {{64, 128, 784}, {64, 10, 128}, {256, 256, 256}};
+    for (auto& s : shapes){
+        size_t M = s[0], N = s[1], K = s[2];
+        std::vector<float> A(M * K), B(N * K), C(M * N);
+        fill(A, 0.0f, 1.0f);
+        fill(B, -0.1f, 0.1f);
+        std::string name = "kernel/gemm_nt/" + std::to_string(M) + "x" + \
+                            std::to_string(N) + "x" + std::to_string(K);
+        results.push_back(measure(opt, name, 2.0 * M * N * K, "GFLOP/s", \
+                                                                    [&](){
+            Kernels::gemm_nt(M, N, K, A.data(), K, B.data(), K, C.data(), N);
+        }));
+        // the same product in mixed precision (Precision::BF16)
+        std::vector<Kernels::bf16> A16(M * K), B16(N * K);
+        Kernels::to_bf16(M * K, A.data(), A16.data());
+        Kernels::to_bf16(N * K, B.data(), B16.data());
+        name = "kernel/gemm_nt_bf16/" + std::to_string(M) + "x" + \
+                            std::to_string(N) + "x" + std::to_string(K);
+        results.push_back(measure(opt, name, 2.0 * M * N * K, "GFLOP/s", \
+                                                                    [&](){
+            Kernels::gemm_nt(M, N, K, A16.data(), K, B16.data(), K, C.data(),\
+                                        N, [](float*, size_t, size_t){});
+        }));
+        // and with 90% of the weights pruned (see Sparse.h), the useful
+        // flops only
+        std::vector<float> pruned(B);
+        for (size_t i = 0; i < pruned.size(); i++){
+            if (i % 10 != 0) pruned[i] = 0.0f;
+        }
+        Sparse::Csr csr = Sparse::from_dense(pruned.data(), N, K, K);
+        name = "kernel/spmm_nt_10pct/" + std::to_string(M) + "x" + \
+                            std::to_string(N) + "x" + std::to_string(K);
+        results.push_back(measure(opt, name, 2.0 * M * csr.nnz(), \
+                                                    "GFLOP/s", [&](){
+            Sparse::spmm_nt(M, A.data(), K, csr, C.data(), N);
+        }));
+    }
+    for (size_t n : {4096, 1 << 20}){
+        std::vector<float> param(n), grad(n), m(n), v(n);
+        fill(param, -0.1f, 0.1f);
+        results.push_back(measure(opt, "kernel/sgd_step/" + \
+            std::to_string(n), 4.0 * n * sizeof(float), "GB/s", [&](){
+            kt.sgd_step(n, -0.01f, grad.data(), param.data());
+        }));
+        Kernels::AdamStep step = {1.0f, 0.9f, 0.999f, 1e-8f, 0.001f, \
+                                                            1.0f, 1.0f};
+        results.push_back(measure(opt, "kernel/adam_step/" + \
+            std::to_string(n), 8.0 * n * sizeof(float), "GB/s", [&](){
+            kt.adam_step(n, step, grad.data(), m.data(), v.data(), \
+                                                            param.data());
+        }));
+    }
+}
+
+void layer_level(const Options& opt, std::vector<Result>& results){
+    // a 784-128-10 network, the passes of its hidden and output layer
+    Layer x(784), h(x, 128, 0.0f), o(h, 10, 0.0f);
+    std::vector<float> sample(784), grad(10 * 64);
+    fill(sample, 0.0f, 1.0f);
+    fill(grad, -0.1f, 0.1f);
+    x.setNeurons(sample.data(), 784);
+    double flops = 2.0 * (784 * 128 + 128 * 10);
+    results.push_back(measure(opt, "layer/forward_pass/784-128-10", flops, \
+                                                        "GFLOP/s", [&](){
+        h.forward_pass(x);
+        o.forward_pass(h);
+    }));
+    // deltas, hidden delta and both weight gradients
+    double back_flops = 2.0 * (128 * 10 + 784 * 128 + 128 * 10);
+    results.push_back(measure(opt, "layer/backward_pass/784-128-10", \
+                                        back_flops, "GFLOP/s", [&](){
+        o.backward_pass(grad.data(), h);
+        h.backward_pass(o, x);
+    }));
+
+    const size_t batch = 64;
+    Layer xb(784), hb(xb, 128, 0.0f), ob(hb, 10, 0.0f);
+    xb.setBatchSize(batch);
+    hb.setBatchSize(batch);
+    ob.setBatchSize(batch);
+    std::vector<float> samples(784 * batch);
+    fill(samples, 0.0f, 1.0f);
+    xb.setNeurons(samples.data(), samples.size());
+    results.push_back(measure(opt, "layer/forward_pass_batch/64", \
+                                    flops * batch, "GFLOP/s", [&](){
+        hb.forward_pass_batch(xb);
+        ob.forward_pass_batch(hb);
+    }));
+    results.push_back(measure(opt, "layer/backward_pass_batch/64", \
+                                    back_flops * batch, "GFLOP/s", [&](){
+        ob.backward_pass_batch(grad.data(), hb);
+        hb.backward_pass_batch(ob, xb);
+    }));
+}
+
+void epoch_level(const Options& opt, std::vector<Result>& results){
+    // random pixels and labels, nothing to download
+    const size_t n = 10000;
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> pixel(0, 255), label(0, 9);
+    std::vector<uint8_t> inputs(n * 784), targets(n);
+    for (uint8_t& p : inputs) p = pixel(gen);
+    for (uint8_t& t : targets) t = label(gen);
+    for (size_t batch : {32, 256}){
+        NeuralNetwork nn(0.001f);
+        nn.add_layer(784);
+        nn.add_layer(128);
+        nn.add_layer(10);
+        nn.set_data(inputs, targets, 784);
+        nn.set_batch_size(batch);
+        nn.set_threads(opt.threads, opt.pin);
+        // train prints the loss of every epoch, keep the table readable
+        std::stringstream discard;
+        std::streambuf* out = std::cout.rdbuf(discard.rdbuf());
+        Result r = measure(opt, "epoch/784-128-10/batch" + \
+                std::to_string(batch), n, "Msamples/s", [&](){
+            nn.train(1);
+        });
+        std::cout.rdbuf(out);
+        r.work *= 1e3; // printed in millions of samples
+        results.push_back(r);
+    }
+}
+
+/**
+ * @brief Reads a baseline written by --save: name,median per line
+ */
+std::map<std::string, double> read_baseline(const std::string& file_name){
+    std::map<std::string, double> baseline;
+    std::ifstream file(file_name);
+    std::string line;
+    while (std::getline(file, line)){
+        size_t comma = line.find(',');
+        if (comma == std::string::npos || line.compare(0, 4, "name") == 0) {
+            continue;
+        }
+        baseline[line.substr(0, comma)] = std::atof(line.c_str() + comma + 1);
+    }
+    return baseline;
+}
+
+bool parse_options(int argc, char** argv, Options& opt){
+    for (int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--pin") {
+            opt.pin = true;
+        } else if (arg == "--level" && has_value) {
+            opt.level = argv[++i];
+        } else if (arg == "--filter" && has_value) {
+            opt.filter = argv[++i];
+        } else if (arg == "--warmup" && has_value) {
+            opt.warmup = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--reps" && has_value) {
+            opt.reps = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, \
+                                                                        10));
+        } else if (arg == "--threads" && has_value) {
+            opt.threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--save" && has_value) {
+            opt.save = argv[++i];
+        } else if (arg == "--compare" && has_value) {
+            opt.compare = argv[++i];
+        } else if (arg == "--tolerance" && has_value) {
+            opt.tolerance = std::atof(argv[++i]);
+        } else {
+            std::cerr << "Error: Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv){
+    Options opt;
+    if (!parse_options(argc, argv, opt)) return 2;
+    // the kernel and layer cases run on the calling thread
+    if (opt.pin) ThreadPool::pin_to_core(0);
+    std::cout << "kernels: " << Kernels::active().name << ", warmup " << \
+        opt.warmup << ", reps " << opt.reps << ", threads " << opt.threads \
+        << (opt.pin ? " (pinned)" : "") << "\n";
+    std::cout << std::left << std::setw(34) << "case (ms per rep)" << \
+        std::right << std::setw(11) << "median" << std::setw(11) << "mean" \
+        << std::setw(10) << "stddev" << std::setw(11) << "min" << \
+        std::setw(11) << "p90" << std::setw(12) << "throughput" << "\n";
+
+    std::vector<Result> results;
+    if (opt.level == "all" || opt.level == "kernel") {
+        kernel_level(opt, results);
+    }
+    if (opt.level == "all" || opt.level == "layer") {
+        layer_level(opt, results);
+    }
+    if (opt.level == "all" || opt.level == "epoch") {
+        epoch_level(opt, results);
+    }
+    if (!opt.filter.empty()) {
+        results.erase(std::remove_if(results.begin(), results.end(), \
+            [&](const Result& r){
+                return r.name.find(opt.filter) == std::string::npos;
+            }), results.end());
+    }
+    for (const Result& r : results) print(r);
+
+    if (!opt.save.empty()) {
+        std::ofstream file(opt.save);
+        file << "name,median_seconds,mean_seconds,stddev_seconds\n";
+        file << std::setprecision(9);
+        for (const Result& r : results){
+            file << r.name << "," << r.median << "," << r.mean << "," << \
+                                                        r.stddev << "\n";
+        }
+        std::cout << "Saved baseline to " << opt.save << "\n";
+    }
+
+    int regressions = 0;
+    if (!opt.compare.empty()) {
+        std::map<std::string, double> baseline = read_baseline(opt.compare);
+        if (baseline.empty()) {
+            std::cerr << "Error: No baseline in " << opt.compare << std::endl;
+            return 2;
+        }
+        std::cout << "\nAgainst " << opt.compare << " (tolerance " << \
+                                    opt.tolerance * 100 << "%)\n";
+        for (const Result& r : results){
+            auto it = baseline.find(r.name);
+            if (it == baseline.end()) continue;
+            double ratio = r.median / it->second;
+            bool slower = ratio > 1.0 + opt.tolerance;
+            regressions += slower;
+            std::cout << std::left << std::setw(34) << r.name << std::right \
+                << std::fixed << std::setprecision(3) << std::setw(8) << \
+                ratio << "x" << (slower ? "  REGRESSION" : "") << \
+                std::defaultfloat << "\n";
+        }
+        std::cout << regressions << " regression(s)\n";
+    }
+    return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,1127 @@
+/**
+ *  Author - Satyam Gupta
+ *  Date - 10/16/26
+ *  Benchmarks, enable the ones to run in main()
+ */
+#include"InferenceModel.h"
+#include"Layer.h"
+#include"Kernels.h"
+#include"NeuralNetwork.h"
+#include"Optimizer.h"
+#include"QuantizedModel.h"
+#include"Sparse.h"
+#include"StaticNetwork.h"
+#include<algorithm>
+#include<chrono>
+#include<cstdio>
+#include<fstream>
+#include<sstream>
+#include<iostream>
+#include<random>
+#include<vector>
+
+inline void fill_random(float* arr, size_t size, float low=0.0f, \
+                                                        float high=1.0f){
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> distr(low, high);
+    for (size_t i = 0; i < size; i++){
+        arr[i] = distr(gen);
+    }
+}
+
+/**
+ * @brief Training throughput of a 784-128-10 network for batch sizes 1-256.
+ *        The first row is the one sample at a time path for reference.
+ */
+int batch_size_benchmark(){
+    const size_t n_samples = 4096;
+    const float learning_rate = 0.01f;
+    std::vector<float> data(n_samples * 784), grad(256 * 10);
+    fill_random(data.data(), data.size());
+    fill_random(grad.data(), grad.size(), -0.1f, 0.1f);
+
+    Layer x(784), h1(x, 128), o(h1, 10);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t s = 0; s < n_samples; s++){
+        x.setNeurons(data.data() + s*784, 784);
+        h1.forward_pass(x);
+        o.forward_pass(h1);
+        o.backward_pass(grad.data(), h1);
+        h1.backward_pass(o, x);
+        o.apply_gradients(learning_rate);
+        h1.apply_gradients(learning_rate);
+    }
+    std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+    std::cout << "single sample: " << n_samples / elapsed.count() \
+                                                << " samples/sec\n";
+
+    for (size_t batch = 1; batch <= 256; batch *= 2){
+        x.setBatchSize(batch);
+        h1.setBatchSize(batch);
+        o.setBatchSize(batch);
+        start = std::chrono::steady_clock::now();
+        for (size_t s = 0; s + batch <= n_samples; s += batch){
+            x.setNeurons(data.data() + s*784, batch*784);
+            h1.forward_pass_batch(x);
+            o.forward_pass_batch(h1);
+            o.backward_pass_batch(grad.data(), h1);
+            h1.backward_pass_batch(o, x);
+            o.apply_gradients(learning_rate, batch);
+            h1.apply_gradients(learning_rate, batch);
+        }
+        elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "batch " << batch << ": " << \
+                    n_samples / elapsed.count() << " samples/sec\n";
+    }
+    return 1;
+}
+
+// Mirrors Layer::debug so the legacy loops keep their branches
+bool legacy_debug = false;
+
+float legacy_dot(const float* weights, const float* input, size_t n){
+    float sum = 0;
+    for (size_t j = 0; j < n; j++){
+        if (legacy_debug) std::cout << weights[j] << "x" << input[j] << " + ";
+        sum += weights[j] * input[j];
+    }
+    return sum;
+}
+
+void legacy_update(size_t m, size_t n, float learning_rate, \
+        const float* delta, const float* input, const float* weights, \
+                                                        float* new_weights){
+    for (size_t i = 0; i < m; i++){
+        for (size_t j = 0; j < n; j++){
+            if (legacy_debug) std::cout << weights[i*n + j] << "\n";
+            new_weights[i*n + j] = weights[i*n + j] - \
+                                        learning_rate*delta[i]*input[j];
+            if (legacy_debug) std::cout << new_weights[i*n + j] << "\n";
+        }
+    }
+}
+
+template<typename F>
+double time_ns(F f, size_t reps){
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < reps; r++){
+        f();
+    }
+    std::chrono::duration<double, std::nano> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+    return elapsed.count() / reps;
+}
+
+/**
+ * @brief Time per call of every kernel variant supported by this CPU against
+ *        the loops Layer used before the kernels (with the debug branches)
+ */
+int kernel_isa_benchmark(){
+    const size_t m = 128, n = 784, reps = 2000;
+    std::vector<float> a(n), b(n), x(m), A(m * n), A_out(m * n);
+    fill_random(a.data(), n);
+    fill_random(b.data(), n);
+    fill_random(x.data(), m);
+    fill_random(A.data(), m * n);
+    volatile float sink = 0;
+
+    double dot_ns = time_ns([&](){ sink = legacy_dot(a.data(), b.data(), n); },\
+                                                                    reps);
+    double upd_ns = time_ns([&](){
+        legacy_update(m, n, 0.01f, x.data(), b.data(), A.data(), A_out.data());
+    }, reps / 10);
+    std::cout << "legacy  dot(" << n << "): " << dot_ns << " ns, update(" \
+            << m << "x" << n << "): " << upd_ns << " ns\n";
+
+    for (Kernels::Isa isa : {Kernels::Isa::SCALAR, Kernels::Isa::AVX2, \
+                            Kernels::Isa::AVX512, Kernels::Isa::NEON}){
+        const Kernels::KernelTable* kt = Kernels::table(isa);
+        if (kt == nullptr) continue;
+        double d = time_ns([&](){ sink = kt->dot(a.data(), b.data(), n); }, \
+                                                                    reps);
+        double ax = time_ns([&](){ kt->axpy(n, 0.5f, a.data(), b.data()); }, \
+                                                                    reps);
+        double r1 = time_ns([&](){
+            kt->rank1_update(m, n, -0.01f, x.data(), b.data(), A.data(), n);
+        }, reps / 10);
+        std::cout << kt->name << " dot: " << d << " ns (" << dot_ns / d << \
+            "x), axpy: " << ax << " ns, rank1 update: " << r1 << " ns (" << \
+                                                    upd_ns / r1 << "x)\n";
+    }
+    (void)sink;
+    return 1;
+}
+
+/**
+ * @brief Random MNIST shaped samples, so no download is needed
+ */
+void make_synthetic_mnist(std::vector<uint8_t>& inputs, \
+                                    std::vector<uint8_t>& targets, size_t n){
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> pixel(0, 255), label(0, 9);
+    inputs.resize(n * 784);
+    targets.resize(n);
+    for (uint8_t& p : inputs) p = pixel(gen);
+    for (uint8_t& t : targets) t = label(gen);
+}
+
+/**
+ * @brief MNIST shaped samples that can be learned, every class is a random
+ *        prototype image plus noise
+ */
+void make_learnable_mnist(std::vector<uint8_t>& inputs, \
+                                    std::vector<uint8_t>& targets, size_t n){
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<int> pixel(0, 255), noise(-60, 60);
+    std::vector<uint8_t> prototypes(10 * 784);
+    for (uint8_t& p : prototypes) p = pixel(gen);
+    for (size_t s = 0; s < n; s++){
+        size_t target = s % 10;
+        for (size_t j = 0; j < 784; j++){
+            int p = prototypes[target*784 + j] + noise(gen);
+            inputs.push_back(std::min(255, std::max(0, p)));
+        }
+        targets.push_back(target);
+    }
+}
+
+/**
+ * @brief Epoch time of NeuralNetwork::train for 1 to 32 threads
+ */
+int thread_scaling_benchmark(){
+    std::vector<uint8_t> inputs, targets;
+    make_synthetic_mnist(inputs, targets, 8192);
+    double base = 0;
+    for (size_t threads = 1; threads <= 32; threads *= 2){
+        NeuralNetwork nn(0.001f);
+        nn.add_layer(784);
+        nn.add_layer(128);
+        nn.add_layer(10);
+        nn.set_data(inputs, targets, 784);
+        nn.set_batch_size(256);
+        nn.set_threads(threads);
+        auto start = std::chrono::steady_clock::now();
+        nn.train(1);
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+        if (threads == 1) base = elapsed.count();
+        std::cout << threads << " threads: " << elapsed.count() << \
+            " s/epoch, speedup " << base / elapsed.count() << "x\n";
+    }
+    return 1;
+}
+
+/**
+ * @brief Writes n random MNIST shaped rows as a csv, used when the real
+ *        mnist_train.csv is not around
+ */
+void write_synthetic_csv(const std::string& file_name, size_t n){
+    std::vector<uint8_t> inputs, targets;
+    make_synthetic_mnist(inputs, targets, n);
+    std::ofstream out(file_name);
+    out << "label";
+    for (size_t j = 0; j < 784; j++) out << ",pixel" << j;
+    out << "\n";
+    for (size_t s = 0; s < n; s++){
+        out << (int)targets[s];
+        for (size_t j = 0; j < 784; j++) out << "," << (int)inputs[s*784 + j];
+        out << "\n";
+    }
+}
+
+/**
+ * @brief Startup time of the csv parser against mapping the binary file
+ */
+int load_benchmark(){
+    std::string csv = "mnist_train.csv";
+    if (!std::ifstream(csv).good()){
+        csv = "synthetic_train.csv";
+        write_synthetic_csv(csv, 60000);
+    }
+    NeuralNetwork nn;
+    auto start = std::chrono::steady_clock::now();
+    nn.read_input(csv);
+    std::chrono::duration<double> csv_time = \
+                                    std::chrono::steady_clock::now() - start;
+    nn.save_input("train.bin");
+
+    NeuralNetwork mapped;
+    start = std::chrono::steady_clock::now();
+    mapped.read_binary("train.bin");
+    std::chrono::duration<double> bin_time = \
+                                    std::chrono::steady_clock::now() - start;
+    std::cout << csv << ": read_input " << csv_time.count() << \
+        " s, read_binary " << bin_time.count() << " s\n";
+    std::remove("train.bin");
+    return 1;
+}
+
+/**
+ * @brief The csv loader NeuralNetwork::read_input used before CsvParser
+ */
+size_t legacy_read_csv(const std::string& file_name, \
+        std::vector<std::vector<int>>& inputs, std::vector<int>& targets){
+    std::ifstream input_file(file_name);
+    std::string line;
+    std::getline(input_file, line); //ignore the header line
+    while (std::getline(input_file, line)) {
+        std::stringstream ss(line);
+        std::string field;
+        std::vector<int> current_row_inputs;
+        bool is_first_column = true;
+        while (std::getline(ss, field, ',')) {
+            try {
+                int value = std::stoi(field);
+                if (is_first_column) {
+                    targets.push_back(value);
+                    is_first_column = false;
+                } else {
+                    current_row_inputs.push_back(value);
+                }
+            } catch (const std::exception& e) {
+                continue;
+            }
+        }
+        if (!current_row_inputs.empty()) {
+            inputs.push_back(current_row_inputs);
+        }
+    }
+    return inputs.size();
+}
+
+/**
+ * @brief Parse throughput of the old loader, CsvParser and a plain read of
+ *        the file (the disk / page cache bandwidth) in MB/s
+ */
+int csv_parse_benchmark(){
+    std::string csv = "mnist_train.csv";
+    if (!std::ifstream(csv).good()){
+        csv = "synthetic_train.csv";
+        write_synthetic_csv(csv, 60000);
+    }
+    std::ifstream file(csv, std::ios::binary | std::ios::ate);
+    double mb = file.tellg() / 1e6;
+
+    std::vector<char> block(1 << 20);
+    auto start = std::chrono::steady_clock::now();
+    file.seekg(0);
+    while (file.read(block.data(), block.size()) || file.gcount() > 0) {}
+    std::chrono::duration<double> read_time = \
+                                    std::chrono::steady_clock::now() - start;
+
+    std::vector<std::vector<int>> inputs;
+    std::vector<int> targets;
+    start = std::chrono::steady_clock::now();
+    legacy_read_csv(csv, inputs, targets);
+    std::chrono::duration<double> legacy_time = \
+                                    std::chrono::steady_clock::now() - start;
+
+    NeuralNetwork nn;
+    start = std::chrono::steady_clock::now();
+    nn.read_input(csv);
+    std::chrono::duration<double> parse_time = \
+                                    std::chrono::steady_clock::now() - start;
+    std::cout << csv << " (" << mb << " MB): read " << \
+        mb / read_time.count() << " MB/s, legacy loader " << \
+        mb / legacy_time.count() << " MB/s, CsvParser " << \
+        mb / parse_time.count() << " MB/s\n";
+    return 1;
+}
+
+/**
+ * @brief Epoch time of train on loaded data against train_stream, which
+ *        prints how much of each epoch was spent waiting on the loader
+ */
+int stream_benchmark(){
+    std::vector<uint8_t> inputs, targets;
+    make_synthetic_mnist(inputs, targets, 16384);
+    NeuralNetwork nn(0.001f);
+    nn.add_layer(784);
+    nn.add_layer(128);
+    nn.add_layer(10);
+    nn.set_data(inputs, targets, 784);
+    nn.set_batch_size(256);
+    nn.save_input("stream.bin");
+
+    auto start = std::chrono::steady_clock::now();
+    nn.train(2);
+    std::chrono::duration<double> in_memory = \
+                                    std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    nn.train_stream("stream.bin", 2, 4);
+    std::chrono::duration<double> streamed = \
+                                    std::chrono::steady_clock::now() - start;
+    std::cout << "in memory: " << in_memory.count() / 2 << " s/epoch, " \
+        << "streamed: " << streamed.count() / 2 << " s/epoch\n";
+    std::remove("stream.bin");
+    return 1;
+}
+
+/**
+ * @brief Parameters updated per second by every optimizer, for every
+ *        instruction set, on the parameter count of a 784-128-10 network
+ */
+int optimizer_benchmark(){
+    const size_t n = 784*128 + 128 + 128*10 + 10, reps = 200;
+    std::vector<float> param(n), grad(n), m(n), v(n);
+    fill_random(param.data(), n, -0.1f, 0.1f);
+    Kernels::AdamStep adam = {1.0f / 256, 0.9f, 0.999f, 1e-8f, 0.001f, \
+                                                            1.0f, 1.0f};
+    for (Kernels::Isa isa : {Kernels::Isa::SCALAR, Kernels::Isa::AVX2, \
+                            Kernels::Isa::AVX512, Kernels::Isa::NEON}){
+        const Kernels::KernelTable* kt = Kernels::table(isa);
+        if (kt == nullptr) continue;
+        double sgd = time_ns([&](){
+            kt->sgd_step(n, -0.01f, grad.data(), param.data());
+        }, reps);
+        double momentum = time_ns([&](){
+            kt->momentum_step(n, 0.01f, 0.9f, 1.0f / 256, grad.data(), \
+                                                    m.data(), param.data());
+        }, reps);
+        double adam_ns = time_ns([&](){
+            kt->adam_step(n, adam, grad.data(), m.data(), v.data(), \
+                                                            param.data());
+        }, reps);
+        // floats read and written per parameter: 4, 6 and 8
+        std::cout << kt->name << " Mparams/s (GB/s): sgd " << n / sgd * 1e3 \
+            << " (" << n * 16 / sgd << "), momentum " << n / momentum * 1e3 \
+            << " (" << n * 24 / momentum << "), adam " << n / adam_ns * 1e3 \
+            << " (" << n * 32 / adam_ns << ")\n";
+    }
+    return 1;
+}
+
+/**
+ * @brief Loss per epoch of every optimizer on mnist_train.csv, or on
+ *        noisy copies of one random image per class when it is not around
+ */
+int optimizer_convergence_benchmark(){
+    std::vector<uint8_t> inputs, targets;
+    NeuralNetwork loader;
+    if (std::ifstream("mnist_train.csv").good()){
+        loader.read_input("mnist_train.csv");
+        loader.save_input("convergence.bin");
+    } else {
+        make_learnable_mnist(inputs, targets, 20000);
+        loader.set_data(inputs, targets, 784);
+        loader.save_input("convergence.bin");
+    }
+
+    const char* names[] = {"sgd", "momentum", "adam", "adamw"};
+    OptimizerType types[] = {OptimizerType::SGD, OptimizerType::MOMENTUM, \
+                            OptimizerType::ADAM, OptimizerType::ADAMW};
+    // momentum 0.9 takes 10x larger steps than sgd for the same rate
+    float rates[] = {0.01f, 0.001f, 0.001f, 0.001f};
+    for (size_t o = 0; o < 4; o++){
+        OptimizerConfig config;
+        config.type = types[o];
+        config.learning_rate = rates[o];
+        NeuralNetwork nn;
+        nn.add_layer(784);
+        nn.add_layer(128);
+        nn.add_layer(10);
+        nn.read_binary("convergence.bin");
+        nn.set_batch_size(64);
+        nn.set_optimizer(config);
+        std::cout << names[o] << " (learning rate " << rates[o] << ")\n";
+        auto start = std::chrono::steady_clock::now();
+        nn.train(5);
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+        std::cout << names[o] << ": " << elapsed.count() / 5 << " s/epoch\n";
+    }
+    std::remove("convergence.bin");
+    return 1;
+}
+
+/**
+ * @brief Forward pass of a 784-128 layer on a batch of 256 for every
+ *        activation, against the hardcoded ReLU pass Layer had before
+ *        (the product first, then a second loop for the bias and ReLU)
+ */
+int activation_benchmark(){
+    const size_t batch = 256, in = 784, n = 128, reps = 50;
+    std::vector<float> data(batch * in), out(batch * n);
+    fill_random(data.data(), data.size());
+    Layer x(in), h(x, n);
+    const float* w = h.getWeights();
+    const float* b = h.getBias();
+    double legacy = time_ns([&](){
+        Kernels::gemm_nt(batch, n, in, data.data(), in, w, in, out.data(), n);
+        for (size_t r = 0; r < batch; r++){
+            float* z = out.data() + r*n;
+            for (size_t i = 0; i < n; i++){
+                z[i] = ActivationFuncs::ReLU(z[i] + b[i]);
+            }
+        }
+    }, reps);
+    std::cout << "hardcoded relu: " << legacy / 1e3 << " us\n";
+
+    Activation types[] = {Activation::RELU, Activation::IDENTITY, \
+                Activation::SIGMOID, Activation::TANH, Activation::SOFTMAX};
+    const char* names[] = {"relu", "identity", "sigmoid", "tanh", "softmax"};
+    for (size_t a = 0; a < 5; a++){
+        h.setActivation(types[a]);
+        double t = time_ns([&](){
+            h.forward(data.data(), out.data(), batch);
+        }, reps);
+        std::cout << names[a] << ": " << t / 1e3 << " us (" << \
+                                    legacy / t << "x the hardcoded relu)\n";
+    }
+    return 1;
+}
+
+/**
+ * @brief p50/p99 latency and throughput of InferenceModel::predict on a
+ *        784-128-10 network for batches of 1, 8 and 64
+ */
+int inference_benchmark(){
+    const size_t reps = 2000;
+    NeuralNetwork nn;
+    nn.add_layer(784);
+    nn.add_layer(128);
+    nn.add_layer(10, Activation::SOFTMAX);
+    InferenceModel model;
+    nn.export_model(model);
+    std::vector<float> X(64 * 784), out(64 * 10);
+    fill_random(X.data(), X.size());
+    for (size_t batch : {1, 8, 64}){
+        model.set_max_batch(batch);
+        std::vector<double> latencies(reps);
+        auto begin = std::chrono::steady_clock::now();
+        for (size_t r = 0; r < reps; r++){
+            auto start = std::chrono::steady_clock::now();
+            model.predict(X.data(), batch, out.data());
+            std::chrono::duration<double, std::micro> elapsed = \
+                                std::chrono::steady_clock::now() - start;
+            latencies[r] = elapsed.count();
+        }
+        std::chrono::duration<double> total = \
+                                std::chrono::steady_clock::now() - begin;
+        std::sort(latencies.begin(), latencies.end());
+        std::cout << "batch " << batch << ": p50 " << latencies[reps / 2] \
+            << " us, p99 " << latencies[reps * 99 / 100] << " us, " << \
+            batch * reps / total.count() << " samples/sec\n";
+    }
+    return 1;
+}
+
+/**
+ * @brief Save and load times of a checkpoint of a 784-2048-2048-10 network
+ *        (about 24MB), and the cost of checkpointing every epoch
+ */
+int checkpoint_benchmark(){
+    NeuralNetwork nn(0.001f);
+    nn.add_layer(784);
+    nn.add_layer(2048);
+    nn.add_layer(2048);
+    nn.add_layer(10);
+    auto start = std::chrono::steady_clock::now();
+    nn.save_checkpoint("bench.ckpt");
+    std::chrono::duration<double, std::milli> save = \
+                                    std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    InferenceModel model;
+    model.load("bench.ckpt");
+    std::chrono::duration<double, std::milli> mapped = \
+                                    std::chrono::steady_clock::now() - start;
+    std::vector<float> X(784), out(10);
+    fill_random(X.data(), X.size());
+    start = std::chrono::steady_clock::now();
+    model.predict(X.data(), 1, out.data()); // faults the pages in
+    std::chrono::duration<double, std::milli> first = \
+                                    std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    NeuralNetwork copy;
+    copy.load_checkpoint("bench.ckpt");
+    std::chrono::duration<double, std::milli> copied = \
+                                    std::chrono::steady_clock::now() - start;
+    std::cout << "save " << save.count() << " ms, mmap load " << \
+        mapped.count() << " ms (first predict " << first.count() << \
+        " ms), load for training " << copied.count() << " ms\n";
+
+    std::vector<uint8_t> inputs, targets;
+    make_synthetic_mnist(inputs, targets, 2048);
+    NeuralNetwork small(0.001f);
+    small.add_layer(784);
+    small.add_layer(2048);
+    small.add_layer(10);
+    small.set_data(inputs, targets, 784);
+    small.set_batch_size(256);
+    for (size_t every : {0, 1}){
+        small.set_checkpointing("bench.ckpt", every);
+        start = std::chrono::steady_clock::now();
+        small.train(3);
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+        std::cout << (every ? "checkpoint every epoch: " : \
+                "no checkpoints: ") << elapsed.count() / 3 << " s/epoch\n";
+    }
+    std::remove("bench.ckpt");
+    return 1;
+}
+
+/**
+ * @brief Accuracy and time of the int8 model against the float one on a
+ *        trained 784-128-10 network, batches of 64 samples
+ */
+int quantization_benchmark(){
+    NeuralNetwork nn;
+    if (std::ifstream("mnist_train.csv").good()){
+        nn.read_input("mnist_train.csv");
+    } else {
+        std::vector<uint8_t> inputs, targets;
+        make_learnable_mnist(inputs, targets, 20000);
+        nn.set_data(inputs, targets, 784);
+    }
+    OptimizerConfig config;
+    config.type = OptimizerType::ADAM;
+    config.learning_rate = 0.001f;
+    nn.add_layer(784);
+    nn.add_layer(128);
+    nn.add_layer(10, Activation::SOFTMAX);
+    nn.set_cost(Cost::CROSS_ENTROPY);
+    nn.set_optimizer(config);
+    nn.set_batch_size(64);
+    nn.train(2);
+
+    InferenceModel model;
+    QuantizedModel quantized;
+    nn.export_model(model);
+    nn.quantize_model(quantized);
+    model.set_max_batch(64);
+    // evaluated on the samples the network trained on, which is enough to
+    // compare the two models
+    const size_t n = 10000;
+    std::vector<uint8_t> pixels, labels;
+    if (std::ifstream("mnist_train.csv").good()){
+        NeuralNetwork loader;
+        loader.read_input("mnist_train.csv");
+        loader.save_input("quantization.bin");
+        Dataset data;
+        data.open_binary("quantization.bin");
+        pixels.assign(data.getFeatures(), data.getFeatures() + n * 784);
+        labels.assign(data.getLabels(), data.getLabels() + n);
+        std::remove("quantization.bin");
+    } else {
+        make_learnable_mnist(pixels, labels, n);
+    }
+    std::vector<float> X(pixels.begin(), pixels.end());
+    for (float& x : X) x /= 255.0f;
+
+    std::vector<size_t> classes(n);
+    std::vector<float> out(64 * 10);
+    const char* names[] = {"float", "int8", "int8 from pixels"};
+    for (size_t m = 0; m < 3; m++){
+        size_t correct = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t s = 0; s + 64 <= n; s += 64){
+            if (m == 0) model.predict(X.data() + s*784, 64, out.data());
+            if (m == 1) quantized.predict(X.data() + s*784, 64, out.data());
+            if (m == 2) {
+                quantized.predict_pixels(pixels.data() + s*784, 64, \
+                                                                out.data());
+            }
+            for (size_t i = 0; i < 64; i++){
+                float* o = out.data() + i*10;
+                correct += (size_t)(std::max_element(o, o + 10) - o) == \
+                                                                labels[s + i];
+            }
+        }
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+        std::cout << names[m] << ": accuracy " << correct / (n / 64 * 64.0) \
+            << ", " << (n / 64 * 64) / elapsed.count() << " samples/sec\n";
+    }
+    std::cout << "weights: float " << (784*128 + 128*10) * sizeof(float) << \
+        " bytes, int8 " << quantized.getWeightBytes() << " bytes ("  << \
+        Kernels::active().name << " kernels)\n";
+    return 1;
+}
+
+/**
+ * @brief Epoch time and accuracy of Hogwild training against the
+ *        synchronous mini-batch training, for 1 to 8 threads
+ */
+int hogwild_benchmark(){
+    std::vector<uint8_t> inputs, targets;
+    make_learnable_mnist(inputs, targets, 20000);
+    std::vector<float> X(inputs.begin(), inputs.end());
+    for (float& x : X) x /= 255.0f;
+    std::vector<size_t> classes(targets.size());
+    for (size_t threads : {1, 2, 4, 8}){
+        for (bool hogwild : {false, true}){
+            // steps on single samples are noisier, they need a lower rate
+            NeuralNetwork nn(hogwild ? 0.001f : 0.01f);
+            nn.add_layer(784);
+            nn.add_layer(128);
+            nn.add_layer(10);
+            nn.set_data(inputs, targets, 784);
+            nn.set_threads(threads);
+            // Hogwild steps on a few samples per thread, the synchronous
+            // mode needs big batches to keep the threads busy
+            nn.set_batch_size(hogwild ? threads : 64);
+            auto start = std::chrono::steady_clock::now();
+            if (hogwild) {
+                nn.train_hogwild(3);
+            } else {
+                nn.train(3);
+            }
+            std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+            InferenceModel model;
+            nn.export_model(model);
+            model.predict_class(X.data(), targets.size(), classes.data());
+            size_t correct = 0;
+            for (size_t s = 0; s < targets.size(); s++){
+                correct += classes[s] == targets[s];
+            }
+            std::cout << (hogwild ? "hogwild" : "mini-batch") << ", " << \
+                threads << " threads: " << elapsed.count() / 3 << \
+                " s/epoch, accuracy " << correct / (float)targets.size() \
+                                                                << "\n";
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Epoch time of data parallel training with 1, 2, 4 and 8
+ *        processes of one thread each, same global batch of 64
+ */
+int process_scaling_benchmark(){
+    std::vector<uint8_t> inputs, targets;
+    make_learnable_mnist(inputs, targets, 20000);
+    for (size_t processes : {1, 2, 4, 8}){
+        NeuralNetwork nn(0.01f);
+        nn.add_layer(784);
+        nn.add_layer(128);
+        nn.add_layer(10);
+        nn.set_data(inputs, targets, 784);
+        nn.set_threads(1, true);
+        nn.set_batch_size(64);
+        auto start = std::chrono::steady_clock::now();
+        nn.train_processes(2, processes);
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+        std::cout << processes << " processes: " << elapsed.count() / 2 << \
+                                                        " s/epoch\n";
+    }
+    return 1;
+}
+
+/**
+ * @brief Epoch time and share of remote memory accesses of a 784-512-10
+ *        network for every placement, one pinned thread per core
+ */
+int placement_benchmark(){
+    std::vector<uint8_t> inputs, targets;
+    make_synthetic_mnist(inputs, targets, 20000);
+    const char* names[] = {"local", "first touch", "interleaved", \
+                                                            "replicated"};
+    Placement placements[] = {Placement::LOCAL, Placement::FIRST_TOUCH, \
+                            Placement::INTERLEAVED, Placement::REPLICATED};
+    std::cout << Numa::node_count() << " NUMA node(s)\n";
+    for (size_t p = 0; p < 4; p++){
+        NeuralNetwork nn(0.001f);
+        nn.add_layer(784);
+        nn.add_layer(512);
+        nn.add_layer(10);
+        nn.set_data(inputs, targets, 784);
+        nn.set_batch_size(256);
+        nn.set_threads(0, true);
+        nn.set_placement(placements[p]);
+        double remote = nn.remote_access_fraction();
+        auto start = std::chrono::steady_clock::now();
+        nn.train(2);
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+        std::cout << names[p] << ": " << elapsed.count() / 2 << \
+            " s/epoch, remote accesses " << remote * 100 << "%\n";
+    }
+    return 1;
+}
+
+/**
+ * @brief fp32 against bf16 (Precision::BF16): the packed tile product of
+ *        every instruction set, then the epoch time and accuracy of a
+ *        784-1024-1024-10 network on MNIST (learnable synthetic samples if
+ *        mnist_train.csv is missing)
+ */
+int mixed_precision_benchmark(){
+    const size_t kc = Kernels::KC, nb = Kernels::NC, reps = 20000;
+    std::vector<float> a(kc), packed(kc * nb), c(nb, 0.0f);
+    fill_random(a.data(), kc, -1.0f, 1.0f);
+    fill_random(packed.data(), kc * nb, -1.0f, 1.0f);
+    std::vector<Kernels::bf16> a16(kc), packed16(kc * nb);
+    Kernels::to_bf16(kc, a.data(), a16.data());
+    Kernels::to_bf16(kc * nb, packed.data(), packed16.data());
+    double flops = 2.0 * kc * nb;
+    for (Kernels::Isa isa : {Kernels::Isa::SCALAR, Kernels::Isa::AVX2, \
+            Kernels::Isa::AVX512, Kernels::Isa::AVX512_BF16, \
+                                                    Kernels::Isa::NEON}){
+        const Kernels::KernelTable* kt = Kernels::table(isa);
+        if (kt == nullptr) continue;
+        double fp32 = time_ns([&](){
+            kt->packed_gemv(kc, nb, a.data(), packed.data(), c.data());
+        }, reps);
+        double bf16 = time_ns([&](){
+            kt->packed_gemv_bf16(kc, nb, a16.data(), packed16.data(), \
+                                                                c.data());
+        }, reps);
+        std::cout << kt->name << " " << kc << "x" << nb << " tile: fp32 " << \
+            flops / fp32 << " GFLOP/s, bf16 " << flops / bf16 << \
+                        " GFLOP/s (" << fp32 / bf16 << "x)\n";
+    }
+
+    std::vector<uint8_t> inputs, targets;
+    NeuralNetwork loader;
+    if (std::ifstream("mnist_train.csv").good()){
+        loader.read_input("mnist_train.csv");
+    } else {
+        make_learnable_mnist(inputs, targets, 20000);
+        loader.set_data(inputs, targets, 784);
+    }
+    loader.save_input("mixed_precision.bin");
+    std::vector<float> X(inputs.begin(), inputs.end());
+    for (float& x : X) x /= 255.0f;
+    const char* names[] = {"fp32", "bf16"};
+    Kernels::Precision precisions[] = {Kernels::Precision::FP32, \
+                                                Kernels::Precision::BF16};
+    std::vector<float> start;
+    double fp32_time = 0.0;
+    for (size_t p = 0; p < 2; p++){
+        NeuralNetwork nn(0.01f);
+        nn.add_layer(784);
+        nn.add_layer(1024);
+        nn.add_layer(1024);
+        nn.add_layer(10);
+        nn.read_binary("mixed_precision.bin");
+        nn.set_batch_size(64);
+        nn.set_precision(precisions[p]);
+        size_t size = nn.getParameterSize();
+        if (start.empty()) start.assign(nn.getParameters(), \
+                                            nn.getParameters() + size);
+        std::copy(start.begin(), start.end(), nn.getParameters());
+        auto begin = std::chrono::steady_clock::now();
+        nn.train(3);
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - begin;
+        if (p == 0) fp32_time = elapsed.count();
+
+        // the losses printed by train show the convergence on the csv
+        float accuracy = 0.0f;
+        if (!inputs.empty()) {
+            InferenceModel model;
+            nn.export_model(model);
+            std::vector<size_t> classes(targets.size());
+            model.predict_class(X.data(), targets.size(), classes.data());
+            size_t correct = 0;
+            for (size_t s = 0; s < targets.size(); s++){
+                correct += classes[s] == targets[s];
+            }
+            accuracy = correct / (float)targets.size();
+        }
+        // the weights read by the passes of every batch: twice (forward
+        // and deltas) in the precision of the passes
+        size_t weight_bytes = 2 * size * (p == 0 ? sizeof(float) : \
+                                                    sizeof(Kernels::bf16));
+        std::cout << names[p] << ": " << elapsed.count() / 3 << \
+            " s/epoch (" << fp32_time / elapsed.count() << "x), " << \
+            weight_bytes / 1e6 << " MB of weights read per batch, " << \
+                                    "accuracy " << accuracy << "\n";
+    }
+    std::remove("mixed_precision.bin");
+    return 1;
+}
+
+int pruning_benchmark(){
+    // forward product of a 1024x1024 layer on a batch of 64, dense against
+    // CSR as the layer gets sparser
+    const size_t M = 64, N = 1024, K = 1024, reps = 20;
+    std::vector<float> X(M * K), W(N * K), pruned(N * K), C(M * N);
+    fill_random(X.data(), X.size(), -1.0f, 1.0f);
+    fill_random(W.data(), W.size(), -1.0f, 1.0f);
+    double flops = 2.0 * M * N * K;
+    double dense = time_ns([&](){
+        Kernels::gemm_nt(M, N, K, X.data(), K, W.data(), K, C.data(), N);
+    }, reps);
+    std::cout << "dense: " << dense / 1e6 << " ms, " << flops / dense << \
+                                                        " GFLOP/s\n";
+    for (float density : {0.9f, 0.7f, 0.5f, 0.3f, 0.2f, 0.1f, 0.05f, 0.02f}){
+        for (size_t i = 0; i < N * K; i++){
+            // |W| is uniform, so this keeps about density of them
+            pruned[i] = std::fabs(W[i]) > 1.0f - density ? W[i] : 0.0f;
+        }
+        Sparse::Csr csr = Sparse::from_dense(pruned.data(), N, K, K);
+        double sparse = time_ns([&](){
+            Sparse::spmm_nt(M, X.data(), K, csr, C.data(), N);
+        }, reps);
+        std::cout << "density " << csr.density() << ": " << sparse / 1e6 << \
+            " ms (" << dense / sparse << "x), " << \
+            2.0 * M * csr.nnz() / sparse << " useful GFLOP/s\n";
+    }
+    std::cout << "crossover density " << Sparse::crossover_density() << "\n";
+
+    // training and serving a network before and after pruning 95% of the
+    // weights of its hidden layers
+    std::vector<uint8_t> inputs, targets;
+    make_learnable_mnist(inputs, targets, 20000);
+    std::vector<float> samples(inputs.begin(), inputs.end());
+    for (float& x : samples) x /= 255.0f;
+    NeuralNetwork nn(0.01f);
+    nn.add_layer(784);
+    nn.add_layer(1024);
+    nn.add_layer(1024);
+    nn.add_layer(10);
+    nn.set_data(inputs, targets, 784);
+    nn.set_batch_size(64);
+    const char* names[] = {"dense", "pruned"};
+    for (size_t p = 0; p < 2; p++){
+        if (p == 1) nn.prune_top_k(50000);
+        auto begin = std::chrono::steady_clock::now();
+        nn.train(1);
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - begin;
+        InferenceModel model;
+        nn.export_model(model);
+        std::vector<size_t> classes(targets.size());
+        double predict = time_ns([&](){
+            model.predict_class(samples.data(), targets.size(), \
+                                                        classes.data());
+        }, 3);
+        size_t correct = 0;
+        for (size_t s = 0; s < targets.size(); s++){
+            correct += classes[s] == targets[s];
+        }
+        std::cout << names[p] << ": " << elapsed.count() << " s/epoch, " << \
+            "predict " << predict / 1e6 << " ms (" << \
+            model.getSparseLayerCount() << " sparse layers), accuracy " << \
+                            correct / (float)targets.size() << "\n";
+    }
+    return 1;
+}
+int softmax_cross_entropy_benchmark(){
+    // the output stage of a batch of 64, as it was (scalar softmax, one-hot
+    // gradient of the loss, then the softmax Jacobian product) against the
+    // fused pass with the vector exp
+    const size_t batch = 64;
+    for (size_t n : {10, 256, 1000, 10000}){
+        std::vector<float> logits(batch * n), y(batch * n), d(batch * n);
+        fill_random(logits.data(), logits.size(), -10.0f, 10.0f);
+        std::vector<uint8_t> labels(batch);
+        for (size_t r = 0; r < batch; r++) labels[r] = (r * 37) % 256 % n;
+        size_t reps = std::max<size_t>(10, 2000000 / (batch * n));
+        volatile float sink = 0.0f;
+        double separate = time_ns([&](){
+            std::copy(logits.begin(), logits.end(), y.begin());
+            float loss = 0.0f;
+            for (size_t r = 0; r < batch; r++){
+                float* yr = y.data() + r * n;
+                float* dr = d.data() + r * n;
+                ActivationFuncs::Softmax(yr, n);
+                loss += CostFuncs::CrossEntropyPolicy::loss_gradient(yr, \
+                                                        labels[r], dr, n);
+                float dot = Kernels::dot(dr, yr, n);
+                for (size_t i = 0; i < n; i++) dr[i] = yr[i] * (dr[i] - dot);
+            }
+            sink = sink + loss;
+        }, reps);
+        double fused = time_ns([&](){
+            std::copy(logits.begin(), logits.end(), y.begin());
+            float loss = 0.0f;
+            for (size_t r = 0; r < batch; r++){
+                loss += Kernels::softmax_cross_entropy(n, y.data() + r * n, \
+                            labels[r], y.data() + r * n, d.data() + r * n);
+            }
+            sink = sink + loss;
+        }, reps);
+        std::cout << n << " classes: separate " << separate / 1e3 << \
+            " us, fused " << fused / 1e3 << " us (" << separate / fused << \
+                                                            "x)\n";
+    }
+    return 1;
+}
+
+/**
+ * @brief Epoch time of a 784-256-10 network without validation and with a
+ *        background validation on 2000 held-out samples every epoch. The
+ *        overhead is the copy of the parameters, plus the validation itself
+ *        when there is no idle core for its thread.
+ */
+int validation_benchmark(){
+    std::vector<uint8_t> inputs, targets, held_inputs, held_targets;
+    make_learnable_mnist(inputs, targets, 8192);
+    make_learnable_mnist(held_inputs, held_targets, 2000);
+    NeuralNetwork writer;
+    writer.set_data(held_inputs, held_targets, 784);
+    writer.save_input("bench_valid.bin");
+    const size_t epochs = 4;
+    for (size_t every : {0, 1}){
+        NeuralNetwork nn(0.01f);
+        nn.add_layer(784);
+        nn.add_layer(256);
+        nn.add_layer(10, Activation::SOFTMAX);
+        nn.set_cost(Cost::CROSS_ENTROPY);
+        nn.set_data(inputs, targets, 784);
+        nn.set_batch_size(64);
+        nn.set_validation("bench_valid.bin", every);
+        auto start = std::chrono::steady_clock::now();
+        nn.train(epochs);
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+        double validating = 0.0;
+        for (const ValidationResult& r : nn.getValidationHistory()){
+            validating += r.seconds;
+        }
+        std::cout << (every ? "validation every epoch: " : \
+            "no validation: ") << elapsed.count() / epochs << \
+            " s/epoch, validation thread busy " << validating / epochs << \
+                                        " s/epoch" << std::endl;
+    }
+    std::remove("bench_valid.bin");
+    return 1;
+}
+
+/**
+ * @brief Single sample latency of a fixed topology network against the
+ *        InferenceModel with the same parameters
+ */
+template<size_t... Sizes>
+void static_network_latency(StaticNetwork<Sizes...>& fixed){
+    constexpr size_t sizes[] = {Sizes...};
+    NeuralNetwork nn;
+    for (size_t i = 0; i < sizeof...(Sizes); i++){
+        nn.add_layer(sizes[i], i + 1 == sizeof...(Sizes) ? \
+                                    Activation::SOFTMAX : Activation::RELU);
+    }
+    InferenceModel model;
+    nn.export_model(model);
+    nn.export_model(fixed);
+    std::vector<float> x(fixed.INPUT_SIZE), y(fixed.OUTPUT_SIZE);
+    fill_random(x.data(), x.size());
+    const size_t reps = 2000000 / fixed.N_PARAMETERS + 1000;
+    float sink = 0.0f;
+    double dynamic = time_ns([&]{
+        model.predict(x.data(), 1, y.data());
+        sink += y[0];
+    }, reps);
+    double fixed_ns = time_ns([&]{
+        fixed.predict(x.data(), y.data());
+        sink += y[0];
+    }, reps);
+    for (size_t i = 0; i < sizeof...(Sizes); i++){
+        std::cout << (i ? "-" : "") << sizes[i];
+    }
+    std::cout << ": InferenceModel " << dynamic << " ns, StaticNetwork " << \
+        fixed_ns << " ns (" << dynamic / fixed_ns << "x)" << std::endl;
+    (void)sink;
+}
+
+int static_network_benchmark(){
+    StaticNetwork<16, 32, 4> tiny;
+    StaticNetwork<64, 64, 10> small;
+    static StaticNetwork<784, 128, 10> mnist;
+    static_network_latency(tiny);
+    static_network_latency(small);
+    static_network_latency(mnist);
+    return 1;
+}
+
+/**
+ * @brief Training time of deep networks whose workspaces share the memory
+ *        of dead activations and deltas (see NeuralNetwork::compile)
+ */
+int execution_plan_benchmark(){
+    std::vector<uint8_t> inputs, targets;
+    make_learnable_mnist(inputs, targets, 8192);
+    const size_t epochs = 3;
+    for (size_t depth : {3, 6}){
+        NeuralNetwork nn(0.01f);
+        nn.add_layer(784);
+        for (size_t l = 0; l < depth; l++) nn.add_layer(512);
+        nn.add_layer(10, Activation::SOFTMAX);
+        nn.set_cost(Cost::CROSS_ENTROPY);
+        nn.set_data(inputs, targets, 784);
+        nn.set_batch_size(64);
+        nn.compile();
+        std::cout << depth << " hidden layers of 512" << std::endl;
+        nn.display_plan();
+        auto start = std::chrono::steady_clock::now();
+        nn.train(epochs);
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+        std::cout << elapsed.count() / epochs << " s/epoch" << std::endl;
+    }
+    return 1;
+}
+
+/**
+ * @brief Throughput of a deep network trained on one thread, data parallel
+ *        on 4 threads and pipeline parallel in 4 stages, with the bubble
+ *        of the pipeline against its lower bound
+ */
+int pipeline_benchmark(){
+    std::vector<uint8_t> inputs, targets;
+    make_learnable_mnist(inputs, targets, 8192);
+    const size_t n_threads = 4, n_micro = 8;
+    const char* names[] = {"1 thread", "data parallel", "pipeline gpipe", \
+                                                        "pipeline 1f1b"};
+    for (size_t mode = 0; mode < 4; mode++){
+        NeuralNetwork nn(0.01f);
+        nn.add_layer(784);
+        for (size_t l = 0; l < 4; l++) nn.add_layer(256);
+        nn.add_layer(10, Activation::SOFTMAX);
+        nn.set_cost(Cost::CROSS_ENTROPY);
+        nn.set_data(inputs, targets, 784);
+        nn.set_batch_size(256);
+        nn.set_threads(mode == 0 ? 1 : n_threads, true);
+        auto start = std::chrono::steady_clock::now();
+        if (mode < 2) {
+            nn.train(1);
+        } else {
+            nn.train_pipeline(1, n_threads, n_micro, mode == 2 ? \
+                PipelineSchedule::GPIPE : PipelineSchedule::ONE_F_ONE_B);
+        }
+        std::chrono::duration<double> elapsed = \
+                                    std::chrono::steady_clock::now() - start;
+        std::cout << names[mode] << ": " << inputs.size() / 784 / \
+                            elapsed.count() << " samples/sec";
+        if (mode >= 2) {
+            const PipelineStats& stats = nn.getPipelineStats();
+            std::cout << ", bubble " << 100.0 * stats.bubble << "% (" << \
+                            100.0 * stats.ideal_bubble << "% at best)";
+        }
+        std::cout << std::endl;
+    }
+    return 1;
+}
+
+int main(){
+    kernel_isa_benchmark();
+    //batch_size_benchmark();
+    //thread_scaling_benchmark();
+    //load_benchmark();
+    //csv_parse_benchmark();
+    //stream_benchmark();
+    //optimizer_benchmark();
+    //optimizer_convergence_benchmark();
+    //activation_benchmark();
+    //inference_benchmark();
+    //checkpoint_benchmark();
+    //quantization_benchmark();
+    //hogwild_benchmark();
+    //process_scaling_benchmark();
+    //placement_benchmark();
+    //mixed_precision_benchmark();
+    //pruning_benchmark();
+    //softmax_cross_entropy_benchmark();
+    //validation_benchmark();
+    //static_network_benchmark();
+    //execution_plan_benchmark();
+    //pipeline_benchmark();
+    return 1;
+}
@@ -3,11 +3,72 @@
  *  Date - 1/4/2026
  *  Tests
  */
+#include"BatchStream.h"
 #include"Layer.h"
+#include"Kernels.h"
 #include"NeuralNetwork.h"
+#include"InferenceModel.h"
+#include"Optimizer.h"
+#include"Pipeline.h"
+#include"Profiler.h"
+#include"RingAllReduce.h"
+#include"QuantizedModel.h"
+#include"Sparse.h"
+#include<algorithm>
+#include<atomic>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<fstream>
 #include<iostream>
+#include<new>
+#include<sys/wait.h>
+#include<unistd.h>
 
 
+// Heap allocations made so far, counted for execution_plan_test. Built
+// with NN_PROFILE the profiler replaces operator new already and counts
+// those of the calling thread.
+#ifdef NN_PROFILE
+size_t heap_allocations(){
+    return Profiler::allocations();
+}
+#else
+std::atomic<size_t> allocation_count{0};
+
+size_t heap_allocations(){
+    return allocation_count.load();
+}
+
+void* operator new(size_t size){
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size > 0 ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size > 0 ? size : 1);
+}
+
+// gcc takes the free of a pointer from new for a mismatch once inlined
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+#pragma GCC diagnostic pop
+#endif
+
 inline void display_array(const float* arr, size_t size, \
                                     std::string arrayName="") {
     if (arrayName != ""){
@@ -168,11 +229,43 @@ int backward_pass_test(){
     float learning_rate = 0.01;
     // For output layer assume delta_layer = derivative_MSE
     float delta_layer[] = {2.0f*(56.0f-50.0f)};
-    output.backward_pass(delta_layer, h1, learning_rate);
-    h1.backward_pass(output, x, learning_rate);
+    output.backward_pass(delta_layer, h1);
+    h1.backward_pass(output, x);
+    output.apply_gradients(learning_rate);
+    h1.apply_gradients(learning_rate);
     return 0;
 }
 
+int batch_pass_test(){
+    // The batched pass must give the same neurons as running the samples
+    // through the single sample pass one at a time
+    size_t batch = 3;
+    float samples[] = {1,2,3,4, 0.5,-1,2,0, 4,3,2,1};
+    Layer x(4), h1(x, 5, 0.1f), o(h1, 2, 0.2f);
+    Layer xb(4), h1b(xb, 5, 0.1f), ob(h1b, 2, 0.2f);
+    xb.setBatchSize(batch);
+    h1b.setBatchSize(batch);
+    ob.setBatchSize(batch);
+    xb.setNeurons(samples, batch*4);
+    h1b.forward_pass_batch(xb);
+    ob.forward_pass_batch(h1b);
+    float max_diff = 0;
+    for (size_t b = 0; b < batch; b++){
+        x.setNeurons(samples + b*4, 4);
+        h1.forward_pass(x);
+        o.forward_pass(h1);
+        for (size_t i = 0; i < 2; i++){
+            float diff = o.getNeurons()[i] - ob.getNeurons()[b*2 + i];
+            if (diff < 0) diff = -diff;
+            if (diff > max_diff) max_diff = diff;
+        }
+    }
+    display_array(ob.getNeurons(), batch*2, "batched output");
+    std::cout << "Max difference from single sample pass: " << max_diff \
+                                                                << std::endl;
+    return 1;
+}
+
 int read_input_test(){
     NeuralNetwork nn;
     nn.read_input("mnist_train.csv");
@@ -190,12 +283,1112 @@ int neural_network_structure_test(){
     return 1;
 }
 
+/**
+ * @brief Two classes of 16 pixel images, class 0 is bright on the left half
+ *        and class 1 on the right half. The loss should go down every epoch.
+ */
+void make_halves_data(std::vector<uint8_t>& inputs, \
+                                    std::vector<uint8_t>& targets, size_t n){
+    for (size_t s = 0; s < n; s++){
+        int target = s % 2;
+        for (size_t j = 0; j < 16; j++){
+            bool bright = (j < 8) == (target == 0);
+            inputs.push_back(bright ? 200 + (s*7 + j) % 56 : (s*3 + j) % 40);
+        }
+        targets.push_back(target);
+    }
+}
+
+int train_test(){
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 512);
+    NeuralNetwork nn(0.01f);
+    nn.add_layer(16);
+    nn.add_layer(8);
+    nn.add_layer(2);
+    nn.set_data(inputs, targets, 16);
+    nn.set_batch_size(16);
+    nn.set_threads(4);
+    nn.train(10);
+    return 1;
+}
+
+int binary_input_test(){
+    // The samples mapped from the binary file must match the ones saved
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 4);
+    NeuralNetwork nn;
+    nn.set_data(inputs, targets, 16);
+    nn.save_input("halves_test.bin");
+    NeuralNetwork mapped;
+    mapped.read_binary("halves_test.bin");
+    mapped.display_input(2);
+    return 1;
+}
+
+int csv_parse_test(){
+    // header, a blank line, a row with a letter and one with a value out of
+    // range without a newline at the end
+    std::ofstream out("parse_test.csv");
+    out << "label,a,b,c\n3,0,128,255\n\n1,2,x,4\r\n7,300,5,6";
+    out.close();
+    NeuralNetwork nn;
+    nn.read_input("parse_test.csv"); // should skip 2 rows
+    nn.display_input(1);             // 3: 0 128 255
+    return 1;
+}
+
+int train_stream_test(){
+    // Same as train_test, but streamed from a file 3 batches at a time
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 500);
+    NeuralNetwork writer;
+    writer.set_data(inputs, targets, 16);
+    writer.save_input("halves_stream.bin");
+    NeuralNetwork nn(0.01f);
+    nn.add_layer(16);
+    nn.add_layer(8);
+    nn.add_layer(2);
+    nn.set_batch_size(16);
+    nn.train_stream("halves_stream.bin", 10, 3);
+
+    // A read error must not pass for the end of an epoch: the stream
+    // stops, and so does every later next()
+    BatchStream stream;
+    stream.open("halves_stream.bin", 16, 2);
+    if (truncate("halves_stream.bin", 4096) != 0) return 0;
+    stream.start(2);
+    BatchStream::Batch batch;
+    size_t batches = 0;
+    while (stream.next(batch)){
+        batches += 1;
+        stream.release();
+    }
+    std::cout << "Batches before the error: " << batches << " (fewer than" \
+        " 32), failed: " << stream.has_failed() << ", next after it: " << \
+                                        stream.next(batch) << std::endl;
+
+    // labels running past the end of the file are rejected by open, not
+    // found mid-epoch
+    writer.save_input("halves_stream.bin");
+    std::fstream file("halves_stream.bin", std::ios::in | std::ios::out | \
+                                                        std::ios::binary);
+    DatasetHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    header.labels_offset = header.features_offset + header.rows * header.cols;
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+    int opened = stream.open("halves_stream.bin", 16, 2);
+    std::cout << "Opened with the labels past the end: " << opened << \
+                                                                std::endl;
+    std::remove("halves_stream.bin");
+    return 1;
+}
+
+int parameter_arena_test(){
+    // 4-5-2: 20 + 5 + 10 + 2 floats, each piece padded to 16 floats
+    NeuralNetwork nn;
+    nn.add_layer(4);
+    nn.add_layer(5);
+    nn.add_layer(2);
+    float* params = nn.getParameters();
+    std::cout << "Parameter floats: " << nn.getParameterSize() << \
+        " (expected 80), 64 byte aligned: " << \
+        ((reinterpret_cast<uintptr_t>(params) % 64) == 0) << std::endl;
+    // adding a layer keeps the parameters of the existing ones
+    float first = params[0];
+    nn.add_layer(3);
+    std::cout << "Kept after add_layer: " << (nn.getParameters()[0] == first)\
+                        << ", parameter floats: " << nn.getParameterSize() \
+                        << " (expected 112)" << std::endl;
+    return 1;
+}
+
+int optimizer_test(){
+    // Every instruction set must give the update of the scalar kernels,
+    // on a size that is not a multiple of any vector width
+    const size_t n = 37;
+    Kernels::AdamStep adam = {0.5f, 0.9f, 0.999f, 1e-8f, 0.01f, 10.0f, 0.99f};
+    const Kernels::KernelTable* ref = Kernels::table(Kernels::Isa::SCALAR);
+    for (Kernels::Isa isa : {Kernels::Isa::AVX2, Kernels::Isa::AVX512, \
+                                                    Kernels::Isa::NEON}){
+        const Kernels::KernelTable* kt = Kernels::table(isa);
+        if (kt == nullptr) continue;
+        float max_diff = 0.0f;
+        for (int kind = 0; kind < 2; kind++){
+            float p[2][n], g[2][n], m[2][n], v[2][n];
+            for (size_t i = 0; i < n; i++){
+                for (int k = 0; k < 2; k++){
+                    p[k][i] = 0.1f * i - 1.0f;
+                    g[k][i] = 0.3f - 0.02f * i;
+                    m[k][i] = 0.01f * i;
+                    v[k][i] = 0.001f * i;
+                }
+            }
+            const Kernels::KernelTable* tables[] = {ref, kt};
+            for (int k = 0; k < 2; k++){
+                if (kind == 0) {
+                    tables[k]->momentum_step(n, 0.1f, 0.9f, 0.5f, g[k], \
+                                                            m[k], p[k]);
+                } else {
+                    tables[k]->adam_step(n, adam, g[k], m[k], v[k], p[k]);
+                }
+            }
+            for (size_t i = 0; i < n; i++){
+                max_diff = std::max(max_diff, std::fabs(p[0][i] - p[1][i]));
+                max_diff = std::max(max_diff, std::fabs(g[1][i]));
+            }
+        }
+        std::cout << kt->name << " max difference from scalar: " << \
+                                                        max_diff << std::endl;
+    }
+
+    // Adam on the halves data, the loss should go down every epoch
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 512);
+    OptimizerConfig config;
+    config.type = OptimizerType::ADAM;
+    config.learning_rate = 0.01f;
+    NeuralNetwork nn;
+    nn.add_layer(16);
+    nn.add_layer(8);
+    nn.add_layer(2);
+    nn.set_data(inputs, targets, 16);
+    nn.set_batch_size(16);
+    nn.set_optimizer(config);
+    nn.train(5);
+    return 1;
+}
+
+int activation_test(){
+    // 3 inputs, 3 neurons with different sums, the layer must match the
+    // functions of ActivationFuncs for every activation
+    Layer x(3);
+    float input[] = {1, -2, 0.5};
+    set_array(input, x.getNeurons(), 3);
+    Layer h(x, 3, 0.1f);
+    float w[] = {0.5,0.1,0.2, -0.3,0.4,0.1, 0.2,0.2,-0.6};
+    set_array(w, h.getWeights(), 9);
+    float z[3];
+    for (size_t i = 0; i < 3; i++){
+        z[i] = 0.1f;
+        for (size_t j = 0; j < 3; j++) z[i] += w[i*3 + j] * input[j];
+    }
+    Activation types[] = {Activation::RELU, Activation::SIGMOID, \
+                Activation::TANH, Activation::IDENTITY, Activation::SOFTMAX};
+    const char* names[] = {"relu", "sigmoid", "tanh", "identity", "softmax"};
+    for (size_t a = 0; a < 5; a++){
+        float expected[3];
+        for (size_t i = 0; i < 3; i++){
+            switch (types[a]){
+                case Activation::RELU:
+                    expected[i] = ActivationFuncs::ReLU(z[i]); break;
+                case Activation::SIGMOID:
+                    expected[i] = ActivationFuncs::Sigmoid(z[i]); break;
+                case Activation::TANH:
+                    expected[i] = ActivationFuncs::Tanh(z[i]); break;
+                default:
+                    expected[i] = z[i]; break;
+            }
+        }
+        if (types[a] == Activation::SOFTMAX) {
+            ActivationFuncs::Softmax(expected, 3);
+        }
+        h.setActivation(types[a]);
+        h.forward_pass(x);
+        float max_diff = 0.0f;
+        for (size_t i = 0; i < 3; i++){
+            max_diff = std::max(max_diff, \
+                                std::fabs(h.getNeurons()[i] - expected[i]));
+        }
+        std::cout << names[a] << " max difference: " << max_diff << std::endl;
+    }
+
+    // softmax followed by cross entropy gives delta = y - target
+    float grad[3], delta[3];
+    CostFuncs::CrossEntropyPolicy::loss_gradient(h.getNeurons(), 1, grad, 3);
+    h.output_delta(grad, h.getNeurons(), delta, 1);
+    display_array(delta, 3, "softmax + cross entropy delta");
+    display_array(h.getNeurons(), 3, \
+                            "y (the delta should be y - (0, 1, 0))");
+
+    // the halves data with a softmax output and the cross entropy
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 512);
+    NeuralNetwork nn(0.05f);
+    nn.add_layer(16);
+    nn.add_layer(8, Activation::TANH);
+    nn.add_layer(2, Activation::SOFTMAX);
+    nn.set_cost(Cost::CROSS_ENTROPY);
+    nn.set_data(inputs, targets, 16);
+    nn.set_batch_size(16);
+    nn.train(5);
+    return 1;
+}
+
+int inference_test(){
+    // A model exported after training must classify the halves data and
+    // give the same outputs whatever the batch it runs in
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 512);
+    NeuralNetwork nn(0.05f);
+    nn.add_layer(16);
+    nn.add_layer(8);
+    nn.add_layer(2, Activation::SOFTMAX);
+    nn.set_cost(Cost::CROSS_ENTROPY);
+    nn.set_data(inputs, targets, 16);
+    nn.set_batch_size(16);
+    nn.train(3);
+
+    InferenceModel model;
+    nn.export_model(model);
+    model.set_max_batch(8); // so predict has to split the 512 samples
+    std::vector<float> X(inputs.begin(), inputs.end());
+    for (float& x : X) x /= 255.0f;
+    std::vector<float> batched(512 * 2), single(2);
+    std::vector<size_t> classes(512);
+    model.predict(X.data(), 512, batched.data());
+    model.predict_class(X.data(), 512, classes.data());
+    float max_diff = 0.0f;
+    size_t correct = 0;
+    for (size_t s = 0; s < 512; s++){
+        model.predict(X.data() + s*16, 1, single.data());
+        for (size_t c = 0; c < 2; c++){
+            max_diff = std::max(max_diff, \
+                            std::fabs(single[c] - batched[s*2 + c]));
+        }
+        correct += classes[s] == targets[s];
+    }
+    std::cout << "Accuracy: " << correct / 512.0f << \
+        ", max difference batch vs single: " << max_diff << std::endl;
+    return 1;
+}
+
+int checkpoint_test(){
+    // Checkpoints written while training must load back into a network and
+    // into a mapped model with the same parameters
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 256);
+    NeuralNetwork nn(0.05f);
+    nn.add_layer(16);
+    nn.add_layer(8, Activation::TANH);
+    nn.add_layer(2, Activation::SOFTMAX);
+    nn.set_data(inputs, targets, 16);
+    nn.set_checkpointing("halves.ckpt", 1);
+    nn.train(2);
+
+    NeuralNetwork resumed;
+    resumed.load_checkpoint("halves.ckpt");
+    resumed.display_layers();
+    bool same = resumed.getParameterSize() == nn.getParameterSize() && \
+        std::memcmp(resumed.getParameters(), nn.getParameters(), \
+                            nn.getParameterSize() * sizeof(float)) == 0;
+    std::cout << "Resumed parameters match: " << same << std::endl;
+
+    InferenceModel copied, mapped;
+    nn.export_model(copied);
+    mapped.load("halves.ckpt");
+    std::vector<float> X(inputs.begin(), inputs.begin() + 4*16);
+    for (float& x : X) x /= 255.0f;
+    float a[8], b[8];
+    copied.predict(X.data(), 4, a);
+    mapped.predict(X.data(), 4, b);
+    std::cout << "Mapped model matches: " << \
+                    (std::memcmp(a, b, sizeof(a)) == 0) << std::endl;
+    std::remove("halves.ckpt");
+
+    // Adam resumed in a network that already took steps must train like a
+    // fresh Adam on the same weights, its state starts over
+    OptimizerConfig config;
+    config.type = OptimizerType::ADAM;
+    NeuralNetwork adam;
+    adam.add_layer(16);
+    adam.add_layer(8, Activation::TANH);
+    adam.add_layer(2, Activation::SOFTMAX);
+    adam.set_data(inputs, targets, 16);
+    adam.set_optimizer(config);
+    adam.train(2);
+    adam.save_checkpoint("adam.ckpt");
+    adam.load_checkpoint("adam.ckpt");
+    adam.train(1);
+    NeuralNetwork fresh;
+    fresh.set_optimizer(config);
+    fresh.load_checkpoint("adam.ckpt");
+    fresh.set_data(inputs, targets, 16);
+    fresh.train(1);
+    same = std::memcmp(adam.getParameters(), fresh.getParameters(), \
+                            adam.getParameterSize() * sizeof(float)) == 0;
+    std::cout << "Resumed Adam matches a fresh one: " << same << std::endl;
+
+    // a file whose layers do not match its parameters must leave the
+    // network as it was
+    std::fstream file("adam.ckpt", std::ios::in | std::ios::out | \
+                                                        std::ios::binary);
+    CheckpointHeader header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    uint64_t wrong = 9;
+    file.seekp(header.layers_offset + sizeof(CheckpointLayer));
+    file.write(reinterpret_cast<const char*>(&wrong), sizeof(wrong));
+    file.close();
+    std::vector<float> before(fresh.getParameters(), \
+                        fresh.getParameters() + fresh.getParameterSize());
+    int loaded = fresh.load_checkpoint("adam.ckpt");
+    same = fresh.getParameterSize() == before.size() && \
+        std::memcmp(fresh.getParameters(), before.data(), \
+                                    before.size() * sizeof(float)) == 0;
+    std::cout << "Bad checkpoint loaded: " << loaded << \
+                                ", network unchanged: " << same << std::endl;
+    fresh.display_layers();             // 16 8 2
+    std::remove("adam.ckpt");
+    return 1;
+}
+
+int quantization_test(){
+    // The integer dot product of every instruction set must be exact, and
+    // the int8 model must classify about as well as the float one
+    std::vector<uint8_t> a(1000);
+    std::vector<int8_t> b(1000);
+    for (size_t i = 0; i < a.size(); i++){
+        a[i] = (i * 37) % 256;
+        b[i] = (int8_t)((i * 91) % 255 - 127);
+    }
+    int32_t expected = Kernels::table(Kernels::Isa::SCALAR)->dot_u8s8(\
+                                            a.data(), b.data(), a.size());
+    for (Kernels::Isa isa : {Kernels::Isa::AVX2, Kernels::Isa::AVX512, \
+                    Kernels::Isa::AVX512_VNNI, Kernels::Isa::NEON}){
+        const Kernels::KernelTable* kt = Kernels::table(isa);
+        if (!kt) continue;
+        for (size_t n : {1, 15, 64, 100, 1000}){
+            int32_t r = kt->dot_u8s8(a.data(), b.data(), n);
+            int32_t e = Kernels::table(Kernels::Isa::SCALAR)->dot_u8s8(\
+                                                    a.data(), b.data(), n);
+            if (r != e) {
+                std::cout << kt->name << " dot_u8s8 differs for n = " << n \
+                                                                << std::endl;
+            }
+        }
+    }
+    std::cout << "dot_u8s8 of 1000: " << expected << std::endl;
+
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 512);
+    NeuralNetwork nn(0.05f);
+    nn.add_layer(16);
+    nn.add_layer(8);
+    nn.add_layer(2, Activation::SOFTMAX);
+    nn.set_cost(Cost::CROSS_ENTROPY);
+    nn.set_data(inputs, targets, 16);
+    nn.set_batch_size(16);
+    nn.train(3);
+
+    InferenceModel model;
+    QuantizedModel quantized;
+    nn.export_model(model);
+    nn.quantize_model(quantized, 100);
+    std::vector<float> X(inputs.begin(), inputs.end());
+    for (float& x : X) x /= 255.0f;
+    std::vector<float> expected_out(512 * 2), out(512 * 2), pixels_out(512 * 2);
+    model.predict(X.data(), 512, expected_out.data());
+    quantized.predict(X.data(), 512, out.data());
+    quantized.predict_pixels(inputs.data(), 512, pixels_out.data());
+    std::vector<size_t> classes(512);
+    quantized.predict_class(X.data(), 512, classes.data());
+    float max_diff = 0.0f;
+    size_t correct = 0;
+    for (size_t i = 0; i < out.size(); i++){
+        max_diff = std::max(max_diff, std::fabs(out[i] - expected_out[i]));
+    }
+    for (size_t s = 0; s < 512; s++){
+        correct += classes[s] == targets[s];
+    }
+    std::cout << "Int8 accuracy: " << correct / 512.0f << \
+        ", max difference vs float: " << max_diff << \
+        ", pixels match: " << (out == pixels_out) << std::endl;
+    return 1;
+}
+
+int profiler_test(){
+    // A timed scope must be reported once with its work, the counters start
+    // again from 0 after every report. Build with -DNN_PROFILE to also get
+    // the reports of the training below.
+    Profiler::set_output("profiler_test");
+    {
+        Profiler::ScopedTimer timer("test_scope", 4, 2, 100, 200);
+        std::vector<float> v(10); // an allocation, counted with NN_PROFILE
+    }
+    Profiler::write_report(0);
+    Profiler::write_report(1);
+
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 256);
+    NeuralNetwork nn(0.05f);
+    nn.add_layer(16);
+    nn.add_layer(8);
+    nn.add_layer(2);
+    nn.set_data(inputs, targets, 16);
+    nn.set_batch_size(16);
+    nn.train(2);
+
+    std::ifstream csv("profiler_test.csv");
+    std::string line;
+    size_t test_rows = 0, rows = 0;
+    while (std::getline(csv, line)){
+        std::cout << line << "\n";
+        test_rows += line.find("test_scope") != std::string::npos;
+        rows += 1;
+    }
+    std::cout << "test_scope reported " << test_rows << " time(s), " << \
+                                    rows - 1 << " rows in all" << std::endl;
+    std::remove("profiler_test.csv");
+    std::remove("profiler_test.json");
+    Profiler::set_output("profile");
+    return 1;
+}
+
+int hogwild_test(){
+    // Asynchronous training must still learn the halves data, whatever the
+    // order the threads update the weights in
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 512);
+    NeuralNetwork nn(0.05f);
+    nn.add_layer(16);
+    nn.add_layer(8);
+    nn.add_layer(2, Activation::SOFTMAX);
+    nn.set_cost(Cost::CROSS_ENTROPY);
+    nn.set_data(inputs, targets, 16);
+    nn.set_threads(4);
+    nn.set_batch_size(4); // one sample per thread per step
+    nn.train_hogwild(3);
+
+    InferenceModel model;
+    nn.export_model(model);
+    std::vector<float> X(inputs.begin(), inputs.end());
+    for (float& x : X) x /= 255.0f;
+    std::vector<size_t> classes(512);
+    model.predict_class(X.data(), 512, classes.data());
+    size_t correct = 0;
+    for (size_t s = 0; s < 512; s++){
+        correct += classes[s] == targets[s];
+    }
+    std::cout << "Hogwild accuracy: " << correct / 512.0f << std::endl;
+    return 1;
+}
+
+int ring_all_reduce_test(){
+    // Every process must end with the sum over all of them, for sizes that
+    // do not split evenly in segments and chunks
+    const size_t n_ranks = 3, n = 10001;
+    RingAllReduce ring;
+    if (!ring.create("/nn_ring_test", n_ranks, n)) return 0;
+    std::cout.flush();
+    size_t rank = 0;
+    std::vector<pid_t> children;
+    for (size_t r = 1; r < n_ranks; r++){
+        pid_t pid = fork();
+        if (pid == 0) {
+            rank = r;
+            break;
+        }
+        children.push_back(pid);
+    }
+    ring.set_rank(rank);
+    std::vector<float> data(n);
+    bool same = true;
+    for (size_t round = 0; round < 3; round++){
+        for (size_t i = 0; i < n; i++) data[i] = (rank + 1) * (i % 7 + round);
+        ring.all_reduce(data.data(), n);
+        for (size_t i = 0; i < n; i++){
+            same = same && data[i] == 6.0f * (i % 7 + round); // 1+2+3
+        }
+    }
+    if (rank != 0) _exit(same ? 0 : 1);
+    for (pid_t child : children){
+        int status = 0;
+        waitpid(child, &status, 0);
+        same = same && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+    std::cout << "All reduce sums match on every rank: " << same << std::endl;
+
+    // data parallel training must still learn
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 512);
+    NeuralNetwork nn(0.05f);
+    nn.add_layer(16);
+    nn.add_layer(8);
+    nn.add_layer(2, Activation::SOFTMAX);
+    nn.set_cost(Cost::CROSS_ENTROPY);
+    nn.set_data(inputs, targets, 16);
+    nn.set_threads(1);
+    nn.set_batch_size(16);
+    nn.train_processes(3, 2);
+    InferenceModel model;
+    nn.export_model(model);
+    std::vector<float> X(inputs.begin(), inputs.end());
+    for (float& x : X) x /= 255.0f;
+    std::vector<size_t> classes(512);
+    model.predict_class(X.data(), 512, classes.data());
+    size_t correct = 0;
+    for (size_t s = 0; s < 512; s++){
+        correct += classes[s] == targets[s];
+    }
+    std::cout << "2 process accuracy: " << correct / 512.0f << std::endl;
+    return 1;
+}
+
+int placement_test(){
+    // Where the memory goes must not change the training: every policy
+    // started from the same parameters ends with the same ones
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 256);
+    const char* names[] = {"local", "first touch", "interleaved", \
+                                                            "replicated"};
+    Placement placements[] = {Placement::LOCAL, Placement::FIRST_TOUCH, \
+                            Placement::INTERLEAVED, Placement::REPLICATED};
+    std::vector<float> start, expected;
+    for (size_t p = 0; p < 4; p++){
+        NeuralNetwork nn(0.05f);
+        nn.add_layer(16);
+        nn.add_layer(8);
+        nn.add_layer(2);
+        nn.set_data(inputs, targets, 16);
+        nn.set_batch_size(16);
+        nn.set_threads(2);
+        nn.set_placement(placements[p]);
+        size_t n = nn.getParameterSize();
+        if (start.empty()) start.assign(nn.getParameters(), \
+                                                nn.getParameters() + n);
+        std::copy(start.begin(), start.end(), nn.getParameters());
+        nn.train(2);
+        std::vector<float> trained(nn.getParameters(), \
+                                                nn.getParameters() + n);
+        if (expected.empty()) expected = trained;
+        std::cout << names[p] << ": same parameters " << \
+            (trained == expected) << ", remote accesses " << \
+                                nn.remote_access_fraction() << std::endl;
+    }
+    return 1;
+}
+
+int mixed_precision_test(){
+    // bf16 rounds to nearest, ties to even, and every instruction set must
+    // round the same way and add the products up in fp32
+    float values[] = {1.0f, 1.00390625f, 1.01171875f, -2.5f, NAN};
+    Kernels::bf16 rounded[5];
+    Kernels::to_bf16(5, values, rounded);
+    std::cout << std::hex << rounded[0] << " " << rounded[1] << " " << \
+        rounded[2] << " " << rounded[3] << std::dec << \
+        " (expected 3f80 3f80 3f82 c020), NaN kept: " << \
+        std::isnan(Kernels::from_bf16(rounded[4])) << std::endl;
+
+    const size_t n = 101, kc = 37, nb = 45;
+    std::vector<float> x(n);
+    for (size_t i = 0; i < n; i++) x[i] = std::sin(i * 0.37f) * (1 + i % 5);
+    std::vector<Kernels::bf16> a(n), b(n), expected(n), got(n);
+    const Kernels::KernelTable* ref = Kernels::table(Kernels::Isa::SCALAR);
+    ref->to_bf16(n, x.data(), expected.data());
+    for (size_t i = 0; i < n; i++){
+        a[i] = expected[i];
+        b[i] = expected[n - 1 - i];
+    }
+    // a tile packed by hand: rows k, k+1 interleaved, 0 after the last row
+    std::vector<Kernels::bf16> packed((kc + 1) * nb, 0);
+    for (size_t k = 0; k < kc; k++){
+        for (size_t j = 0; j < nb; j++){
+            packed[(k / 2) * 2 * nb + 2 * j + k % 2] = a[(k * nb + j) % n];
+        }
+    }
+    std::vector<float> c_ref(nb, 1.0f);
+    ref->packed_gemv_bf16(kc, nb, b.data(), packed.data(), c_ref.data());
+    for (Kernels::Isa isa : {Kernels::Isa::AVX2, Kernels::Isa::AVX512, \
+            Kernels::Isa::AVX512_VNNI, Kernels::Isa::AVX512_BF16, \
+                                                    Kernels::Isa::NEON}){
+        const Kernels::KernelTable* kt = Kernels::table(isa);
+        if (!kt) continue;
+        kt->to_bf16(n, x.data(), got.data());
+        std::vector<float> c(nb, 1.0f), y(n), y_ref(n);
+        kt->packed_gemv_bf16(kc, nb, b.data(), packed.data(), c.data());
+        kt->to_fp32(n, a.data(), y.data());
+        ref->to_fp32(n, a.data(), y_ref.data());
+        float diff = std::fabs(kt->dot_bf16(a.data(), b.data(), n) - \
+                                    ref->dot_bf16(a.data(), b.data(), n));
+        for (size_t j = 0; j < nb; j++){
+            diff = std::max(diff, std::fabs(c[j] - c_ref[j]));
+        }
+        for (size_t i = 0; i < n; i++){
+            diff = std::max(diff, std::fabs(y[i] - y_ref[i]));
+        }
+        std::cout << kt->name << ": same rounding " << (got == expected) \
+                            << ", max difference " << diff << std::endl;
+    }
+
+    // Training in bf16 must learn about as well as in fp32, from the same
+    // starting parameters
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 512);
+    std::vector<float> X(inputs.begin(), inputs.end());
+    for (float& v : X) v /= 255.0f;
+    const char* names[] = {"fp32", "bf16"};
+    Kernels::Precision precisions[] = {Kernels::Precision::FP32, \
+                                                Kernels::Precision::BF16};
+    std::vector<float> start;
+    for (size_t p = 0; p < 2; p++){
+        NeuralNetwork nn(0.05f);
+        nn.add_layer(16);
+        nn.add_layer(8);
+        nn.add_layer(2, Activation::SOFTMAX);
+        nn.set_cost(Cost::CROSS_ENTROPY);
+        nn.set_data(inputs, targets, 16);
+        nn.set_batch_size(16);
+        nn.set_threads(2);
+        nn.set_precision(precisions[p]);
+        size_t size = nn.getParameterSize();
+        if (start.empty()) start.assign(nn.getParameters(), \
+                                            nn.getParameters() + size);
+        std::copy(start.begin(), start.end(), nn.getParameters());
+        nn.train(3);
+        InferenceModel model;
+        nn.export_model(model);
+        std::vector<size_t> classes(512);
+        model.predict_class(X.data(), 512, classes.data());
+        size_t correct = 0;
+        for (size_t s = 0; s < 512; s++){
+            correct += classes[s] == targets[s];
+        }
+        std::cout << names[p] << " accuracy: " << correct / 512.0f << \
+                                                                std::endl;
+    }
+    return 1;
+}
+
+int pruning_test(){
+    // The sparse products must match the dense ones on the pruned weights,
+    // with and without the transposes (batches of 3 and 16)
+    const size_t N = 20, K = 37;
+    std::vector<float> W(N * K);
+    for (size_t i = 0; i < N * K; i++){
+        W[i] = i % 3 == 0 ? std::sin(i * 0.37f) : 0.0f;
+    }
+    Sparse::Csr csr = Sparse::from_dense(W.data(), N, K, K);
+    for (size_t M : {3, 16}){
+        std::vector<float> X(M * K), D(M * N);
+        for (size_t i = 0; i < M * K; i++) X[i] = std::cos(i * 0.11f);
+        for (size_t i = 0; i < M * N; i++) D[i] = std::sin(i * 0.23f);
+        std::vector<float> C(M * N), C_ref(M * N), B(M * K), B_ref(M * K);
+        std::vector<float> dW(N * K, 1.0f), dW_ref(N * K, 1.0f);
+        Sparse::spmm_nt(M, X.data(), K, csr, C.data(), N);
+        Kernels::gemm_nt(M, N, K, X.data(), K, W.data(), K, C_ref.data(), N);
+        Sparse::spmm_nn(M, D.data(), N, csr, B.data(), K);
+        Kernels::gemm_nn(M, K, N, D.data(), N, W.data(), K, B_ref.data(), K);
+        Sparse::sddmm_tn(M, 0.5f, D.data(), N, X.data(), K, csr, \
+                                                            dW.data(), K);
+        Kernels::gemm_tn(N, K, M, 0.5f, D.data(), N, X.data(), K, \
+                                                        dW_ref.data(), K);
+        float diff = 0.0f;
+        for (size_t i = 0; i < M * N; i++){
+            diff = std::max(diff, std::fabs(C[i] - C_ref[i]));
+        }
+        for (size_t i = 0; i < M * K; i++){
+            diff = std::max(diff, std::fabs(B[i] - B_ref[i]));
+        }
+        // only the entries of the pattern get their gradient
+        for (size_t i = 0; i < N * K; i++){
+            float expected = W[i] != 0.0f ? dW_ref[i] : 1.0f;
+            diff = std::max(diff, std::fabs(dW[i] - expected));
+        }
+        std::cout << "batch " << M << ": density " << csr.density() << \
+                                ", max difference " << diff << std::endl;
+    }
+    std::cout << "crossover density " << Sparse::crossover_density() << \
+                                                                std::endl;
+
+    // Pruned weights must stay 0 through training (with the Adam moments
+    // from before the pruning) and the network must still learn
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 512);
+    std::vector<float> X(inputs.begin(), inputs.end());
+    for (float& v : X) v /= 255.0f;
+    NeuralNetwork nn(0.05f);
+    nn.add_layer(16);
+    nn.add_layer(64);
+    nn.add_layer(2, Activation::SOFTMAX);
+    nn.set_cost(Cost::CROSS_ENTROPY);
+    nn.set_data(inputs, targets, 16);
+    nn.set_batch_size(16);
+    nn.set_threads(2);
+    OptimizerConfig config;
+    config.type = OptimizerType::ADAM;
+    nn.set_optimizer(config);
+    nn.train(2);
+    // 50 of the 1024 weights of the hidden layer, 50 of the 128 of the
+    // output one
+    nn.prune_top_k(50);
+    size_t size = nn.getParameterSize();
+    std::vector<float> before(nn.getParameters(), nn.getParameters() + size);
+    nn.train(3);
+    const float* after = nn.getParameters();
+    size_t moved = 0, kept = 0;
+    for (size_t i = 0; i < size; i++){
+        moved += before[i] == 0.0f && after[i] != 0.0f;
+        kept += after[i] != 0.0f;
+    }
+    InferenceModel model;
+    nn.export_model(model);
+    std::vector<size_t> classes(512);
+    model.predict_class(X.data(), 512, classes.data());
+    size_t correct = 0;
+    for (size_t s = 0; s < 512; s++){
+        correct += classes[s] == targets[s];
+    }
+    std::cout << "pruned weights moved " << moved << ", nonzero " << kept \
+        << ", sparse layers " << model.getSparseLayerCount() << \
+                ", accuracy " << correct / 512.0f << std::endl;
+
+    // The masks go through a checkpoint: pruned weights stay 0 in a fresh
+    // network that loads it
+    nn.save_checkpoint("pruned.ckpt");
+    NeuralNetwork loaded(0.05f);
+    loaded.load_checkpoint("pruned.ckpt");
+    loaded.set_cost(Cost::CROSS_ENTROPY);
+    loaded.set_data(inputs, targets, 16);
+    loaded.train(2);
+    size_t moved_loaded = 0;
+    for (size_t i = 0; i < size; i++){
+        moved_loaded += after[i] == 0.0f && loaded.getParameters()[i] != 0.0f;
+    }
+    std::cout << "after a save and load, pruned weights moved " << \
+                                moved_loaded << " (expected 0)" << std::endl;
+    std::remove("pruned.ckpt");
+    return 1;
+}
+
+int softmax_cross_entropy_test(){
+    // Every instruction set against a softmax in double, on rows that are
+    // not a multiple of any vector width and logits far apart
+    for (size_t n : {1, 10, 33, 1000}){
+        std::vector<float> z(n);
+        for (size_t i = 0; i < n; i++) z[i] = 30.0f * std::sin(i * 1.7f);
+        size_t target = n / 3;
+        double max = *std::max_element(z.begin(), z.end()), sum = 0.0;
+        for (float v : z) sum += std::exp(v - max);
+        double loss_ref = std::log(sum) - (z[target] - max);
+        for (Kernels::Isa isa : {Kernels::Isa::SCALAR, Kernels::Isa::AVX2, \
+                            Kernels::Isa::AVX512, Kernels::Isa::NEON}){
+            const Kernels::KernelTable* kt = Kernels::table(isa);
+            if (kt == nullptr) continue;
+            std::vector<float> y(n), delta(n);
+            float loss = kt->softmax_cross_entropy(n, z.data(), target, \
+                                                    y.data(), delta.data());
+            double diff = std::fabs(loss - loss_ref) / \
+                                            std::max(loss_ref, 1.0);
+            for (size_t i = 0; i < n; i++){
+                double p = std::exp(z[i] - max) / sum;
+                double d = p - (i == target ? 1.0 : 0.0);
+                diff = std::max(diff, std::fabs(y[i] - p) / p);
+                diff = std::max(diff, std::fabs(delta[i] - d));
+            }
+            std::cout << kt->name << " n=" << n << ": loss " << loss << \
+                        ", max relative difference " << diff << std::endl;
+        }
+    }
+
+    // The fused layer pass must give the output and delta of the separate
+    // forward, loss gradient and softmax Jacobian product
+    const size_t batch = 9, n_in = 20, n_out = 10;
+    Layer input(n_in);
+    Layer layer(input, n_out);
+    layer.setActivation(Activation::SOFTMAX);
+    std::vector<float> X(batch * n_in), y(batch * n_out), d(batch * n_out);
+    std::vector<float> y_ref(batch * n_out), d_ref(batch * n_out);
+    for (size_t i = 0; i < X.size(); i++) X[i] = std::cos(i * 0.3f);
+    uint8_t labels[batch];
+    for (size_t r = 0; r < batch; r++) labels[r] = (r * 7) % n_out;
+    float loss = layer.forward_cross_entropy(X.data(), labels, y.data(), \
+                                                        d.data(), batch);
+    layer.forward(X.data(), y_ref.data(), batch);
+    float loss_ref = 0.0f;
+    for (size_t r = 0; r < batch; r++){
+        loss_ref += CostFuncs::CrossEntropyPolicy::loss_gradient( \
+            y_ref.data() + r * n_out, labels[r], d_ref.data() + r * n_out, \
+                                                                    n_out);
+    }
+    layer.output_delta(d_ref.data(), y_ref.data(), d_ref.data(), batch);
+    float diff = std::fabs(loss - loss_ref);
+    for (size_t i = 0; i < batch * n_out; i++){
+        diff = std::max(diff, std::fabs(y[i] - y_ref[i]));
+        diff = std::max(diff, std::fabs(d[i] - d_ref[i]));
+    }
+    std::cout << "fused vs separate passes, max difference " << diff << \
+                                                                std::endl;
+    return 1;
+}
+
+int validation_test(){
+    // The validation run in the background must give the loss of the model
+    // at that epoch, read from a binary or a csv file
+    std::vector<uint8_t> inputs, targets, held_inputs, held_targets;
+    make_halves_data(inputs, targets, 512);
+    make_halves_data(held_inputs, held_targets, 131);
+    NeuralNetwork writer;
+    writer.set_data(held_inputs, held_targets, 16);
+    writer.save_input("halves_valid.bin");
+    std::ofstream csv("halves_valid.csv");
+    for (size_t s = 0; s < held_targets.size(); s++){
+        csv << (int)held_targets[s];
+        for (size_t j = 0; j < 16; j++){
+            csv << "," << (int)held_inputs[s*16 + j];
+        }
+        csv << "\n";
+    }
+    csv.close();
+
+    NeuralNetwork nn(0.05f);
+    nn.add_layer(16);
+    nn.add_layer(8, Activation::TANH);
+    nn.add_layer(2, Activation::SOFTMAX);
+    nn.set_cost(Cost::CROSS_ENTROPY);
+    nn.set_data(inputs, targets, 16);
+    nn.set_batch_size(16);
+    nn.set_validation("halves_valid.bin", 1);
+    nn.train(4);
+    std::cout << "Validations: " << nn.getValidationHistory().size() << \
+                                                " (4 expected)" << std::endl;
+    InferenceModel model;
+    nn.export_model(model);
+    std::vector<float> X(held_inputs.begin(), held_inputs.end()), y(2);
+    for (float& x : X) x /= 255.0f;
+    double loss = 0.0;
+    for (size_t s = 0; s < held_targets.size(); s++){
+        model.predict(X.data() + s * 16, 1, y.data());
+        loss -= std::log(std::fmax(y[held_targets[s]], \
+                                            CostFuncs::MIN_PROBABILITY));
+    }
+    loss /= held_targets.size();
+    std::cout << "Last validation loss " << \
+        nn.getValidationHistory().back().loss << ", expected " << loss << \
+                                                                std::endl;
+    nn.set_validation("halves_valid.csv", 1);
+    nn.train(1);
+    std::cout << "Csv validation loss " << \
+        nn.getValidationHistory().back().loss << std::endl;
+
+    // Nothing changes without a learning rate, so the loss never improves
+    // after the first validation: 2 stale ones stop the training, at most
+    // one epoch after the second, and the best checkpoint is the first
+    NeuralNetwork frozen(0.0f);
+    frozen.add_layer(16);
+    frozen.add_layer(2, Activation::SOFTMAX);
+    frozen.set_data(inputs, targets, 16);
+    frozen.set_validation("halves_valid.bin", 1);
+    frozen.set_early_stopping(2, "halves_best.ckpt");
+    frozen.train(20);
+    Checkpoint best;
+    best.open("halves_best.ckpt");
+    std::cout << "Stopped after " << frozen.getValidationHistory().size() << \
+        " validations (3 or 4 expected), best checkpoint at epoch " << \
+                                    best.getEpochs() << " (1 expected)" << \
+                                                                std::endl;
+    best.close();
+    std::remove("halves_valid.bin");
+    std::remove("halves_valid.csv");
+    std::remove("halves_best.ckpt");
+    return 1;
+}
+
+int static_network_test(){
+    // The fixed topology network must give the outputs of the dynamic one,
+    // for small layers (unrolled) and large ones (packed_gemv)
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 512);
+    NeuralNetwork nn(0.05f);
+    nn.add_layer(16);
+    nn.add_layer(8, Activation::TANH);
+    nn.add_layer(2, Activation::SOFTMAX);
+    nn.set_data(inputs, targets, 16);
+    nn.set_batch_size(16);
+    nn.train(2);
+    InferenceModel model;
+    StaticNetwork<16, 8, 2> small;
+    nn.export_model(model);
+    nn.export_model(small);
+    std::vector<float> X(inputs.begin(), inputs.end());
+    for (float& x : X) x /= 255.0f;
+    float diff = 0.0f;
+    size_t same_class = 0;
+    for (size_t s = 0; s < 512; s++){
+        float a[2], b[2];
+        model.predict(X.data() + s * 16, 1, a);
+        small.predict(X.data() + s * 16, b);
+        diff = std::max({diff, std::fabs(a[0] - b[0]), std::fabs(a[1] - b[1])});
+        same_class += small.predict_class(X.data() + s * 16) == \
+                                                    (size_t)(a[1] > a[0]);
+    }
+    std::cout << "16-8-2: max difference " << diff << ", same class for " \
+                                << same_class << " of 512" << std::endl;
+
+    NeuralNetwork wide;
+    wide.add_layer(64);
+    wide.add_layer(160, Activation::RELU);
+    wide.add_layer(3, Activation::IDENTITY);
+    wide.save_checkpoint("wide.ckpt");
+    static StaticNetwork<64, 160, 3> large;
+    large.load("wide.ckpt");
+    wide.export_model(model);
+    diff = 0.0f;
+    for (size_t s = 0; s < 8; s++){
+        float x[64], a[3], b[3];
+        for (size_t j = 0; j < 64; j++) x[j] = std::sin(s * 64.0f + j);
+        model.predict(x, 1, a);
+        large.predict(x, b);
+        for (size_t o = 0; o < 3; o++) diff = std::max(diff, \
+                                                    std::fabs(a[o] - b[o]));
+    }
+    std::cout << "64-160-3 from a checkpoint: max difference " << diff << \
+                                                                std::endl;
+    StaticNetwork<16, 4, 2> other;
+    std::cout << "Loading other sizes fails: " << \
+                                    (nn.export_model(other) == 0) << std::endl;
+    std::remove("wide.ckpt");
+    return 1;
+}
+
+int execution_plan_test(){
+    // The deltas reuse the memory of activations that are dead by then, and
+    // once the plan is compiled the training steps allocate nothing: an
+    // epoch more must not add a single allocation
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 512);
+    NeuralNetwork nn(0.05f);
+    nn.add_layer(16);
+    nn.add_layer(64);
+    nn.add_layer(64);
+    nn.add_layer(64);
+    nn.add_layer(2, Activation::SOFTMAX);
+    nn.set_cost(Cost::CROSS_ENTROPY);
+    nn.set_data(inputs, targets, 16);
+    nn.set_batch_size(32);
+    nn.set_threads(2);
+    nn.compile();
+    nn.display_plan();
+    size_t counts[2];
+    for (size_t epochs : {1, 3}){
+        size_t before = heap_allocations();
+        nn.train(epochs);
+        counts[epochs / 2] = heap_allocations() - before;
+    }
+#ifdef NN_PROFILE
+    const char* expected = "the same but for the profile written every epoch";
+#else
+    const char* expected = "the same";
+#endif
+    std::cout << "Allocations for 1 epoch: " << counts[0] << ", for 3: " << \
+                            counts[1] << " (" << expected << ")" << std::endl;
+    return 1;
+}
+
+int pipeline_test(){
+    // 1F1B: the first stage of 4 holds 3 micro-batches in flight at most
+    // and alternates once the pipeline is full
+    const char* expected = "F0 F1 F2 F3 B0 F4 B1 B2 B3 B4";
+    std::string ops;
+    for (size_t i = 0; i < 10; i++){
+        Pipeline::Op op = Pipeline::op_at(PipelineSchedule::ONE_F_ONE_B, \
+                                                            0, 4, 5, i);
+        ops += (i ? " " : "") + std::string(op.forward ? "F" : "B") + \
+                                                std::to_string(op.micro);
+    }
+    std::cout << "1F1B of the first stage: " << ops << " (expected " << \
+        expected << "), in flight " << Pipeline::in_flight( \
+        PipelineSchedule::ONE_F_ONE_B, 0, 4, 5) << " (expected 4)" << \
+                                                                std::endl;
+    std::vector<size_t> ranges = Pipeline::partition({4, 1, 1, 1, 1, 4}, 3);
+    std::cout << "Stages start at " << ranges[0] << " " << ranges[1] << \
+            " " << ranges[2] << " (expected 0 1 5)" << std::endl;
+
+    // The gradients of every layer are summed in micro-batch order by one
+    // thread, so the number of stages and the schedule do not change the
+    // results, and they match plain training up to the rounding
+    std::vector<uint8_t> inputs, targets;
+    make_halves_data(inputs, targets, 256);
+    std::vector<float> start, expected_params, plain;
+    struct Run {
+        size_t stages, micro;
+        PipelineSchedule schedule;
+    };
+    Run runs[] = {{1, 4, PipelineSchedule::GPIPE}, \
+                    {2, 4, PipelineSchedule::GPIPE}, \
+                    {4, 4, PipelineSchedule::ONE_F_ONE_B}, \
+                    {3, 4, PipelineSchedule::ONE_F_ONE_B}};
+    for (size_t r = 0; r <= 4; r++){
+        NeuralNetwork nn(0.05f);
+        nn.add_layer(16);
+        nn.add_layer(32);
+        nn.add_layer(24);
+        nn.add_layer(16);
+        nn.add_layer(2, Activation::SOFTMAX);
+        nn.set_cost(Cost::CROSS_ENTROPY);
+        nn.set_data(inputs, targets, 16);
+        nn.set_batch_size(30); // micro-batches of 8, the last one of 6
+        nn.set_threads(r < 4 ? 4 : 1);
+        size_t n = nn.getParameterSize();
+        if (start.empty()) start.assign(nn.getParameters(), \
+                                                nn.getParameters() + n);
+        std::copy(start.begin(), start.end(), nn.getParameters());
+        if (r < 4) {
+            nn.train_pipeline(2, runs[r].stages, runs[r].micro, \
+                                                        runs[r].schedule);
+        } else {
+            nn.train(2);
+        }
+        std::vector<float> trained(nn.getParameters(), \
+                                                nn.getParameters() + n);
+        if (r == 4) {
+            float diff = 0.0f;
+            for (size_t i = 0; i < n; i++){
+                diff = std::max(diff, std::fabs(trained[i] - \
+                                                    expected_params[i]));
+            }
+            std::cout << "Largest difference to train: " << diff << \
+                                            " (close to 0)" << std::endl;
+            break;
+        }
+        if (expected_params.empty()) expected_params = trained;
+        const PipelineStats& stats = nn.getPipelineStats();
+        std::cout << runs[r].stages << " stages: same parameters " << \
+            (trained == expected_params) << ", bubble in [0, 1] " << \
+            (stats.bubble >= 0.0 && stats.bubble <= 1.0) << std::endl;
+    }
+    return 1;
+}
+
 int main(){
     //forward_pass_test();
     //setNeuron_test();
     //getError_test();
     //backward_pass_test();
+    //batch_pass_test();
     // read_input_test();
+    //binary_input_test();
+    //train_test();
+    //csv_parse_test();
+    //train_stream_test();
+    //parameter_arena_test();
+    //optimizer_test();
+    //activation_test();
+    //inference_test();
+    //checkpoint_test();
+    //quantization_test();
+    //profiler_test();
+    //hogwild_test();
+    //ring_all_reduce_test();
+    //placement_test();
+    //mixed_precision_test();
+    //pruning_test();
+    //softmax_cross_entropy_test();
+    //validation_test();
+    //static_network_test();
+    //execution_plan_test();
+    //pipeline_test();
     neural_network_structure_test();
     return 1;
 }
\ No newline at end of file